@@ -0,0 +1,321 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../elf/driver.h"
+#include "../noisy/fcntl.h"
+#include "../noisy/lib.h"
+#include "../noisy/uring.h"
+#include "../sparse.h"
+#include "batch.h"
+
+/* Dump N + 1 is read into one slot while dump N is written from the other. */
+#define BATCH_SLOTS 2
+#define BATCH_RING_ENTRIES 64
+
+struct batchSlot {
+	struct elf elf;
+	struct noisyRingGroup group;
+	struct noisyFile *input;
+	struct noisyFile *output;
+	struct elfChunk *chunks;
+	Elf32_Ehdr ehdr;
+	void *buffer;
+	size_t holes;
+	bool read;
+	bool written;
+};
+
+struct batchJob {
+	const char *dump;
+	const char *info;
+	const char *output;
+	size_t size;
+	bool failed;
+};
+
+static size_t batchSize(struct batchJob * restrict job)
+{
+	struct noisyFile * const file = noisyOpen(job->dump, O_RDONLY);
+	if (file == NULL) {
+		job->failed = true;
+		return 0;
+	}
+
+	const off_t size = noisyLseek(file, 0, SEEK_END);
+	noisyClose(file);
+	if (size < 0) {
+		job->failed = true;
+		return 0;
+	}
+
+	job->size = size;
+	return job->size;
+}
+
+static void batchRead(struct noisyRing * restrict ring,
+		      struct batchSlot * restrict slot,
+		      struct batchJob * restrict job)
+{
+	slot->read = false;
+	if (job->failed)
+		return;
+
+	slot->input = noisyOpen(job->dump, O_RDONLY);
+	if (slot->input == NULL) {
+		job->failed = true;
+		return;
+	}
+
+	slot->group.pending = 0;
+	slot->group.result = 0;
+	if (noisyRingPread(ring, &slot->group, slot->input,
+			   slot->buffer, job->size, 0, false) != 0) {
+		noisyClose(slot->input);
+		job->failed = true;
+		return;
+	}
+
+	slot->read = true;
+}
+
+static void batchReadWait(struct noisyRing * restrict ring,
+			  struct batchSlot * restrict slot,
+			  struct batchJob * restrict job)
+{
+	if (!slot->read)
+		return;
+
+	if (noisyRingWait(ring, &slot->group) != 0)
+		job->failed = true;
+
+	noisyClose(slot->input);
+}
+
+static void batchConvert(struct noisyRing * restrict ring,
+			 struct batchSlot * restrict slot,
+			 struct batchJob * restrict job)
+{
+	slot->written = false;
+	if (job->failed)
+		return;
+
+	if (elfInitBuffer(&slot->elf, slot->buffer, job->size, job->dump) != 0)
+		goto failInit;
+
+	if (elfMakeSections(&slot->elf, &job->info, 1) != 0)
+		goto failMakeSections;
+
+	slot->chunks = noisyMalloc(ELF_CHUNK_MAX(slot->elf.shnum)
+				   * sizeof(*slot->chunks));
+	if (slot->chunks == NULL)
+		goto failChunks;
+
+	slot->output = noisyCreat(job->output);
+	if (slot->output == NULL)
+		goto failOutput;
+
+	const Elf32_Word n = elfLayout(&slot->elf, &slot->ehdr, slot->chunks);
+	const bool holeSafe = noisyIsHoleSafe(slot->output);
+	struct elfChunk pending = { NULL, 0, 0 };
+
+	slot->group.pending = 0;
+	slot->group.result = 0;
+	slot->holes = 0;
+
+	for (Elf32_Word ndx = 0; ndx < n; ndx++) {
+		const char * const buffer = slot->chunks[ndx].buffer;
+		const size_t size = slot->chunks[ndx].size;
+		const off_t offset = slot->chunks[ndx].offset;
+		size_t done = 0;
+
+		while (done < size) {
+			bool zero = false;
+			const size_t run = holeSafe ?
+				sparseRun(buffer + done, size - done,
+					  offset + done, &zero) :
+				size - done;
+
+			if (zero) {
+				slot->holes += run;
+			} else {
+				/* Writes are queued one behind so that all
+				   but the last are linked, and a failure
+				   cancels the rest. */
+				if (pending.buffer != NULL
+				    && noisyRingPwrite(ring, &slot->group,
+						       slot->output,
+						       pending.buffer,
+						       pending.size,
+						       pending.offset, true)
+				       != 0)
+					job->failed = true;
+
+				pending.buffer = buffer + done;
+				pending.offset = offset + done;
+				pending.size = run;
+			}
+
+			done += run;
+		}
+	}
+
+	if (pending.buffer != NULL
+	    && noisyRingPwrite(ring, &slot->group, slot->output,
+			       pending.buffer, pending.size, pending.offset,
+			       false) != 0)
+		job->failed = true;
+
+	slot->written = true;
+	return;
+
+failOutput:
+	free(slot->chunks);
+failChunks:
+failMakeSections:
+	elfDeinitSections(&slot->elf);
+failInit:
+	job->failed = true;
+}
+
+static void batchWriteWait(struct noisyRing * restrict ring,
+			   struct batchSlot * restrict slot,
+			   struct batchJob * restrict job)
+{
+	if (!slot->written)
+		return;
+
+	if (noisyRingWait(ring, &slot->group) != 0)
+		job->failed = true;
+
+	if (noisyClose(slot->output) != 0)
+		job->failed = true;
+
+	if (!job->failed && slot->holes > 0)
+		fprintf(stderr, "%s: %zu zero bytes are left as holes\n",
+			job->output, slot->holes);
+
+	free(slot->chunks);
+	elfDeinitSections(&slot->elf);
+	slot->written = false;
+}
+
+int batchMain(int argc, char *argv[])
+{
+	struct batchSlot slots[BATCH_SLOTS];
+	void *buffers[BATCH_SLOTS];
+	size_t sizes[BATCH_SLOTS];
+	int result = EXIT_SUCCESS;
+
+	if (argc < 5 || (argc - 2) % 3 != 0) {
+		fprintf(stderr, "usage: %s batch <DUMP.ELF> <INFO.BIN> <OUTPUT> [<DUMP.ELF> <INFO.BIN> <OUTPUT>]...\n",
+			argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	const int n = (argc - 2) / 3;
+	struct batchJob * const jobs = noisyMalloc(n * sizeof(*jobs));
+	if (jobs == NULL)
+		goto failJobs;
+
+	size_t max = 1;
+	for (int ndx = 0; ndx < n; ndx++) {
+		jobs[ndx].dump = argv[2 + ndx * 3];
+		jobs[ndx].info = argv[3 + ndx * 3];
+		jobs[ndx].output = argv[4 + ndx * 3];
+		jobs[ndx].failed = false;
+
+		const size_t size = batchSize(jobs + ndx);
+		if (size > max)
+			max = size;
+	}
+
+	const int nSlots = n < BATCH_SLOTS ? n : BATCH_SLOTS;
+	int allocated;
+	for (allocated = 0; allocated < nSlots; allocated++) {
+		slots[allocated].buffer = noisyMalloc(max);
+		if (slots[allocated].buffer == NULL)
+			goto failBuffers;
+
+		slots[allocated].read = false;
+		slots[allocated].written = false;
+		buffers[allocated] = slots[allocated].buffer;
+		sizes[allocated] = max;
+	}
+
+	struct noisyRing * const ring = noisyRingOpen(BATCH_RING_ENTRIES);
+	if (ring == NULL)
+		goto failRing;
+
+	noisyRingRegister(ring, buffers, sizes, nSlots);
+
+	batchRead(ring, slots, jobs);
+	noisyRingSubmit(ring);
+
+	for (int ndx = 0; ndx < n; ndx++) {
+		struct batchSlot * const slot = slots + ndx % BATCH_SLOTS;
+		struct batchSlot * const next = slots + (ndx + 1) % BATCH_SLOTS;
+
+		batchReadWait(ring, slot, jobs + ndx);
+
+		/* The next slot still holds the previous dump being written. */
+		if (ndx > 0)
+			batchWriteWait(ring, next, jobs + ndx - 1);
+
+		/* Submit the read now so that it overlaps the conversion. */
+		if (ndx + 1 < n) {
+			batchRead(ring, next, jobs + ndx + 1);
+			noisyRingSubmit(ring);
+		}
+
+		batchConvert(ring, slot, jobs + ndx);
+		noisyRingSubmit(ring);
+	}
+
+	batchWriteWait(ring, slots + (n - 1) % BATCH_SLOTS, jobs + n - 1);
+
+	for (int ndx = 0; ndx < n; ndx++) {
+		if (jobs[ndx].failed) {
+			fprintf(stderr, "%s: conversion failed\n",
+				jobs[ndx].dump);
+			result = EXIT_FAILURE;
+		}
+	}
+
+	noisyRingClose(ring);
+	for (int ndx = 0; ndx < nSlots; ndx++)
+		free(slots[ndx].buffer);
+
+	free(jobs);
+	return result;
+
+failRing:
+failBuffers:
+	while (allocated > 0) {
+		allocated--;
+		free(slots[allocated].buffer);
+	}
+
+	free(jobs);
+failJobs:
+	return EXIT_FAILURE;
+}
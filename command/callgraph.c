@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "../elf/branch.h"
+#include "../elf/callgraph.h"
+#include "../elf/driver.h"
+#include "../elf/lookup.h"
+#include "callgraph.h"
+
+/* Returns the number of symbols in .symtab which elfMakeSections made. */
+static Elf32_Word countSyms(const struct elf * restrict elf)
+{
+	for (Elf32_Word ndx = 0; ndx < elf->shnum; ndx++)
+		if (elf->shdrs[ndx].sh_type == SHT_SYMTAB)
+			return elf->shdrs[ndx].sh_size / sizeof(Elf32_Sym);
+
+	return 0;
+}
+
+int callgraphMain(int argc, char *argv[])
+{
+	struct elfCallgraph graph;
+	struct elfLookup lookup;
+	struct elf elf;
+	unsigned int sets = ELF_BRANCH_THUMB;
+	const char *output = NULL;
+	bool binary = false;
+	int opt;
+
+	/* Skip the command name. */
+	argc--;
+	argv++;
+
+	while ((opt = getopt(argc, argv, "abo:")) != -1) {
+		switch (opt) {
+		case 'a':
+			sets |= ELF_BRANCH_ARM;
+			break;
+
+		case 'b':
+			binary = true;
+			break;
+
+		case 'o':
+			output = optarg;
+			break;
+
+		default:
+			goto failInval;
+		}
+	}
+
+	if (argc - optind < 1)
+		goto failInval;
+
+	if (elfInit(&elf, argv[optind]) != 0)
+		goto failElfInit;
+
+	if (elfMakeSections(&elf, (const char * const *)argv + optind + 1,
+			    argc - optind - 1) != 0)
+		goto failElfMakeSections;
+
+	if (elfLookupInitElf(&lookup, &elf) != 0)
+		goto failElfMakeSections;
+
+	if (elfCallgraphInit(&graph, &elf.source, &lookup, countSyms(&elf),
+			     sets) != 0)
+		goto failCallgraph;
+
+	FILE * const fp = output == NULL ? stdout : fopen(output, "wb");
+	if (fp == NULL) {
+		perror(output);
+		goto failOpen;
+	}
+
+	if ((binary ? elfCallgraphWrite(&graph, fp) :
+		      elfCallgraphWriteDot(&graph, &lookup, fp)) != 0)
+		goto failWrite;
+
+	if (fp != stdout && fclose(fp) != 0) {
+		perror(output);
+		goto failOpen;
+	}
+
+	fprintf(stderr, "%u calls between %u symbols\n", graph.nEdges,
+		graph.nNodes);
+
+	elfCallgraphDeinit(&graph);
+	elfLookupDeinit(&lookup);
+	elfDeinit(&elf);
+	return EXIT_SUCCESS;
+
+failWrite:
+	if (fp != stdout)
+		fclose(fp);
+failOpen:
+	elfCallgraphDeinit(&graph);
+failCallgraph:
+	elfLookupDeinit(&lookup);
+failElfMakeSections:
+	elfDeinit(&elf);
+failElfInit:
+	return EXIT_FAILURE;
+
+failInval:
+	fprintf(stderr, "usage: %s callgraph [-a] [-b] [-o OUTPUT] <DUMP.ELF> [<INFO.BIN | DIRECTORY>...]\n"
+		"\n"
+		"  -a  decode ARM code too\n"
+		"  -b  write compressed sparse rows instead of DOT\n",
+		argv[-1]);
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../elf/driver.h"
+#include "../elf/harvest.h"
+#include "../nid/crack.h"
+#include "../nid/overlay.h"
+#include "../noisy/lib.h"
+#include "../readwhole.h"
+#include "crack.h"
+
+#define CRACK_OPTS_MAX 64
+
+struct wordlists {
+	char *buffers[CRACK_OPTS_MAX];
+	size_t nBuffers;
+	struct nidCrackWord *words;
+	size_t nWords;
+	size_t capacity;
+};
+
+static int addWord(struct wordlists * restrict lists,
+		   const char * restrict string, size_t size)
+{
+	if (lists->nWords >= lists->capacity) {
+		const size_t capacity = lists->capacity <= 0 ?
+			1024 : lists->capacity * 2;
+		struct nidCrackWord * const words = noisyRealloc(
+			lists->words, capacity * sizeof(*words));
+		if (words == NULL)
+			return -1;
+
+		lists->words = words;
+		lists->capacity = capacity;
+	}
+
+	lists->words[lists->nWords].string = string;
+	lists->words[lists->nWords].size = size;
+	lists->nWords++;
+	return 0;
+}
+
+/* Adds the identifiers in the strings of the dump. */
+static int addHarvest(struct wordlists * restrict lists,
+		      const struct elfImage * restrict image)
+{
+	struct nidCrackWord *words;
+	size_t n;
+
+	if (elfHarvestWords(image, &words, &n) != 0)
+		return -1;
+
+	for (size_t ndx = 0; ndx < n; ndx++)
+		if (addWord(lists, words[ndx].string, words[ndx].size) != 0) {
+			free(words);
+			return -1;
+		}
+
+	free(words);
+	return 0;
+}
+
+/* Takes every non-empty line as a word. */
+static int addWordlist(struct wordlists * restrict lists,
+		       const char * restrict path)
+{
+	size_t size;
+
+	char * const buffer = readWhole(path, &size);
+	if (buffer == NULL)
+		return -1;
+
+	lists->buffers[lists->nBuffers] = buffer;
+	lists->nBuffers++;
+
+	const char *line = buffer;
+	const char * const btm = buffer + size;
+	while (line < btm) {
+		const char *end = memchr(line, '\n', btm - line);
+		const char * const next = end == NULL ? btm : end + 1;
+
+		if (end == NULL)
+			end = btm;
+
+		if (end > line && end[-1] == '\r')
+			end--;
+
+		if (end > line && addWord(lists, line, end - line) != 0)
+			return -1;
+
+		line = next;
+	}
+
+	return 0;
+}
+
+static int compareHits(const void *a, const void *b)
+{
+	const struct nidCrackHit * const x = a;
+	const struct nidCrackHit * const y = b;
+
+	return x->nid != y->nid ? (x->nid < y->nid ? -1 : 1) :
+		strcmp(x->name, y->name);
+}
+
+/* Prints hits and records the first name of each NID in the overlay. */
+static int report(struct nidCrack * restrict crack)
+{
+	char * const path = nidOverlayPath();
+	if (path == NULL)
+		return -1;
+
+	if (crack->nHits > 0)
+		qsort(crack->hits, crack->nHits, sizeof(*crack->hits),
+		      compareHits);
+
+	for (size_t ndx = 0; ndx < crack->nHits; ndx++) {
+		const struct nidCrackHit * const hit = crack->hits + ndx;
+
+		printf("0x%08X %s\n", hit->nid, hit->name);
+
+		if ((ndx <= 0 || hit[-1].nid != hit->nid)
+		    && nidOverlayAppend(path, hit->nid, hit->name) != 0) {
+			free(path);
+			return -1;
+		}
+	}
+
+	free(path);
+	return 0;
+}
+
+static double elapsed(const struct timespec * restrict from)
+{
+	struct timespec to;
+
+	clock_gettime(CLOCK_MONOTONIC, &to);
+	return (double)(to.tv_sec - from->tv_sec)
+	       + (to.tv_nsec - from->tv_nsec) / 1e9;
+}
+
+int crackMain(int argc, char *argv[])
+{
+	static const char * const defaultSuffixes[] = { "" };
+	const char *suffixes[CRACK_OPTS_MAX];
+	struct wordlists lists = { .nBuffers = 0, .words = NULL,
+				   .nWords = 0, .capacity = 0 };
+	struct nidCrack crack;
+	struct timespec start;
+	struct elf elf;
+	size_t nSuffixes = 0;
+	int result = EXIT_FAILURE;
+	int opt;
+
+	/* Skip the command name. */
+	argc--;
+	argv++;
+
+	while ((opt = getopt(argc, argv, "s:w:")) != -1) {
+		switch (opt) {
+		case 's':
+			if (nSuffixes >= CRACK_OPTS_MAX)
+				goto failInval;
+
+			suffixes[nSuffixes] = optarg;
+			nSuffixes++;
+			break;
+
+		case 'w':
+			if (lists.nBuffers >= CRACK_OPTS_MAX)
+				goto failInval;
+
+			if (addWordlist(&lists, optarg) != 0)
+				goto failWords;
+
+			break;
+
+		default:
+			goto failInval;
+		}
+	}
+
+	if (argc - optind < 1)
+		goto failInval;
+
+	if (elfInit(&elf, argv[optind]) != 0)
+		goto failWords;
+
+	if (elfMakeSections(&elf, (const char * const *)argv + optind + 1,
+			    argc - optind - 1) != 0)
+		goto failElfMakeSections;
+
+	const size_t nListed = lists.nWords;
+	if (addHarvest(&lists, &elf.source) != 0)
+		goto failElfMakeSections;
+
+	crack.targets = &elf.unresolved;
+	crack.words = lists.words;
+	crack.nWords = lists.nWords;
+	crack.suffixes = nSuffixes > 0 ? suffixes : defaultSuffixes;
+	crack.nSuffixes = nSuffixes > 0 ? nSuffixes : 1;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (nidCrackRun(&crack) != 0)
+		goto failElfMakeSections;
+
+	const double seconds = elapsed(&start);
+
+	fprintf(stderr, "%zu unresolved NIDs, %zu words listed, "
+		"%zu harvested, "
+		"%" PRIu64 " hashes in %.3f s (%.0f hashes/s), %zu hits\n",
+		elf.unresolved.n, nListed, lists.nWords - nListed,
+		crack.hashes, seconds,
+		seconds > 0 ? crack.hashes / seconds : 0, crack.nHits);
+
+	if (report(&crack) == 0)
+		result = EXIT_SUCCESS;
+
+	nidCrackDeinit(&crack);
+failElfMakeSections:
+	elfDeinit(&elf);
+failWords:
+	for (size_t ndx = 0; ndx < lists.nBuffers; ndx++)
+		free(lists.buffers[ndx]);
+
+	free(lists.words);
+	return result;
+
+failInval:
+	fprintf(stderr, "usage: %s crack [-s SUFFIX]... [-w WORDLIST]... <DUMP.ELF> [<INFO.BIN | DIRECTORY>...]\n",
+		argv[-1]);
+	goto failWords;
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "../elf/driver.h"
+#include "../elf/elf.h"
+#include "../elf/hooks.h"
+#include "../elf/lookup.h"
+#include "hooks.h"
+
+static void printAddr(const struct elfLookup * restrict lookup,
+		      Elf32_Addr vaddr)
+{
+	const struct elfLookupSym * const sym
+		= elfLookupFind(lookup, vaddr & ~(Elf32_Addr)1);
+
+	if (sym == NULL)
+		printf("0x%08X ??", vaddr);
+	else
+		printf("0x%08X %s+0x%X", vaddr, sym->name,
+		       (vaddr & ~(Elf32_Addr)1) - sym->value);
+}
+
+static void printHook(const struct elfLookup * restrict lookup,
+		      const struct elfHook * restrict hook)
+{
+	static const char * const kinds[] = {
+		[ELF_HOOK_STUB] = "stub",
+		[ELF_HOOK_REDIRECT] = "redirect",
+		[ELF_HOOK_EXPORT] = "export"
+	};
+
+	printf("%-8s ", kinds[hook->kind]);
+	printAddr(lookup, hook->vaddr);
+	fputs(" -> ", stdout);
+	if (hook->known)
+		printAddr(lookup, hook->target);
+	else
+		fputs("?", stdout);
+
+	putchar('\n');
+}
+
+int hooksMain(int argc, char *argv[])
+{
+	struct elfHooks hooks;
+	struct elfLookup lookup;
+	struct elf elf;
+	bool exports = false;
+	int opt;
+
+	/* Skip the command name. */
+	argc--;
+	argv++;
+
+	while ((opt = getopt(argc, argv, "e")) != -1) {
+		switch (opt) {
+		case 'e':
+			exports = true;
+			break;
+
+		default:
+			goto failInval;
+		}
+	}
+
+	if (argc - optind < 1)
+		goto failInval;
+
+	if (elfInit(&elf, argv[optind]) != 0)
+		goto failElfInit;
+
+	if (elfMakeSections(&elf, (const char * const *)argv + optind + 1,
+			    argc - optind - 1) != 0)
+		goto failElfMakeSections;
+
+	if (elfLookupInitElf(&lookup, &elf) != 0)
+		goto failElfMakeSections;
+
+	if (elfHooksFind(&hooks, &elf.source, elf.modules, elf.nModules,
+			 exports) != 0)
+		goto failHooks;
+
+	for (Elf32_Word ndx = 0; ndx < hooks.n; ndx++)
+		printHook(&lookup, hooks.hooks + ndx);
+
+	fprintf(stderr, "%u hooks\n", hooks.n);
+
+	elfHooksDeinit(&hooks);
+	elfLookupDeinit(&lookup);
+	elfDeinit(&elf);
+	return EXIT_SUCCESS;
+
+failHooks:
+	elfLookupDeinit(&lookup);
+failElfMakeSections:
+	elfDeinit(&elf);
+failElfInit:
+	return EXIT_FAILURE;
+
+failInval:
+	fprintf(stderr, "usage: %s hooks [-e] <DUMP.ELF> [<INFO.BIN | DIRECTORY>...]\n"
+		"\n"
+		"  -e  check the beginnings of exports too\n",
+		argv[-1]);
+	return EXIT_FAILURE;
+}
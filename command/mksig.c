@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "../elf/sig.h"
+#include "../elf/sigextract.h"
+#include "mksig.h"
+
+int mksigMain(int argc, char *argv[])
+{
+	struct elfSigEntry *entries;
+	struct timespec start;
+	struct timespec end;
+	const char *output = NULL;
+	char *defaultOutput = NULL;
+	size_t n;
+	int result = EXIT_FAILURE;
+	int opt;
+
+	/* Skip the command name. */
+	argc--;
+	argv++;
+
+	while ((opt = getopt(argc, argv, "o:")) != -1) {
+		switch (opt) {
+		case 'o':
+			output = optarg;
+			break;
+
+		default:
+			goto failInval;
+		}
+	}
+
+	if (argc - optind < 1)
+		goto failInval;
+
+	if (output == NULL) {
+		defaultOutput = elfSigPath();
+		if (defaultOutput == NULL) {
+			fputs("set VITASDK or VITA_ANALYZE_SIGS, or give -o\n",
+			      stderr);
+			return EXIT_FAILURE;
+		}
+
+		output = defaultOutput;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (elfSigExtract((const char * const *)argv + optind, argc - optind,
+			  &entries, &n) != 0)
+		goto failExtract;
+
+	const size_t extracted = n;
+	if (elfSigWrite(output, entries, &n) != 0)
+		goto failWrite;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	fprintf(stderr, "%s: %zu signatures of %zu functions in %.3f s\n",
+		output, n, extracted,
+		(double)(end.tv_sec - start.tv_sec)
+		+ (end.tv_nsec - start.tv_nsec) / 1e9);
+
+	result = EXIT_SUCCESS;
+
+failWrite:
+	elfSigExtractFree(entries, extracted);
+failExtract:
+	free(defaultOutput);
+	return result;
+
+failInval:
+	fprintf(stderr, "usage: %s mksig [-o SIGNATURES] <ELF>...\n",
+		argv[-1]);
+	return EXIT_FAILURE;
+}
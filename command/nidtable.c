@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../nid/table.h"
+#include "../noisy/lib.h"
+#include "../readwhole.h"
+#include "nidtable.h"
+
+#define NIDTABLE_SUFFIXES_MAX 64
+
+struct corpus {
+	char **buffers;
+	size_t nBuffers;
+	const char **names;
+	size_t n;
+	size_t capacity;
+};
+
+/* Terminates every non-empty line in place and takes it as a name. */
+static int addCorpus(struct corpus * restrict corpus,
+		     const char * restrict path)
+{
+	size_t size;
+
+	char * const read = readWhole(path, &size);
+	if (read == NULL)
+		return -1;
+
+	/* The last line needs a byte for NUL. */
+	char * const buffer = noisyRealloc(read, size + 1);
+	if (buffer == NULL) {
+		free(read);
+		return -1;
+	}
+
+	buffer[size] = '\n';
+	corpus->buffers[corpus->nBuffers] = buffer;
+	corpus->nBuffers++;
+
+	char *line = buffer;
+	char * const btm = buffer + size;
+	while (line < btm) {
+		char * const newline = memchr(line, '\n', btm + 1 - line);
+		char *end = newline;
+
+		if (end > line && end[-1] == '\r')
+			end--;
+
+		*end = 0;
+
+		if (end > line) {
+			if (corpus->n >= corpus->capacity) {
+				const size_t capacity = corpus->capacity <= 0 ?
+					65536 : corpus->capacity * 2;
+				const char ** const names = noisyRealloc(
+					corpus->names,
+					capacity * sizeof(*names));
+				if (names == NULL)
+					return -1;
+
+				corpus->names = names;
+				corpus->capacity = capacity;
+			}
+
+			corpus->names[corpus->n] = line;
+			corpus->n++;
+		}
+
+		line = newline + 1;
+	}
+
+	return 0;
+}
+
+int nidtableMain(int argc, char *argv[])
+{
+	static const char * const defaultSuffixes[] = { "" };
+	const char *suffixes[NIDTABLE_SUFFIXES_MAX];
+	struct corpus corpus = { NULL, 0, NULL, 0, 0 };
+	struct timespec start;
+	struct timespec end;
+	const char *output = NULL;
+	char *defaultOutput = NULL;
+	size_t nSuffixes = 0;
+	int result = EXIT_FAILURE;
+	int opt;
+
+	/* Skip the command name. */
+	argc--;
+	argv++;
+
+	while ((opt = getopt(argc, argv, "o:s:")) != -1) {
+		switch (opt) {
+		case 'o':
+			output = optarg;
+			break;
+
+		case 's':
+			if (nSuffixes >= NIDTABLE_SUFFIXES_MAX)
+				goto failInval;
+
+			suffixes[nSuffixes] = optarg;
+			nSuffixes++;
+			break;
+
+		default:
+			goto failInval;
+		}
+	}
+
+	if (argc - optind < 1)
+		goto failInval;
+
+	if (output == NULL) {
+		defaultOutput = nidTablePath();
+		if (defaultOutput == NULL) {
+			fputs("set VITASDK or VITA_ANALYZE_NIDTABLE, or give -o\n",
+			      stderr);
+			return EXIT_FAILURE;
+		}
+
+		output = defaultOutput;
+	}
+
+	corpus.buffers = noisyMalloc((argc - optind) * sizeof(*corpus.buffers));
+	if (corpus.buffers == NULL)
+		goto failBuffers;
+
+	for (int ndx = optind; ndx < argc; ndx++)
+		if (addCorpus(&corpus, argv[ndx]) != 0)
+			goto failCorpus;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (nidTableBuild(output, corpus.names, corpus.n,
+			  nSuffixes > 0 ? suffixes : defaultSuffixes,
+			  nSuffixes > 0 ? nSuffixes : 1) != 0)
+		goto failCorpus;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	fprintf(stderr, "%s: %zu names hashed in %.3f s\n", output, corpus.n,
+		(double)(end.tv_sec - start.tv_sec)
+		+ (end.tv_nsec - start.tv_nsec) / 1e9);
+
+	result = EXIT_SUCCESS;
+
+failCorpus:
+	for (size_t ndx = 0; ndx < corpus.nBuffers; ndx++)
+		free(corpus.buffers[ndx]);
+
+	free(corpus.buffers);
+	free(corpus.names);
+failBuffers:
+	free(defaultOutput);
+	return result;
+
+failInval:
+	fprintf(stderr, "usage: %s build-nidtable [-o TABLE] [-s SUFFIX]... <CORPUS>...\n",
+		argv[-1]);
+	return EXIT_FAILURE;
+}
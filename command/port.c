@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../elf/driver.h"
+#include "../elf/image.h"
+#include "../elf/lookup.h"
+#include "../elf/port.h"
+#include "../elf/symfile.h"
+#include "../noisy/lib.h"
+#include "port.h"
+
+struct portOlds {
+	struct elfPortFunc *funcs;
+	size_t n;
+	size_t capacity;
+
+	/* Names the new dump already has, sorted. */
+	const char **taken;
+	size_t nTaken;
+};
+
+static int compareNames(const void *a, const void *b)
+{
+	return strcmp(*(const char * const *)a, *(const char * const *)b);
+}
+
+static int addOld(void *context, const struct elfSymFunc * restrict func)
+{
+	struct portOlds * const olds = context;
+
+	if (!elfSymFileIsNamed(func->name)
+	    || (olds->nTaken > 0
+		&& bsearch(&func->name, olds->taken, olds->nTaken,
+			   sizeof(*olds->taken), compareNames) != NULL))
+		return 0;
+
+	if (olds->n >= olds->capacity) {
+		const size_t capacity = olds->capacity <= 0 ?
+			1024 : olds->capacity * 2;
+		struct elfPortFunc * const funcs = noisyRealloc(
+			olds->funcs, capacity * sizeof(*funcs));
+		if (funcs == NULL)
+			return -1;
+
+		olds->funcs = funcs;
+		olds->capacity = capacity;
+	}
+
+	olds->funcs[olds->n].name = func->name;
+	olds->funcs[olds->n].bytes = func->bytes;
+	olds->funcs[olds->n].vaddr = func->vaddr;
+	olds->funcs[olds->n].size = func->size;
+	olds->n++;
+	return 0;
+}
+
+/* Takes placeholders as the functions to name, and the other names as
+   taken. */
+static int collectNews(const struct elf * restrict elf,
+		       const struct elfLookup * restrict lookup,
+		       struct elfPortFunc ** restrict news,
+		       size_t * restrict nNews, struct portOlds * restrict olds)
+{
+	*news = noisyMalloc(lookup->n * sizeof(**news) + 1);
+	if (*news == NULL)
+		return -1;
+
+	olds->taken = noisyMalloc(lookup->n * sizeof(*olds->taken) + 1);
+	if (olds->taken == NULL) {
+		free(*news);
+		return -1;
+	}
+
+	*nNews = 0;
+	olds->nTaken = 0;
+	for (Elf32_Word ndx = 0; ndx < lookup->n; ndx++) {
+		const struct elfLookupSym * const sym = lookup->syms + ndx;
+		const Elf32_Addr vaddr = sym->value & ~(Elf32_Addr)1;
+
+		if (elfSymFileIsNamed(sym->name)) {
+			olds->taken[olds->nTaken] = sym->name;
+			olds->nTaken++;
+			continue;
+		}
+
+		const unsigned char * const bytes = elfImageVaddrToPtr(
+			&elf->source, vaddr, sym->size, NULL);
+		if (ELF32_ST_TYPE(sym->info) == STT_OBJECT || sym->size <= 0
+		    || bytes == NULL)
+			continue;
+
+		(*news)[*nNews].name = sym->name;
+		(*news)[*nNews].bytes = bytes;
+		(*news)[*nNews].vaddr = vaddr;
+		(*news)[*nNews].size = sym->size;
+		(*nNews)++;
+	}
+
+	if (olds->nTaken > 0)
+		qsort(olds->taken, olds->nTaken, sizeof(*olds->taken),
+		      compareNames);
+
+	return 0;
+}
+
+int portMain(int argc, char *argv[])
+{
+	struct portOlds olds = { NULL, 0, 0, NULL, 0 };
+	struct elfPortFunc *news;
+	struct elfPortName *names;
+	struct elfSymFile file;
+	struct elfLookup lookup;
+	struct elf elf;
+	struct timespec start;
+	struct timespec end;
+	double threshold = ELF_PORT_THRESHOLD;
+	char *tail;
+	size_t nNews;
+	size_t nNames;
+	int result = EXIT_FAILURE;
+	int opt;
+
+	/* Skip the command name. */
+	argc--;
+	argv++;
+
+	while ((opt = getopt(argc, argv, "t:")) != -1) {
+		switch (opt) {
+		case 't':
+			threshold = strtod(optarg, &tail);
+			if (*tail != 0 || !(threshold > 0 && threshold <= 1))
+				goto failInval;
+
+			break;
+
+		default:
+			goto failInval;
+		}
+	}
+
+	if (argc - optind < 2)
+		goto failInval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (elfSymFileOpen(&file, argv[optind]) != 0)
+		return EXIT_FAILURE;
+
+	if (elfInit(&elf, argv[optind + 1]) != 0)
+		goto failElfInit;
+
+	if (elfMakeSections(&elf, (const char * const *)argv + optind + 2,
+			    argc - optind - 2) != 0)
+		goto failElfMakeSections;
+
+	if (elfLookupInitElf(&lookup, &elf) != 0)
+		goto failElfMakeSections;
+
+	if (collectNews(&elf, &lookup, &news, &nNews, &olds) != 0)
+		goto failNews;
+
+	if (elfSymFileFuncs(&file, addOld, &olds) != 0)
+		goto failOlds;
+
+	elfPortHash(olds.funcs, olds.n);
+	elfPortHash(news, nNews);
+
+	if (elfPortMatch(olds.funcs, olds.n, news, nNews, threshold,
+			 &names, &nNames) != 0)
+		goto failOlds;
+
+	for (size_t ndx = 0; ndx < nNames; ndx++)
+		printf("0x%08X %s %.3f\n", names[ndx].vaddr, names[ndx].name,
+		       names[ndx].score);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	fprintf(stderr, "%zu of %zu functions named after %zu in %.3f s\n",
+		nNames, nNews, olds.n,
+		(double)(end.tv_sec - start.tv_sec)
+		+ (end.tv_nsec - start.tv_nsec) / 1e9);
+
+	result = EXIT_SUCCESS;
+	free(names);
+failOlds:
+	free(olds.funcs);
+	free(olds.taken);
+	free(news);
+failNews:
+	elfLookupDeinit(&lookup);
+failElfMakeSections:
+	elfDeinit(&elf);
+failElfInit:
+	elfSymFileClose(&file);
+	return result;
+
+failInval:
+	fprintf(stderr, "usage: %s port-symbols [-t THRESHOLD] <OLD.ELF> <DUMP.ELF> [<INFO.BIN | DIRECTORY>...]\n"
+		"\n"
+		"  -t  the fraction of equal hashes to name a function, %g by default\n",
+		argv[-1], ELF_PORT_THRESHOLD);
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,365 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../elf/driver.h"
+#include "../elf/index.h"
+#include "../elf/lookup.h"
+#include "../noisy/lib.h"
+#include "symbolize.h"
+
+/* The size of reads from stdin and of the buffer of stdout. */
+#define SYMBOLIZE_READ (1 << 20)
+
+#define SYMBOLIZE_BLOCK 64
+
+/* "0x", eight digits and the character after them. */
+#define SYMBOLIZE_TOKEN_MAX 11
+
+/* Characters kept before the unprocessed input to tell where tokens
+   begin. */
+#define SYMBOLIZE_BEHIND 3
+
+/* Zeros after the input, so that blocks are read beyond it. */
+#define SYMBOLIZE_PADDING (2 * SYMBOLIZE_BLOCK)
+
+struct symbolizeFilter {
+	const struct elfLookup *lookup;
+	const struct elfIndex *index;
+	unsigned char *buffer;
+	size_t size;
+
+	/* Where the input not written yet begins. */
+	size_t start;
+
+	/* Written to stdout when full, without locking of stdio. */
+	unsigned char *output;
+	size_t outputSize;
+	bool failed;
+
+	unsigned long long rewritten;
+};
+
+/* Returns a mask of hexadecimal digits. Digits are told a byte each without
+   branches so that compilers vectorize it, and each eight of the bytes are
+   gathered into bits with a multiplication. */
+static uint64_t hexMask(const unsigned char * restrict bytes)
+{
+	unsigned char flags[SYMBOLIZE_BLOCK];
+	uint64_t mask = 0;
+
+	for (int ndx = 0; ndx < SYMBOLIZE_BLOCK; ndx++) {
+		const unsigned char digit = bytes[ndx] - '0';
+		const unsigned char letter = (bytes[ndx] | 0x20) - 'a';
+
+		flags[ndx] = (digit < 10) | (letter < 6);
+	}
+
+	for (int ndx = 0; ndx < SYMBOLIZE_BLOCK / 8; ndx++) {
+		uint64_t word;
+
+		memcpy(&word, flags + ndx * 8, sizeof(word));
+		mask |= (word * UINT64_C(0x0102040810204080) >> 56) << ndx * 8;
+	}
+
+	return mask;
+}
+
+/* Returns a mask of positions which begin eight digits, given the masks of
+   digits of a block and the next one. */
+static uint64_t runMask(uint64_t mask, uint64_t next)
+{
+	uint64_t runs = mask;
+
+	for (int shift = 1; shift < 8; shift++)
+		runs &= mask >> shift | next << (SYMBOLIZE_BLOCK - shift);
+
+	return runs;
+}
+
+static unsigned int firstSet(uint64_t mask)
+{
+#ifdef __GNUC__
+	return __builtin_ctzll(mask);
+#else
+	unsigned int ndx = 0;
+
+	while ((mask & (UINT64_C(1) << ndx)) == 0)
+		ndx++;
+
+	return ndx;
+#endif
+}
+
+static bool isIdentifier(unsigned char c)
+{
+	return (c >= '0' && c <= '9') || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z')
+	       || c == '_';
+}
+
+/* Letters have bit 6 set and the low four bits from 1, so that digits are
+   parsed without branches. */
+static Elf32_Addr parseHex(const unsigned char * restrict digits)
+{
+	Elf32_Addr vaddr = 0;
+
+	for (int ndx = 0; ndx < 8; ndx++)
+		vaddr = vaddr << 4
+			| ((digits[ndx] & 0xF) + 9 * (digits[ndx] >> 6));
+
+	return vaddr;
+}
+
+static void writeAll(struct symbolizeFilter * restrict filter,
+		     const unsigned char * restrict bytes, size_t size)
+{
+	while (size > 0 && !filter->failed) {
+		const ssize_t result = write(STDOUT_FILENO, bytes, size);
+		if (result < 0) {
+			if (errno == EINTR)
+				continue;
+
+			perror("stdout");
+			filter->failed = true;
+			return;
+		}
+
+		bytes += result;
+		size -= result;
+	}
+}
+
+static void flush(struct symbolizeFilter * restrict filter)
+{
+	writeAll(filter, filter->output, filter->outputSize);
+	filter->outputSize = 0;
+}
+
+static void put(struct symbolizeFilter * restrict filter,
+		const void * restrict bytes, size_t size)
+{
+	if (size > SYMBOLIZE_READ - filter->outputSize)
+		flush(filter);
+
+	if (size >= SYMBOLIZE_READ) {
+		writeAll(filter, bytes, size);
+	} else {
+		memcpy(filter->output + filter->outputSize, bytes, size);
+		filter->outputSize += size;
+	}
+}
+
+/* Writes "+0x" and the offset in hexadecimal. */
+static void putOffset(struct symbolizeFilter * restrict filter,
+		      Elf32_Word offset)
+{
+	static const char digits[] = "0123456789ABCDEF";
+	char text[sizeof("+0x") - 1 + 8];
+	size_t ndx = sizeof(text);
+
+	do {
+		ndx--;
+		text[ndx] = digits[offset & 0xF];
+		offset >>= 4;
+	} while (offset != 0);
+
+	text[--ndx] = 'x';
+	text[--ndx] = '0';
+	text[--ndx] = '+';
+	put(filter, text + ndx, sizeof(text) - ndx);
+}
+
+static void emit(struct symbolizeFilter * restrict filter, size_t end)
+{
+	put(filter, filter->buffer + filter->start, end - filter->start);
+	filter->start = end;
+}
+
+/* Rewrites the address whose digits begin at ndx if it is a whole word and
+   some symbol covers it. */
+static void rewrite(struct symbolizeFilter * restrict filter, size_t ndx)
+{
+	const unsigned char * const buffer = filter->buffer;
+	size_t first = ndx;
+
+	if (ndx < filter->start)
+		return;
+
+	if (ndx >= filter->start + 2 && (buffer[ndx - 1] | 0x20) == 'x'
+	    && buffer[ndx - 2] == '0')
+		first = ndx - 2;
+
+	if ((first > 0 && isIdentifier(buffer[first - 1]))
+	    || isIdentifier(buffer[ndx + 8]))
+		return;
+
+	const Elf32_Addr vaddr = parseHex(buffer + ndx);
+	const struct elfLookupSym * const sym = elfIndexFindSym(
+		filter->index, filter->lookup, vaddr);
+	if (sym == NULL)
+		return;
+
+	emit(filter, first);
+	put(filter, sym->name, strlen(sym->name));
+	putOffset(filter, vaddr - sym->value);
+	filter->start = ndx + 8;
+	filter->rewritten++;
+}
+
+/* Rewrites addresses whose digits begin before limit. */
+static void scan(struct symbolizeFilter * restrict filter, size_t limit)
+{
+	size_t block = filter->start;
+	uint64_t mask = hexMask(filter->buffer + block);
+
+	while (block < limit) {
+		const uint64_t next = hexMask(filter->buffer + block
+					      + SYMBOLIZE_BLOCK);
+		uint64_t runs = runMask(mask, next);
+
+		if (limit - block < SYMBOLIZE_BLOCK)
+			runs &= (UINT64_C(1) << (limit - block)) - 1;
+
+		while (runs != 0) {
+			rewrite(filter, block + firstSet(runs));
+			runs &= runs - 1;
+		}
+
+		mask = next;
+		block += SYMBOLIZE_BLOCK;
+	}
+}
+
+static int run(struct symbolizeFilter * restrict filter)
+{
+	bool eof = false;
+
+	while (!eof && !filter->failed) {
+		while (filter->size < SYMBOLIZE_READ && !eof) {
+			const ssize_t result = read(
+				STDIN_FILENO, filter->buffer + filter->size,
+				SYMBOLIZE_READ - filter->size);
+			if (result < 0) {
+				if (errno == EINTR)
+					continue;
+
+				perror("stdin");
+				return -1;
+			}
+
+			eof = result == 0;
+			filter->size += result;
+		}
+
+		memset(filter->buffer + filter->size, 0, SYMBOLIZE_PADDING);
+
+		/* Tokens beginning before limit end in the buffer, and so
+		   does the character after them. */
+		const size_t limit = eof ? filter->size :
+			filter->size - SYMBOLIZE_TOKEN_MAX;
+
+		scan(filter, limit);
+
+		/* Keep "0x" which may prefix digits after limit. */
+		emit(filter, eof ? filter->size :
+			     limit - 2 > filter->start ? limit - 2 :
+							 filter->start);
+
+		const size_t keep = filter->start > SYMBOLIZE_BEHIND ?
+			filter->start - SYMBOLIZE_BEHIND : 0;
+
+		memmove(filter->buffer, filter->buffer + keep,
+			filter->size - keep);
+		filter->size -= keep;
+		filter->start -= keep;
+	}
+
+	flush(filter);
+	return filter->failed ? -1 : 0;
+}
+
+int symbolizeMain(int argc, char *argv[])
+{
+	struct symbolizeFilter context;
+	struct elfLookup lookup;
+	struct elfIndex index;
+	struct elf elf;
+	int result = EXIT_FAILURE;
+
+	if (argc < 3) {
+		fprintf(stderr, "usage: %s symbolize <DUMP.ELF> [<INFO.BIN | DIRECTORY>...] < <LOG> > <OUTPUT>\n",
+			argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (elfInit(&elf, argv[2]) != 0)
+		goto failElfInit;
+
+	if (elfMakeSections(&elf, (const char * const *)argv + 3, argc - 3)
+	    != 0)
+		goto failElfMakeSections;
+
+	if (elfLookupInitElf(&lookup, &elf) != 0)
+		goto failElfMakeSections;
+
+	if (elfIndexInit(&index, &lookup) != 0)
+		goto failIndex;
+
+	/* The buffer holds a read after what is kept of the last one. */
+	context.buffer = noisyMalloc(SYMBOLIZE_READ + SYMBOLIZE_PADDING);
+	if (context.buffer == NULL)
+		goto failBuffer;
+
+	context.output = noisyMalloc(SYMBOLIZE_READ);
+	if (context.output == NULL)
+		goto failOutput;
+
+	context.lookup = &lookup;
+	context.index = &index;
+	context.size = 0;
+	context.start = 0;
+	context.outputSize = 0;
+	context.failed = false;
+	context.rewritten = 0;
+
+	if (run(&context) != 0)
+		goto failFilter;
+
+	fprintf(stderr, "%llu addresses rewritten\n", context.rewritten);
+	result = EXIT_SUCCESS;
+
+failFilter:
+	free(context.output);
+failOutput:
+	free(context.buffer);
+failBuffer:
+	elfIndexDeinit(&index);
+failIndex:
+	elfLookupDeinit(&lookup);
+failElfMakeSections:
+	elfDeinit(&elf);
+failElfInit:
+	return result;
+}
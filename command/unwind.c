@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../elf/core.h"
+#include "../elf/driver.h"
+#include "../elf/elf.h"
+#include "../elf/lookup.h"
+#include "../elf/unwind.h"
+#include "unwind.h"
+
+/* Stops unwinding a thread whose stack is looping or corrupted. */
+#define UNWIND_FRAMES_MAX 256
+
+static void printFrame(const struct elfLookup * restrict lookup,
+		       unsigned int frame, Elf32_Addr pc, Elf32_Addr vaddr)
+{
+	const struct elfLookupSym * const sym = elfLookupFind(lookup, vaddr);
+
+	if (sym == NULL)
+		printf("  #%-3u 0x%08X ??\n", frame, pc);
+	else
+		printf("  #%-3u 0x%08X %s+0x%X\n",
+		       frame, pc, sym->name, pc - sym->value);
+}
+
+static void unwindThread(const struct elfUnwind * restrict unwind,
+			 const struct elfLookup * restrict lookup,
+			 const SceCoreThreadRegs * restrict thread)
+{
+	Elf32_Word regs[16];
+
+	memcpy(regs, thread->gpr, sizeof(regs));
+	printf("thread 0x%08X\n", thread->uid);
+
+	for (unsigned int frame = 0; frame < UNWIND_FRAMES_MAX; frame++) {
+		const Elf32_Addr pc = regs[ELF_UNWIND_PC] & ~(Elf32_Addr)1;
+
+		/* A return address is after the call. */
+		const Elf32_Addr vaddr = frame > 0 ? pc - 1 : pc;
+		const Elf32_Addr sp = regs[ELF_UNWIND_SP];
+
+		printFrame(lookup, frame, pc, vaddr);
+
+		const int result = elfUnwindStep(unwind, vaddr, regs);
+		if (result < 0)
+			puts("  (broken frame)");
+
+		if (result != 0 || regs[ELF_UNWIND_PC] == 0
+		    || (regs[ELF_UNWIND_SP] == sp
+			&& (regs[ELF_UNWIND_PC] & ~(Elf32_Addr)1) == pc))
+			break;
+	}
+}
+
+int unwindMain(int argc, char *argv[])
+{
+	struct elfLookup lookup;
+	struct elfUnwind unwind;
+	struct elf elf;
+	SceCoreThreadRegs *threads;
+	Elf32_Word n;
+
+	if (argc < 3) {
+		fprintf(stderr, "usage: %s unwind <DUMP.ELF> [<INFO.BIN | DIRECTORY>...]\n",
+			argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (elfInit(&elf, argv[2]) != 0)
+		goto failElfInit;
+
+	if (elfMakeSections(&elf, (const char * const *)argv + 3, argc - 3)
+	    != 0)
+		goto failElfMakeSections;
+
+	if (elfLookupInitElf(&lookup, &elf) != 0)
+		goto failElfMakeSections;
+
+	if (elfUnwindInit(&unwind, &elf.source, elf.modules, elf.nModules)
+	    != 0)
+		goto failUnwind;
+
+	if (elfCoreReadThreadRegs(&elf.source, &threads, &n) != 0)
+		goto failThreads;
+
+	for (Elf32_Word ndx = 0; ndx < n; ndx++)
+		unwindThread(&unwind, &lookup, threads + ndx);
+
+	free(threads);
+	elfUnwindDeinit(&unwind);
+	elfLookupDeinit(&lookup);
+	elfDeinit(&elf);
+	return EXIT_SUCCESS;
+
+failThreads:
+	elfUnwindDeinit(&unwind);
+failUnwind:
+	elfLookupDeinit(&lookup);
+failElfMakeSections:
+	elfDeinit(&elf);
+failElfInit:
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../elf/driver.h"
+#include "../elf/elf.h"
+#include "../noisy/fcntl.h"
+#include "../noisy/lib.h"
+#include "../noisy/mman.h"
+#include "update.h"
+
+/* Rebuilds the sections after the dump embedded in an output. Only the
+   pages needed to resolve symbols are read, and only the tail is
+   written. */
+static int update(const char * restrict path,
+		  const char * const * restrict infoPaths, Elf32_Word nInfos)
+{
+	struct elf elf;
+	int result = -1;
+
+	struct noisyFile * const file = noisyOpen(path, O_RDWR);
+	if (file == NULL)
+		goto failOpen;
+
+	const off_t size = noisyLseek(file, 0, SEEK_END);
+	if (size < 0)
+		goto failSeek;
+
+	if ((size_t)size < sizeof(Elf32_Ehdr)) {
+		fprintf(stderr, "%s: too small file\n", path);
+		goto failSeek;
+	}
+
+	void * const buffer = noisyMmap(file, size);
+	if (buffer == NULL)
+		goto failSeek;
+
+	/* This change stays in the private mapping. */
+	Elf32_Ehdr * const ehdr = buffer;
+	const Elf32_Off shoff = ehdr->e_shoff;
+	if (ehdr->e_shnum <= 0 || shoff < sizeof(*ehdr) || shoff > size) {
+		fprintf(stderr, "%s: not an output of vita-analyze\n", path);
+		goto failFormat;
+	}
+
+	ehdr->e_shoff = 0;
+	ehdr->e_shnum = 0;
+	ehdr->e_shstrndx = SHN_UNDEF;
+
+	if (elfInitBuffer(&elf, buffer, shoff, path) != 0)
+		goto failFormat;
+
+	if (elfMakeSections(&elf, infoPaths, nInfos) != 0)
+		goto failFormat;
+
+	struct elfChunk * const chunks
+		= noisyMalloc(ELF_CHUNK_MAX(elf.shnum) * sizeof(*chunks));
+	if (chunks == NULL)
+		goto failChunks;
+
+	Elf32_Ehdr newEhdr;
+	const Elf32_Word n = elfLayout(&elf, &newEhdr, chunks);
+
+	/* The new tail overwrites the old one in place, so an interrupted
+	   update leaves the output broken; convert the dump again then. */
+	for (Elf32_Word ndx = ELF_CHUNK_HEAD; ndx < n; ndx++)
+		if (noisyPwrite(file, chunks[ndx].buffer, chunks[ndx].size,
+				chunks[ndx].offset) != chunks[ndx].size)
+			goto failWrite;
+
+	if (noisyFtruncate(file, chunks[n - 1].offset + chunks[n - 1].size)
+	    != 0)
+		goto failWrite;
+
+	if (noisyPwrite(file, &newEhdr, sizeof(newEhdr), 0)
+	    != sizeof(newEhdr))
+		goto failWrite;
+
+	result = 0;
+
+failWrite:
+	free(chunks);
+failChunks:
+	elfDeinitSections(&elf);
+failFormat:
+	noisyMunmap(buffer, size);
+failSeek:
+	if (noisyClose(file) != 0)
+		result = -1;
+failOpen:
+	return result;
+}
+
+/* INFO.BIN and directories are never ELF files, so an ELF file begins the
+   arguments of the next output. */
+static bool isElf(const char *path)
+{
+	unsigned char ident[SELFMAG];
+
+	const int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	const bool result = read(fd, ident, sizeof(ident)) == (ssize_t)sizeof(ident)
+			    && memcmp(ident, ELFMAG, SELFMAG) == 0;
+	close(fd);
+	return result;
+}
+
+int updateMain(int argc, char *argv[])
+{
+	int result = EXIT_SUCCESS;
+
+	if (argc < 3) {
+		fprintf(stderr, "usage: %s update <OUTPUT.ELF> [<INFO.BIN | DIRECTORY>...] [<OUTPUT.ELF> [<INFO.BIN | DIRECTORY>...]]...\n",
+			argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	int ndx = 2;
+	while (ndx < argc) {
+		const int output = ndx;
+
+		do
+			ndx++;
+		while (ndx < argc && !isElf(argv[ndx]));
+
+		if (update(argv[output], (const char * const *)argv + output + 1,
+			   ndx - output - 1) != 0)
+			result = EXIT_FAILURE;
+	}
+
+	return result;
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "../elf/branch.h"
+#include "../elf/driver.h"
+#include "../elf/lookup.h"
+#include "../elf/xref.h"
+#include "xref.h"
+
+int xrefMain(int argc, char *argv[])
+{
+	struct elfLookup lookup;
+	struct elfXref xref;
+	struct elf elf;
+	unsigned int sets = ELF_BRANCH_THUMB;
+	const char *output = NULL;
+	bool list = false;
+	int opt;
+
+	/* Skip the command name. */
+	argc--;
+	argv++;
+
+	while ((opt = getopt(argc, argv, "alo:")) != -1) {
+		switch (opt) {
+		case 'a':
+			sets |= ELF_BRANCH_ARM;
+			break;
+
+		case 'l':
+			list = true;
+			break;
+
+		case 'o':
+			output = optarg;
+			break;
+
+		default:
+			goto failInval;
+		}
+	}
+
+	if (argc - optind < 1)
+		goto failInval;
+
+	if (list)
+		return elfXrefPrint(argv[optind],
+				    (const char * const *)argv + optind + 1,
+				    argc - optind - 1) == 0 ?
+			EXIT_SUCCESS : EXIT_FAILURE;
+
+	if (elfInit(&elf, argv[optind]) != 0)
+		goto failElfInit;
+
+	if (elfMakeSections(&elf, (const char * const *)argv + optind + 1,
+			    argc - optind - 1) != 0)
+		goto failElfMakeSections;
+
+	if (elfLookupInitElf(&lookup, &elf) != 0)
+		goto failElfMakeSections;
+
+	if (elfXrefInit(&xref, &elf.source, &lookup, sets) != 0)
+		goto failXref;
+
+	FILE * const fp = output == NULL ? stdout : fopen(output, "wb");
+	if (fp == NULL) {
+		perror(output);
+		goto failOpen;
+	}
+
+	if (elfXrefWrite(&xref, fp) != 0)
+		goto failWrite;
+
+	if (fp != stdout && fclose(fp) != 0) {
+		perror(output);
+		goto failOpen;
+	}
+
+	fprintf(stderr, "%u calls to %u functions\n", xref.nSites,
+		xref.nTargets);
+
+	elfXrefDeinit(&xref);
+	elfLookupDeinit(&lookup);
+	elfDeinit(&elf);
+	return EXIT_SUCCESS;
+
+failWrite:
+	if (fp != stdout)
+		fclose(fp);
+failOpen:
+	elfXrefDeinit(&xref);
+failXref:
+	elfLookupDeinit(&lookup);
+failElfMakeSections:
+	elfDeinit(&elf);
+failElfInit:
+	return EXIT_FAILURE;
+
+failInval:
+	fprintf(stderr, "usage: %s xref [-a] [-o INDEX] <DUMP.ELF> [<INFO.BIN | DIRECTORY>...]\n"
+		"       %s xref -l <INDEX> [NAME]...\n"
+		"\n"
+		"  -a  decode ARM code too\n",
+		argv[-1], argv[-1]);
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "crc32.h"
+
+static uint32_t table[256];
+static pthread_once_t tableOnce = PTHREAD_ONCE_INIT;
+
+static void tableInit(void)
+{
+	for (uint32_t ndx = 0; ndx < 256; ndx++) {
+		uint32_t value = ndx;
+
+		for (int bit = 0; bit < 8; bit++)
+			value = (value & 1) != 0 ?
+				0xEDB88320 ^ (value >> 1) : value >> 1;
+
+		table[ndx] = value;
+	}
+}
+
+uint32_t crc32(const void * restrict buffer, size_t size)
+{
+	const unsigned char *p = buffer;
+	uint32_t crc = 0xFFFFFFFF;
+
+	pthread_once(&tableOnce, tableInit);
+
+	while (size > 0) {
+		crc = table[(crc ^ *p) & 0xFF] ^ (crc >> 8);
+		p++;
+		size--;
+	}
+
+	return crc ^ 0xFFFFFFFF;
+}
@@ -0,0 +1,273 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "branch.h"
+#include "elf.h"
+#include "image.h"
+
+/* The number of positions prefiltered at once. */
+#define BRANCH_BLOCK 16
+
+/* Thumb branches by bits 15:12 of the second halfword when the first one
+   is 11110. */
+static const unsigned char thumbKinds[16] = {
+	[0x9] = ELF_BRANCH_B, [0xB] = ELF_BRANCH_B,
+	[0xC] = ELF_BRANCH_BLX, [0xE] = ELF_BRANCH_BLX,
+	[0xD] = ELF_BRANCH_BL, [0xF] = ELF_BRANCH_BL
+};
+
+enum elfBranchKind elfBranchThumb(uint16_t first, uint16_t second,
+				  Elf32_Addr vaddr,
+				  Elf32_Addr * restrict target)
+{
+	if ((first & 0xF800) != 0xF000)
+		return ELF_BRANCH_NONE;
+
+	const enum elfBranchKind kind = thumbKinds[second >> 12];
+	if (kind == ELF_BRANCH_NONE
+	    || (kind == ELF_BRANCH_BLX && (second & 1) != 0))
+		return ELF_BRANCH_NONE;
+
+	const uint32_t s = (first >> 10) & 1;
+	const uint32_t i1 = ~((second >> 13) ^ s) & 1;
+	const uint32_t i2 = ~((second >> 11) ^ s) & 1;
+	const uint32_t imm = (s << 24) | (i1 << 23) | (i2 << 22)
+			     | ((first & 0x3FFu) << 12) | ((second & 0x7FFu) << 1);
+
+	/* Sign-extend 25 bits. */
+	const Elf32_Addr offset = (imm ^ 0x1000000) - 0x1000000;
+
+	*target = kind == ELF_BRANCH_BLX ?
+		((vaddr + 4) & ~(Elf32_Addr)3) + offset :
+		(vaddr + 4 + offset) | 1;
+
+	return kind;
+}
+
+/* Decodes B<c>.W. */
+static int condThumb(uint16_t first, uint16_t second, Elf32_Addr vaddr,
+		     Elf32_Addr * restrict target)
+{
+	if ((first & 0xF800) != 0xF000 || (second & 0xD000) != 0x8000
+	    || (first & 0x0380) == 0x0380)
+		return 0;
+
+	const uint32_t imm = ((first & 0x400u) << 10) | ((second & 0x800u) << 8)
+			     | ((second & 0x2000u) << 5) | ((first & 0x3Fu) << 12)
+			     | ((second & 0x7FFu) << 1);
+
+	/* Sign-extend 21 bits. */
+	*target = (vaddr + 4 + ((imm ^ 0x100000) - 0x100000)) | 1;
+	return 1;
+}
+
+void elfBranchDecodeThumb(uint16_t first, uint16_t second, Elf32_Addr vaddr,
+			  struct elfBranchInsn * restrict insn)
+{
+	insn->kind = ELF_BRANCH_NONE;
+	insn->target = 0;
+
+	if (first >> 11 >= 0x1D) {
+		insn->size = 2 * sizeof(uint16_t);
+		insn->kind = elfBranchThumb(first, second, vaddr,
+					    &insn->target);
+
+		if (insn->kind != ELF_BRANCH_NONE)
+			return;
+
+		if (condThumb(first, second, vaddr, &insn->target))
+			insn->kind = ELF_BRANCH_COND;
+		/* POP.W with PC and LDR PC, [SP], #4. */
+		else if ((first == 0xE8BD && (second & 0x8000) != 0)
+			 || (first == 0xF85D && second == 0xFB04))
+			insn->kind = ELF_BRANCH_RETURN;
+
+		return;
+	}
+
+	insn->size = sizeof(uint16_t);
+
+	if ((first & 0xF000) == 0xD000 && (first & 0x0E00) != 0x0E00) {
+		insn->kind = ELF_BRANCH_COND;
+		insn->target = (vaddr + 4
+				+ (((first & 0xFFu) << 1 ^ 0x100) - 0x100)) | 1;
+	} else if ((first & 0xF800) == 0xE000) {
+		insn->kind = ELF_BRANCH_B;
+		insn->target = (vaddr + 4
+				+ (((first & 0x7FFu) << 1 ^ 0x800) - 0x800)) | 1;
+	} else if ((first & 0xF500) == 0xB100) {
+		insn->kind = ELF_BRANCH_COND;
+		insn->target = (vaddr + 4 + ((first & 0x200u) >> 3)
+				+ ((first & 0xF8u) >> 2)) | 1;
+	} else if (first == 0x4770 || (first & 0xFF00) == 0xBD00) {
+		insn->kind = ELF_BRANCH_RETURN;
+	} else if ((first & 0xFF87) == 0x4700 || (first & 0xFF87) == 0x4687) {
+		insn->kind = ELF_BRANCH_INDIRECT;
+	}
+}
+
+enum elfBranchKind elfBranchArm(uint32_t word, Elf32_Addr vaddr,
+				Elf32_Addr * restrict target)
+{
+	if ((word & 0x0E000000) != 0x0A000000)
+		return ELF_BRANCH_NONE;
+
+	/* Sign-extend 26 bits. */
+	const Elf32_Addr offset = (((word & 0xFFFFFF) << 2) ^ 0x2000000)
+				  - 0x2000000;
+
+	if (word >> 28 == 0xF) {
+		*target = (vaddr + 8 + offset + ((word >> 23) & 2)) | 1;
+		return ELF_BRANCH_BLX;
+	}
+
+	/* Conditional branches are not calls nor tail calls. */
+	if (word >> 28 != 0xE)
+		return ELF_BRANCH_NONE;
+
+	*target = vaddr + 8 + offset;
+	return word & 0x01000000 ? ELF_BRANCH_BL : ELF_BRANCH_B;
+}
+
+/* Returns a mask of positions which may begin 32-bit Thumb branches. It has
+   no branches so that compilers vectorize it. */
+static uint32_t prefilterThumb(const unsigned char * restrict bytes)
+{
+	uint16_t halves[BRANCH_BLOCK + 1];
+	uint32_t mask = 0;
+
+	memcpy(halves, bytes, sizeof(halves));
+	for (int ndx = 0; ndx < BRANCH_BLOCK; ndx++)
+		mask |= (uint32_t)((halves[ndx] & 0xF800) == 0xF000
+				   && (halves[ndx + 1] & 0x8000) != 0) << ndx;
+
+	return mask;
+}
+
+static int sweepThumb(const unsigned char * restrict bytes, Elf32_Word size,
+		      Elf32_Addr vaddr, elfBranchVisit *visit, void *context)
+{
+	Elf32_Word offset = 0;
+
+	while (size - offset >= 2 * sizeof(uint16_t)) {
+		uint32_t mask;
+		Elf32_Word n;
+
+		if (size - offset >= (BRANCH_BLOCK + 1) * sizeof(uint16_t)) {
+			mask = prefilterThumb(bytes + offset);
+			n = BRANCH_BLOCK;
+		} else {
+			mask = 1;
+			n = 1;
+		}
+
+		for (Elf32_Word ndx = 0; mask != 0; ndx++, mask >>= 1) {
+			const Elf32_Word position = offset
+						    + ndx * sizeof(uint16_t);
+			uint16_t halves[2];
+			Elf32_Addr target;
+
+			if ((mask & 1) == 0)
+				continue;
+
+			memcpy(halves, bytes + position, sizeof(halves));
+			const enum elfBranchKind kind = elfBranchThumb(
+				halves[0], halves[1], vaddr + position,
+				&target);
+			if (kind != ELF_BRANCH_NONE) {
+				const int result = visit(context,
+							 vaddr + position + 1,
+							 target, kind);
+				if (result != 0)
+					return result;
+			}
+		}
+
+		offset += n * sizeof(uint16_t);
+	}
+
+	return 0;
+}
+
+static int sweepArm(const unsigned char * restrict bytes, Elf32_Word size,
+		    Elf32_Addr vaddr, elfBranchVisit *visit, void *context)
+{
+	/* ARM instructions are aligned in memory. */
+	for (Elf32_Word offset = -vaddr & 3;
+	     offset < size && size - offset >= sizeof(uint32_t);
+	     offset += sizeof(uint32_t)) {
+		uint32_t word;
+		Elf32_Addr target;
+
+		memcpy(&word, bytes + offset, sizeof(word));
+		if ((word & 0x0E000000) != 0x0A000000)
+			continue;
+
+		const enum elfBranchKind kind
+			= elfBranchArm(word, vaddr + offset, &target);
+		if (kind != ELF_BRANCH_NONE) {
+			const int result = visit(context, vaddr + offset,
+						 target, kind);
+			if (result != 0)
+				return result;
+		}
+	}
+
+	return 0;
+}
+
+int elfBranchSweep(const struct elfImage * restrict image, unsigned int sets,
+		   elfBranchVisit *visit, void *context)
+{
+	const Elf32_Ehdr * const ehdr = image->buffer;
+	const Elf32_Phdr * const phdrs
+		= elfImageOffToPtr(image, ehdr->e_phoff);
+
+	for (Elf32_Half ndx = 0; ndx < ehdr->e_phnum; ndx++) {
+		const Elf32_Phdr * const phdr = phdrs + ndx;
+		int result;
+
+		if (phdr->p_type != PT_LOAD || (phdr->p_flags & PF_X) == 0)
+			continue;
+
+		const unsigned char * const bytes
+			= elfImageOffToPtr(image, phdr->p_offset);
+
+		/* Thumb instructions are aligned to halfwords. */
+		const Elf32_Word skew = phdr->p_vaddr & 1;
+		if ((sets & ELF_BRANCH_THUMB) != 0 && phdr->p_filesz > skew) {
+			result = sweepThumb(bytes + skew,
+					    phdr->p_filesz - skew,
+					    phdr->p_vaddr + skew,
+					    visit, context);
+			if (result != 0)
+				return result;
+		}
+
+		if ((sets & ELF_BRANCH_ARM) != 0) {
+			result = sweepArm(bytes, phdr->p_filesz,
+					  phdr->p_vaddr, visit, context);
+			if (result != 0)
+				return result;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ELF_BRANCH_H
+#define ELF_BRANCH_H
+
+#include <stdint.h>
+#include "elf.h"
+#include "image.h"
+
+enum elfBranchKind {
+	ELF_BRANCH_NONE,
+	ELF_BRANCH_B,
+	ELF_BRANCH_BL,
+	ELF_BRANCH_BLX,
+
+	/* Only elfBranchDecodeThumb tells these. */
+	ELF_BRANCH_COND,
+	ELF_BRANCH_RETURN,
+	ELF_BRANCH_INDIRECT
+};
+
+/* An instruction as far as control flow is concerned. */
+struct elfBranchInsn {
+	Elf32_Word size;
+	enum elfBranchKind kind;
+	Elf32_Addr target;
+};
+
+/* Instruction sets elfBranchSweep decodes. */
+#define ELF_BRANCH_THUMB (1 << 0)
+#define ELF_BRANCH_ARM (1 << 1)
+
+/* Called for each branch. site and target have the Thumb bit if they are
+   Thumb code. A nonzero return stops the sweep with it. */
+typedef int elfBranchVisit(void *context, Elf32_Addr site,
+			   Elf32_Addr target, enum elfBranchKind kind);
+
+/* Decodes a 32-bit Thumb B.W, BL or BLX at vaddr. */
+enum elfBranchKind elfBranchThumb(uint16_t first, uint16_t second,
+				  Elf32_Addr vaddr,
+				  Elf32_Addr * restrict target);
+
+/* Decodes any Thumb instruction at vaddr. second is used only if it is 32
+   bits long. Conditional branches include CBZ and CBNZ; returns are BX LR
+   and pops to PC; other writes to PC without a target are indirect. */
+void elfBranchDecodeThumb(uint16_t first, uint16_t second, Elf32_Addr vaddr,
+			  struct elfBranchInsn * restrict insn);
+
+/* Decodes an unconditional ARM B, BL or BLX at vaddr. */
+enum elfBranchKind elfBranchArm(uint32_t word, Elf32_Addr vaddr,
+				Elf32_Addr * restrict target);
+
+/* Sweeps executable loadable segments linearly, at every halfword for Thumb
+   and at every word for ARM, without knowing instruction boundaries. */
+int elfBranchSweep(const struct elfImage * restrict image, unsigned int sets,
+		   elfBranchVisit *visit, void *context);
+
+#endif
@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../noisy/lib.h"
+#include "branch.h"
+#include "callgraph.h"
+#include "elf.h"
+#include "image.h"
+#include "lookup.h"
+
+#define CALLGRAPH_FILTER_BITS 16
+
+struct callgraphEdge {
+	uint32_t caller;
+	uint32_t callee;
+};
+
+struct callgraphSweep {
+	const struct elfLookup *lookup;
+	uint64_t filter[(1 << CALLGRAPH_FILTER_BITS) / 64];
+	struct callgraphEdge *edges;
+	size_t n;
+	size_t capacity;
+};
+
+static uint32_t hashStart(Elf32_Addr vaddr)
+{
+	return ((vaddr >> 1) * 0x9E3779B1) >> (32 - CALLGRAPH_FILTER_BITS);
+}
+
+static bool isFunc(const struct elfLookupSym * restrict sym)
+{
+	return ELF32_ST_TYPE(sym->info) == STT_FUNC
+	       || ELF32_ST_TYPE(sym->info) == STT_ARM_TFUNC;
+}
+
+static int visitBranch(void *context, Elf32_Addr site, Elf32_Addr target,
+		       enum elfBranchKind kind)
+{
+	struct callgraphSweep * const sweep = context;
+	const Elf32_Addr vaddr = target & ~(Elf32_Addr)1;
+	const uint32_t hash = hashStart(vaddr);
+
+	if ((sweep->filter[hash / 64] & (UINT64_C(1) << hash % 64)) == 0)
+		return 0;
+
+	const struct elfLookupSym * const callee
+		= elfLookupFind(sweep->lookup, vaddr);
+	if (callee == NULL || callee->value != vaddr || !isFunc(callee))
+		return 0;
+
+	const struct elfLookupSym * const caller
+		= elfLookupFind(sweep->lookup, site & ~(Elf32_Addr)1);
+	if (caller == NULL || !isFunc(caller))
+		return 0;
+
+	/* A jump to the beginning of itself is a loop. */
+	if (kind == ELF_BRANCH_B && caller->value == callee->value)
+		return 0;
+
+	if (sweep->n >= sweep->capacity) {
+		const size_t capacity = sweep->capacity <= 0 ?
+			1024 : sweep->capacity * 2;
+		struct callgraphEdge * const edges = noisyRealloc(
+			sweep->edges, capacity * sizeof(*edges));
+		if (edges == NULL)
+			return -1;
+
+		sweep->edges = edges;
+		sweep->capacity = capacity;
+	}
+
+	sweep->edges[sweep->n].caller = caller->ndx;
+	sweep->edges[sweep->n].callee = callee->ndx;
+	sweep->n++;
+	return 0;
+}
+
+static int compareNodes(const void *a, const void *b)
+{
+	const uint32_t x = *(const uint32_t *)a;
+	const uint32_t y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Sorts each row and drops repeated calls. */
+static void dedupe(struct elfCallgraph * restrict graph)
+{
+	uint32_t top = 0;
+
+	for (Elf32_Word node = 0; node < graph->nNodes; node++) {
+		uint32_t * const row = graph->callees + graph->offsets[node];
+		const uint32_t n = graph->offsets[node + 1]
+				   - graph->offsets[node];
+		const uint32_t first = top;
+
+		if (n > 1)
+			qsort(row, n, sizeof(*row), compareNodes);
+
+		for (uint32_t ndx = 0; ndx < n; ndx++)
+			if (top <= first || graph->callees[top - 1] != row[ndx]) {
+				graph->callees[top] = row[ndx];
+				top++;
+			}
+
+		graph->offsets[node] = first;
+	}
+
+	graph->offsets[graph->nNodes] = top;
+	graph->nEdges = top;
+}
+
+int elfCallgraphInit(struct elfCallgraph * restrict graph,
+		     const struct elfImage * restrict image,
+		     const struct elfLookup * restrict lookup,
+		     Elf32_Word nSyms, unsigned int sets)
+{
+	struct callgraphSweep sweep = { .lookup = lookup, .edges = NULL,
+					.n = 0, .capacity = 0 };
+
+	if (nSyms >= UINT32_MAX) {
+		fputs("too many symbols\n", stderr);
+		return -1;
+	}
+
+	memset(sweep.filter, 0, sizeof(sweep.filter));
+	for (Elf32_Word ndx = 0; ndx < lookup->n; ndx++) {
+		const uint32_t hash = hashStart(lookup->syms[ndx].value);
+
+		if (isFunc(lookup->syms + ndx))
+			sweep.filter[hash / 64] |= UINT64_C(1) << hash % 64;
+	}
+
+	if (elfBranchSweep(image, sets, visitBranch, &sweep) != 0)
+		goto fail;
+
+	if (sweep.n > UINT32_MAX) {
+		fputs("too many calls\n", stderr);
+		goto fail;
+	}
+
+	graph->nNodes = nSyms;
+	graph->offsets = noisyCalloc((nSyms + 1) * sizeof(*graph->offsets));
+	if (graph->offsets == NULL)
+		goto fail;
+
+	graph->callees = noisyMalloc(sweep.n * sizeof(*graph->callees) + 1);
+	if (graph->callees == NULL)
+		goto failCallees;
+
+	/* Counting sort by caller. offsets[n + 1] counts up to the end of
+	   row n, and is the beginning of row n + 1 after placing them. */
+	for (size_t ndx = 0; ndx < sweep.n; ndx++)
+		graph->offsets[sweep.edges[ndx].caller + 1]++;
+
+	for (Elf32_Word node = 0; node < nSyms; node++)
+		graph->offsets[node + 1] += graph->offsets[node];
+
+	for (size_t ndx = 0; ndx < sweep.n; ndx++) {
+		const uint32_t caller = sweep.edges[ndx].caller;
+
+		graph->callees[graph->offsets[caller]] = sweep.edges[ndx].callee;
+		graph->offsets[caller]++;
+	}
+
+	/* Each offset now points to the end of its row. */
+	for (Elf32_Word node = nSyms; node > 0; node--)
+		graph->offsets[node] = graph->offsets[node - 1];
+
+	graph->offsets[0] = 0;
+	dedupe(graph);
+
+	free(sweep.edges);
+	return 0;
+
+failCallees:
+	free(graph->offsets);
+fail:
+	free(sweep.edges);
+	return -1;
+}
+
+int elfCallgraphWrite(const struct elfCallgraph * restrict graph,
+		      FILE * restrict fp)
+{
+	struct elfCallgraphHeader header;
+
+	memcpy(header.magic, ELF_CALLGRAPH_MAGIC, sizeof(header.magic));
+	header.nNodes = graph->nNodes;
+	header.nEdges = graph->nEdges;
+
+	if (fwrite(&header, sizeof(header), 1, fp) != 1
+	    || fwrite(graph->offsets, sizeof(*graph->offsets),
+		      graph->nNodes + 1, fp) != graph->nNodes + 1
+	    || fwrite(graph->callees, sizeof(*graph->callees),
+		      graph->nEdges, fp) != graph->nEdges) {
+		perror(NULL);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int putLabel(const char * restrict name, FILE * restrict fp)
+{
+	if (putc('"', fp) == EOF)
+		return -1;
+
+	for (const char *cursor = name; *cursor != 0; cursor++)
+		if (((*cursor == '"' || *cursor == '\\')
+		     && putc('\\', fp) == EOF)
+		    || putc(*cursor, fp) == EOF)
+			return -1;
+
+	return putc('"', fp) == EOF ? -1 : 0;
+}
+
+int elfCallgraphWriteDot(const struct elfCallgraph * restrict graph,
+			 const struct elfLookup * restrict lookup,
+			 FILE * restrict fp)
+{
+	int result = -1;
+
+	const char ** const names
+		= noisyCalloc(graph->nNodes * sizeof(*names) + 1);
+	if (names == NULL)
+		return -1;
+
+	bool * const called = noisyCalloc(graph->nNodes + 1);
+	if (called == NULL)
+		goto failCalled;
+
+	for (Elf32_Word ndx = 0; ndx < lookup->n; ndx++)
+		if (lookup->syms[ndx].ndx < graph->nNodes)
+			names[lookup->syms[ndx].ndx] = lookup->syms[ndx].name;
+
+	for (Elf32_Word ndx = 0; ndx < graph->nEdges; ndx++)
+		called[graph->callees[ndx]] = true;
+
+	if (fputs("digraph callgraph {\n", fp) == EOF)
+		goto failWrite;
+
+	for (Elf32_Word node = 0; node < graph->nNodes; node++) {
+		if (!called[node]
+		    && graph->offsets[node] == graph->offsets[node + 1])
+			continue;
+
+		if (fprintf(fp, "\tn%u [label=", node) < 0
+		    || putLabel(names[node] == NULL ? "" : names[node], fp)
+		       != 0
+		    || fputs("];\n", fp) == EOF)
+			goto failWrite;
+	}
+
+	for (Elf32_Word node = 0; node < graph->nNodes; node++)
+		for (uint32_t ndx = graph->offsets[node];
+		     ndx < graph->offsets[node + 1];
+		     ndx++)
+			if (fprintf(fp, "\tn%u -> n%u;\n",
+				    node, graph->callees[ndx]) < 0)
+				goto failWrite;
+
+	if (fputs("}\n", fp) == EOF)
+		goto failWrite;
+
+	result = 0;
+	goto end;
+
+failWrite:
+	perror(NULL);
+end:
+	free(called);
+failCalled:
+	free(names);
+	return result;
+}
+
+void elfCallgraphDeinit(const struct elfCallgraph * restrict graph)
+{
+	free(graph->callees);
+	free(graph->offsets);
+}
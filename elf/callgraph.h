@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ELF_CALLGRAPH_H
+#define ELF_CALLGRAPH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "elf.h"
+#include "image.h"
+#include "lookup.h"
+
+#define ELF_CALLGRAPH_MAGIC "CALLGRF1"
+
+/* The binary file is the header, nNodes + 1 offsets and nEdges callees, all
+   in the byte order of the host. */
+struct elfCallgraphHeader {
+	char magic[8];
+	uint32_t nNodes;
+	uint32_t nEdges;
+};
+
+/* Calls between functions in compressed sparse rows. Nodes are indices in
+   .symtab; the callees of node n are callees[offsets[n]] up to
+   callees[offsets[n + 1]], sorted and distinct. */
+struct elfCallgraph {
+	uint32_t *offsets;
+	Elf32_Word nNodes;
+
+	uint32_t *callees;
+	Elf32_Word nEdges;
+};
+
+/* Sweeps executable segments for calls and tail calls from a function of
+   lookup to the beginning of another. nSyms is the number of symbols in
+   .symtab. */
+int elfCallgraphInit(struct elfCallgraph * restrict graph,
+		     const struct elfImage * restrict image,
+		     const struct elfLookup * restrict lookup,
+		     Elf32_Word nSyms, unsigned int sets);
+
+int elfCallgraphWrite(const struct elfCallgraph * restrict graph,
+		      FILE * restrict fp);
+
+/* Writes nodes with any edge, labeled with the names in lookup. */
+int elfCallgraphWriteDot(const struct elfCallgraph * restrict graph,
+			 const struct elfLookup * restrict lookup,
+			 FILE * restrict fp);
+
+void elfCallgraphDeinit(const struct elfCallgraph * restrict graph);
+
+#endif
@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../noisy/lib.h"
+#include "../overflow.h"
+#include "core.h"
+#include "elf.h"
+#include "image.h"
+#include "info.h"
+
+static Elf32_Word align4(Elf32_Word size)
+{
+	return (size + 3) & ~(Elf32_Word)3;
+}
+
+static const void *findNoteInSegment(const struct elfImage * restrict image,
+				     const Elf32_Phdr * restrict phdr,
+				     const char * restrict name,
+				     Elf32_Word * restrict size)
+{
+	const char * const segment = elfImageOffToPtr(image, phdr->p_offset);
+	const Elf32_Word nameSize = strlen(name) + 1;
+	Elf32_Word offset = 0;
+
+	while (phdr->p_filesz - offset >= sizeof(Elf32_Nhdr)) {
+		Elf32_Nhdr nhdr;
+
+		memcpy(&nhdr, segment + offset, sizeof(nhdr));
+		offset += sizeof(nhdr);
+
+		const Elf32_Word left = phdr->p_filesz - offset;
+		if (nhdr.n_namesz > left || align4(nhdr.n_namesz) > left
+		    || nhdr.n_descsz > left - align4(nhdr.n_namesz))
+			break;
+
+		const char * const noteName = segment + offset;
+		offset += align4(nhdr.n_namesz);
+
+		if (nhdr.n_namesz == nameSize
+		    && memcmp(noteName, name, nameSize) == 0) {
+			*size = nhdr.n_descsz;
+			return segment + offset;
+		}
+
+		if (align4(nhdr.n_descsz) > phdr->p_filesz - offset)
+			break;
+
+		offset += align4(nhdr.n_descsz);
+	}
+
+	return NULL;
+}
+
+const void *elfCoreFindNote(const struct elfImage * restrict image,
+			    const char * restrict name,
+			    Elf32_Word * restrict size)
+{
+	const void * const buffer = image->buffer;
+	const Elf32_Ehdr * const ehdr = buffer;
+	const Elf32_Phdr * const phdrsTop
+		= (void *)((char *)buffer + ehdr->e_phoff);
+	const Elf32_Phdr * const phdrsBtm = phdrsTop + ehdr->e_phnum;
+
+	for (const Elf32_Phdr *phdr = phdrsTop; phdr != phdrsBtm; phdr++) {
+		if (phdr->p_type != PT_NOTE)
+			continue;
+
+		const void * const desc = findNoteInSegment(image, phdr, name,
+							    size);
+		if (desc != NULL)
+			return desc;
+	}
+
+	return NULL;
+}
+
+int elfCoreReadModuleInfos(const struct elfImage * restrict image,
+			   SceKernelModuleInfo ** restrict infos,
+			   Elf32_Word * restrict n)
+{
+	SceCoreModulesHead head;
+	Elf32_Word size;
+
+	*infos = NULL;
+	*n = 0;
+
+	const char * const desc = elfCoreFindNote(image, ELF_CORE_MODULES,
+						  &size);
+	if (desc == NULL)
+		return 0;
+
+	if (size < sizeof(head))
+		goto failTruncated;
+
+	memcpy(&head, desc, sizeof(head));
+
+	/* Each module takes at least its head and tail. */
+	if (head.nModules > (size - sizeof(head))
+			    / (sizeof(SceCoreModuleHead)
+			       + sizeof(SceCoreModuleTail)))
+		goto failTruncated;
+
+	if (head.nModules <= 0)
+		return 0;
+
+	SceKernelModuleInfo * const result
+		= noisyCalloc(head.nModules * sizeof(*result));
+	if (result == NULL)
+		return -1;
+
+	Elf32_Word offset = sizeof(head);
+
+	for (Elf32_Word ndx = 0; ndx < head.nModules; ndx++) {
+		SceKernelModuleInfo * const info = result + ndx;
+		SceCoreModuleHead module;
+		SceCoreModuleTail tail;
+
+		if (size - offset < sizeof(module))
+			goto failTruncatedModule;
+
+		memcpy(&module, desc + offset, sizeof(module));
+		offset += sizeof(module);
+
+		Elf32_Word segsSize;
+		if (wmulOverflow(module.nSegs, sizeof(SceCoreSegment),
+				 &segsSize)
+		    || segsSize > size - offset
+		    || size - offset - segsSize < sizeof(tail))
+			goto failTruncatedModule;
+
+		for (Elf32_Word seg = 0; seg < module.nSegs; seg++) {
+			SceCoreSegment segment;
+
+			memcpy(&segment, desc + offset, sizeof(segment));
+			offset += sizeof(segment);
+
+			if (seg >= sizeof(info->segments)
+				   / sizeof(*info->segments))
+				continue;
+
+			info->segments[seg].size
+				= sizeof(info->segments[seg]);
+			info->segments[seg].perms = segment.attr;
+			info->segments[seg].vaddr = segment.vaddr;
+			info->segments[seg].memsz = segment.memsz;
+		}
+
+		memcpy(&tail, desc + offset, sizeof(tail));
+		offset += sizeof(tail);
+
+		/* The name of SceModuleInfo has only 27 bytes. */
+		if (memchr(module.module_name, 0,
+			   sizeof(((SceModuleInfo *)NULL)->name)) == NULL) {
+			fprintf(stderr, "%s: module 0x%08X: name is not null terminated ('\\0')\n",
+				image->path, module.uid);
+			goto fail;
+		}
+
+		info->size = sizeof(*info);
+		info->handle = module.uid;
+		memcpy(info->module_name, module.module_name,
+		       sizeof(info->module_name));
+		info->exidxTop = tail.exidxTop;
+		info->exidxBtm = tail.exidxBtm;
+	}
+
+	*infos = result;
+	*n = head.nModules;
+	return 0;
+
+failTruncatedModule:
+	free(result);
+failTruncated:
+	fprintf(stderr, "%s: %s note is truncated\n",
+		image->path, ELF_CORE_MODULES);
+	return -1;
+
+fail:
+	free(result);
+	return -1;
+}
+
+int elfCoreReadThreadRegs(const struct elfImage * restrict image,
+			  SceCoreThreadRegs ** restrict threads,
+			  Elf32_Word * restrict n)
+{
+	SceCoreThreadRegsHead head;
+	Elf32_Word size;
+
+	const char * const desc = elfCoreFindNote(image, ELF_CORE_THREAD_REGS,
+						  &size);
+	if (desc == NULL) {
+		fprintf(stderr, "%s: %s note not found\n",
+			image->path, ELF_CORE_THREAD_REGS);
+		return -1;
+	}
+
+	if (size < sizeof(head))
+		goto failTruncated;
+
+	memcpy(&head, desc, sizeof(head));
+	if (head.nThreads > (size - sizeof(head)) / sizeof(**threads))
+		goto failTruncated;
+
+	*threads = noisyMalloc(head.nThreads * sizeof(**threads) + 1);
+	if (*threads == NULL)
+		return -1;
+
+	Elf32_Word offset = sizeof(head);
+
+	for (Elf32_Word ndx = 0; ndx < head.nThreads; ndx++) {
+		SceCoreThreadRegs * const thread = *threads + ndx;
+
+		if (size - offset < sizeof(*thread))
+			goto failTruncatedThread;
+
+		memcpy(thread, desc + offset, sizeof(*thread));
+		if (thread->size < sizeof(*thread)
+		    || thread->size > size - offset)
+			goto failTruncatedThread;
+
+		offset += thread->size;
+	}
+
+	*n = head.nThreads;
+	return 0;
+
+failTruncatedThread:
+	free(*threads);
+failTruncated:
+	fprintf(stderr, "%s: %s note is truncated\n",
+		image->path, ELF_CORE_THREAD_REGS);
+	return -1;
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ELF_CORE_H
+#define ELF_CORE_H
+
+#include "elf.h"
+#include "image.h"
+#include "info.h"
+
+/* The layout of the notes of psp2core, the core dump of PS Vita, as
+   vita-parse-core reads them. Each note has the name of the table and no
+   meaningful type. */
+#define ELF_CORE_MODULES "MODULE_INFO"
+
+/* The descriptor of ELF_CORE_MODULES starts with this, followed by the
+   modules. */
+typedef struct {
+	SceUInt unk00;
+	SceUInt nModules;
+} SceCoreModulesHead;
+
+/* A module is this, followed by nSegs of SceCoreSegment and
+   SceCoreModuleTail. */
+typedef struct {
+	SceUInt unk00;
+	SceUInt uid;	//< module ID
+	SceUInt unk08[7];
+	char module_name[28];
+	SceUInt unk40[3];
+	SceUInt nSegs;
+} SceCoreModuleHead;
+
+typedef struct {
+	SceUInt unk00;
+	SceUInt attr;
+	Elf32_Addr vaddr;
+	SceUInt memsz;
+	SceUInt align;
+} SceCoreSegment;
+
+typedef struct {
+	Elf32_Addr exidxTop;
+	Elf32_Addr exidxBtm;
+	Elf32_Addr extabTop;
+	Elf32_Addr extabBtm;
+} SceCoreModuleTail;
+
+#define ELF_CORE_THREAD_REGS "THREAD_REG_INFO"
+
+/* The descriptor of ELF_CORE_THREAD_REGS starts with this, followed by the
+   threads. */
+typedef struct {
+	SceUInt unk00;
+	SceUInt nThreads;
+} SceCoreThreadRegsHead;
+
+/* The registers of a thread. size covers the registers of coprocessors
+   following this. */
+typedef struct {
+	SceUInt size;
+	SceUInt uid;	//< thread ID
+	Elf32_Word gpr[16];
+	Elf32_Word cpsr;
+} SceCoreThreadRegs;
+
+/* Finds the descriptor of the first note with the name in PT_NOTE segments.
+   Returns NULL if there is none. */
+const void *elfCoreFindNote(const struct elfImage * restrict image,
+			    const char * restrict name,
+			    Elf32_Word * restrict size);
+
+/* Makes SceKernelModuleInfo of every module in ELF_CORE_MODULES. infos is
+   allocated and must be freed. *n is 0 if the dump has no such note. */
+int elfCoreReadModuleInfos(const struct elfImage * restrict image,
+			   SceKernelModuleInfo ** restrict infos,
+			   Elf32_Word * restrict n);
+
+/* Copies the registers of every thread in ELF_CORE_THREAD_REGS. threads is
+   allocated and must be freed. */
+int elfCoreReadThreadRegs(const struct elfImage * restrict image,
+			  SceCoreThreadRegs ** restrict threads,
+			  Elf32_Word * restrict n);
+
+#endif
@@ -0,0 +1,393 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../noisy/lib.h"
+#include "../overflow.h"
+#include "../pool.h"
+#include "discover.h"
+#include "driver.h"
+#include "elf.h"
+#include "image.h"
+#include "info.h"
+
+/* The number of candidates tested at once by prefilter. */
+#define DISCOVER_BLOCK 16
+
+/* The size of the range of candidates validated by a job. */
+#define DISCOVER_SLICE (1 << 20)
+
+struct discoverJob {
+	const struct elfImage *image;
+	const Elf32_Phdr *phdr;
+	Elf32_Word from;
+	Elf32_Word to;
+	struct elfImageModule *modules;
+	Elf32_Word n;
+	Elf32_Word capacity;
+	int result;
+};
+
+/* Returns the first offset in [from, to) where SceModuleInfo may be, or to.
+   A candidate must have exports right after itself and imports right after
+   the exports, as elfImageFindInfos guesses. Offsets in SceModuleInfo are
+   relative to the base of the module, which may be anywhere in the segment
+   before the candidate, so the exports must not begin after the candidate
+   and must be a whole number of entries. A block is tested without
+   branches so that compilers vectorize it. */
+static Elf32_Word prefilter(const char * restrict segment,
+			    Elf32_Word from, Elf32_Word to)
+{
+	const Elf32_Word expTopOff = offsetof(SceModuleInfo, expTop);
+	Elf32_Word offset = from;
+
+	while (to - offset >= DISCOVER_BLOCK * sizeof(uint32_t)) {
+		/* expTop, expBtm and impTop of each candidate. */
+		uint32_t words[DISCOVER_BLOCK + 2];
+		int any = 0;
+
+		memcpy(words, segment + offset + expTopOff, sizeof(words));
+		for (int ndx = 0; ndx < DISCOVER_BLOCK; ndx++)
+			any |= (words[ndx] <= offset + ndx * sizeof(uint32_t)
+					      + sizeof(SceModuleInfo))
+				& (words[ndx] < words[ndx + 1])
+				& ((words[ndx + 1] - words[ndx])
+				   % sizeof(struct elfExp) == 0)
+				& (words[ndx + 1] == words[ndx + 2]);
+
+		if (any)
+			break;
+
+		offset += DISCOVER_BLOCK * sizeof(uint32_t);
+	}
+
+	for (; offset < to; offset += sizeof(uint32_t)) {
+		uint32_t words[3];
+
+		memcpy(words, segment + offset + expTopOff, sizeof(words));
+		if (words[0] <= offset + sizeof(SceModuleInfo)
+		    && words[0] < words[1]
+		    && (words[1] - words[0]) % sizeof(struct elfExp) == 0
+		    && words[1] == words[2])
+			return offset;
+	}
+
+	return to;
+}
+
+static bool isName(const char * restrict name, size_t max)
+{
+	const size_t length = strnlen(name, max);
+
+	if (length <= 0 || length >= max)
+		return false;
+
+	for (size_t ndx = 0; ndx < length; ndx++)
+		if (name[ndx] < 0x20 || name[ndx] > 0x7E)
+			return false;
+
+	return true;
+}
+
+static bool isString(const struct elfImage * restrict image, Elf32_Addr vaddr)
+{
+	Elf32_Word max;
+	const char * const string = elfImageVaddrToPtr(image, vaddr, 0, &max);
+
+	return string != NULL && strnlen(string, max) < max;
+}
+
+static bool isArray(const struct elfImage * restrict image,
+		    Elf32_Addr vaddr, Elf32_Word count)
+{
+	Elf32_Word size;
+
+	if (count <= 0)
+		return true;
+
+	if (wmulOverflow(count, sizeof(Elf32_Word), &size))
+		return false;
+
+	return elfImageVaddrToPtr(image, vaddr, size, NULL) != NULL;
+}
+
+static bool checkExps(const struct elfImage * restrict image,
+		      const struct elfImageExp * restrict exp)
+{
+	/* Every module exports at least the library without name. */
+	if (exp->top == exp->btm)
+		return false;
+
+	for (const struct elfExp *cursor = exp->top;
+	     cursor != exp->btm;
+	     cursor++) {
+		Elf32_Word total;
+
+		if (cursor->size != sizeof(*cursor))
+			return false;
+
+		if (waddOverflow(cursor->nFuncs, cursor->nVars, &total))
+			return false;
+
+		if (!isArray(image, cursor->nids, total)
+		    || !isArray(image, cursor->entries, total))
+			return false;
+
+		if (cursor->name != 0 && !isString(image, cursor->name))
+			return false;
+	}
+
+	return true;
+}
+
+static bool checkImps(const struct elfImage * restrict image,
+		      const struct elfImageImp * restrict imp)
+{
+	const Elf32_Word minimum = offsetof(struct elfImp, tlsNids);
+	const char *cursor = (const char *)imp->top;
+	const char * const btm = (const char *)imp->btm;
+
+	while (cursor != btm) {
+		const struct elfImp * const entry = (const void *)cursor;
+
+		if ((size_t)(btm - cursor) < minimum)
+			return false;
+
+		if ((entry->size != minimum && entry->size != sizeof(*entry))
+		    || (size_t)(btm - cursor) < entry->size)
+			return false;
+
+		if (!isString(image, entry->name))
+			return false;
+
+		if (!isArray(image, entry->funcNids, entry->nFuncs)
+		    || !isArray(image, entry->funcEntries, entry->nFuncs)
+		    || !isArray(image, entry->varNids, entry->nVars)
+		    || !isArray(image, entry->varEntries, entry->nVars))
+			return false;
+
+		if (entry->size >= sizeof(*entry)
+		    && (!isArray(image, entry->tlsNids, entry->nTls)
+			|| !isArray(image, entry->tlsEntries, entry->nTls)))
+			return false;
+
+		cursor += entry->size;
+	}
+
+	return true;
+}
+
+/* Validates a candidate at ndx which passed prefilter. */
+static bool checkCandidate(const struct elfImage * restrict image,
+			   const Elf32_Phdr * restrict phdr, Elf32_Word ndx,
+			   struct elfImageModule * restrict module)
+{
+	const char * const segment = elfImageOffToPtr(image, phdr->p_offset);
+	const SceModuleInfo * const info = (const void *)(segment + ndx);
+
+	if (!isName(info->name, sizeof(info->name)))
+		return false;
+
+	/* The exports are right after the candidate. */
+	const Elf32_Word expTopOff = ndx + sizeof(SceModuleInfo);
+	const Elf32_Word baseOff = expTopOff - info->expTop;
+
+	Elf32_Word expBtmOff;
+	if (waddOverflow(baseOff, info->expBtm, &expBtmOff)
+	    || expBtmOff > phdr->p_filesz)
+		return false;
+
+	Elf32_Word impTopOff;
+	Elf32_Word impBtmOff;
+	if (waddOverflow(baseOff, info->impTop, &impTopOff)
+	    || waddOverflow(baseOff, info->impBtm, &impBtmOff)
+	    || impTopOff > impBtmOff || impBtmOff > phdr->p_filesz)
+		return false;
+
+	module->name = info->name;
+	module->base = phdr->p_vaddr + baseOff;
+	module->info.ptr = info;
+	module->info.vaddr = phdr->p_vaddr + ndx;
+	module->exp.top = (const void *)(segment + expTopOff);
+	module->exp.btm = (const void *)(segment + expBtmOff);
+	module->imp.top = (const void *)(segment + impTopOff);
+	module->imp.btm = (const void *)(segment + impBtmOff);
+	module->found = true;
+
+	return checkExps(image, &module->exp) && checkImps(image, &module->imp);
+}
+
+static void discoverRange(struct discoverJob * restrict job)
+{
+	const char * const segment
+		= elfImageOffToPtr(job->image, job->phdr->p_offset);
+	struct elfImageModule module;
+
+	for (Elf32_Word ndx = prefilter(segment, job->from, job->to);
+	     ndx < job->to;
+	     ndx = prefilter(segment, ndx + sizeof(uint32_t), job->to)) {
+		if (!checkCandidate(job->image, job->phdr, ndx, &module))
+			continue;
+
+		if (job->n >= job->capacity) {
+			const Elf32_Word capacity
+				= job->capacity == 0 ? 4 : job->capacity * 2;
+			struct elfImageModule * const modules = noisyRealloc(
+				job->modules, capacity * sizeof(*modules));
+			if (modules == NULL) {
+				job->result = -1;
+				return;
+			}
+
+			job->modules = modules;
+			job->capacity = capacity;
+		}
+
+		job->modules[job->n] = module;
+		job->n++;
+	}
+}
+
+static void discoverJob(void *context, size_t ndx)
+{
+	discoverRange((struct discoverJob *)context + ndx);
+}
+
+/* Splits loadable segments into jobs. jobs may be NULL to count them. */
+static size_t makeJobs(const struct elfImage * restrict image,
+		       struct discoverJob * restrict jobs)
+{
+	const void * const buffer = image->buffer;
+	const Elf32_Ehdr * const ehdr = buffer;
+	const Elf32_Phdr * const phdrsTop
+		= (void *)((char *)buffer + ehdr->e_phoff);
+	const Elf32_Phdr * const phdrsBtm = phdrsTop + ehdr->e_phnum;
+	size_t n = 0;
+
+	for (const Elf32_Phdr *phdr = phdrsTop; phdr != phdrsBtm; phdr++) {
+		if (phdr->p_type != PT_LOAD
+		    || phdr->p_filesz < sizeof(SceModuleInfo))
+			continue;
+
+		const Elf32_Word last = phdr->p_filesz - sizeof(SceModuleInfo);
+		const Elf32_Word to = last - last % sizeof(uint32_t)
+				      + sizeof(uint32_t);
+
+		for (Elf32_Word from = 0; from < to; ) {
+			const Elf32_Word size = to - from < DISCOVER_SLICE ?
+						to - from : DISCOVER_SLICE;
+
+			if (jobs != NULL) {
+				jobs[n].image = image;
+				jobs[n].phdr = phdr;
+				jobs[n].from = from;
+				jobs[n].to = from + size;
+				jobs[n].modules = NULL;
+				jobs[n].n = 0;
+				jobs[n].capacity = 0;
+				jobs[n].result = 0;
+			}
+
+			n++;
+			from += size;
+		}
+	}
+
+	return n;
+}
+
+static int compareModules(const void *a, const void *b)
+{
+	const struct elfImageModule * const x = a;
+	const struct elfImageModule * const y = b;
+
+	return x->info.ptr < y->info.ptr ? -1 : x->info.ptr > y->info.ptr;
+}
+
+int elfDiscoverModules(const struct elfImage * restrict image,
+		       struct elfImageModule ** restrict modules,
+		       Elf32_Word * restrict n)
+{
+	int result = -1;
+
+	const size_t nJobs = makeJobs(image, NULL);
+	if (nJobs <= 0)
+		goto failNone;
+
+	struct discoverJob * const jobs = noisyMalloc(nJobs * sizeof(*jobs));
+	if (jobs == NULL)
+		return -1;
+
+	makeJobs(image, jobs);
+	poolRun(nJobs, 1, discoverJob, jobs);
+
+	Elf32_Word total = 0;
+	for (size_t ndx = 0; ndx < nJobs; ndx++) {
+		if (jobs[ndx].result != 0)
+			goto fail;
+
+		total += jobs[ndx].n;
+	}
+
+	if (total <= 0) {
+		free(jobs);
+		goto failNone;
+	}
+
+	*modules = noisyMalloc(total * sizeof(**modules));
+	if (*modules == NULL)
+		goto fail;
+
+	*n = 0;
+	for (size_t ndx = 0; ndx < nJobs; ndx++) {
+		/* Jobs which found none have no array. */
+		if (jobs[ndx].n <= 0)
+			continue;
+
+		memcpy(*modules + *n, jobs[ndx].modules,
+		       jobs[ndx].n * sizeof(**modules));
+		*n += jobs[ndx].n;
+	}
+
+	/* Jobs may finish in any order. */
+	qsort(*modules, *n, sizeof(**modules), compareModules);
+
+	for (Elf32_Word ndx = 0; ndx < *n; ndx++)
+		fprintf(stderr, "%s: found module %s at 0x%08X\n",
+			image->path, (*modules)[ndx].name,
+			(*modules)[ndx].info.vaddr);
+
+	result = 0;
+
+fail:
+	for (size_t ndx = 0; ndx < nJobs; ndx++)
+		free(jobs[ndx].modules);
+
+	free(jobs);
+	return result;
+
+failNone:
+	fprintf(stderr, "%s: no module found\n", image->path);
+	return -1;
+}
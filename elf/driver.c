@@ -15,25 +15,40 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define _POSIX_C_SOURCE 200809L
+#include <sys/stat.h>
 #include <assert.h>
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "../nid/overlay.h"
+#include "../nid/set.h"
+#include "../nid/table.h"
 #include "../noisy/fcntl.h"
 #include "../noisy/lib.h"
 #include "../overflow.h"
 #include "../readwhole.h"
+#include "../sparse.h"
+#include "section/debuglink.h"
 #include "section/load.h"
 #include "section/null.h"
+#include "section/rel.h"
 #include "section/strtab.h"
 #include "section/symtab.h"
+#include "section/unwind.h"
+#include "core.h"
+#include "discover.h"
 #include "elf.h"
 #include "driver.h"
 #include "image.h"
 #include "info.h"
+#include "sig.h"
 
 static SceKernelModuleInfo *readInfo(const char *path)
 {
@@ -60,6 +75,218 @@ static SceKernelModuleInfo *readInfo(const char *path)
 	return result;
 }
 
+static void freeInfos(const struct elfInfos * restrict list)
+{
+	if (list->core != NULL)
+		free(list->core);
+	else
+		for (Elf32_Word ndx = 0; ndx < list->n; ndx++)
+			free(list->infos[ndx]);
+
+	free(list->infos);
+}
+
+static int addInfo(struct elfInfos * restrict list, const char *path)
+{
+	if (list->n >= list->capacity) {
+		const Elf32_Word capacity
+			= list->capacity == 0 ? 8 : list->capacity * 2;
+		SceKernelModuleInfo ** const infos = noisyRealloc(
+			list->infos, capacity * sizeof(*infos));
+		if (infos == NULL)
+			return -1;
+
+		list->infos = infos;
+		list->capacity = capacity;
+	}
+
+	SceKernelModuleInfo * const info = readInfo(path);
+	if (info == NULL)
+		return -1;
+
+	list->infos[list->n] = info;
+	list->n++;
+	return 0;
+}
+
+static int compareNames(const void *a, const void *b)
+{
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/* Adds every file in the directory but hidden ones, in the order of the
+   name so that the output doesn't depend on the file system. */
+static int addInfoDir(struct elfInfos * restrict list, const char *path)
+{
+	char **names = NULL;
+	size_t n = 0;
+	size_t capacity = 0;
+	int result = -1;
+
+	DIR * const dir = opendir(path);
+	if (dir == NULL) {
+		perror(path);
+		return -1;
+	}
+
+	for (const struct dirent *entry; (entry = readdir(dir)) != NULL; ) {
+		if (entry->d_name[0] == '.')
+			continue;
+
+		if (n >= capacity) {
+			capacity = capacity == 0 ? 8 : capacity * 2;
+			char ** const grown = noisyRealloc(
+				names, capacity * sizeof(*names));
+			if (grown == NULL)
+				goto fail;
+
+			names = grown;
+		}
+
+		const size_t size = strlen(path) + strlen(entry->d_name) + 2;
+		names[n] = noisyMalloc(size);
+		if (names[n] == NULL)
+			goto fail;
+
+		snprintf(names[n], size, "%s/%s", path, entry->d_name);
+		n++;
+	}
+
+	qsort(names, n, sizeof(*names), compareNames);
+
+	for (size_t ndx = 0; ndx < n; ndx++)
+		if (addInfo(list, names[ndx]) != 0)
+			goto fail;
+
+	if (n == 0)
+		fprintf(stderr, "%s: no module information found\n", path);
+	else
+		result = 0;
+
+fail:
+	for (size_t ndx = 0; ndx < n; ndx++)
+		free(names[ndx]);
+
+	free(names);
+	closedir(dir);
+	return result;
+}
+
+static int readInfos(struct elfInfos * restrict list,
+		     const char * const * restrict paths, Elf32_Word n)
+{
+	list->infos = NULL;
+	list->n = 0;
+	list->capacity = 0;
+	list->core = NULL;
+
+	for (Elf32_Word ndx = 0; ndx < n; ndx++) {
+		struct stat st;
+		int result;
+
+		if (stat(paths[ndx], &st) != 0) {
+			perror(paths[ndx]);
+			goto fail;
+		}
+
+		result = S_ISDIR(st.st_mode) ?
+			addInfoDir(list, paths[ndx]) :
+			addInfo(list, paths[ndx]);
+		if (result != 0)
+			goto fail;
+	}
+
+	return 0;
+
+fail:
+	freeInfos(list);
+	list->infos = NULL;
+	list->n = 0;
+	list->capacity = 0;
+	return -1;
+}
+
+/* Takes the modules recorded in notes of the core dump. list->n is 0 if
+   there is none. */
+static int readCoreInfos(const struct elfImage * restrict image,
+			 struct elfInfos * restrict list)
+{
+	list->infos = NULL;
+	list->n = 0;
+	list->capacity = 0;
+
+	if (elfCoreReadModuleInfos(image, &list->core, &list->n) != 0)
+		return -1;
+
+	if (list->n <= 0)
+		return 0;
+
+	list->infos = noisyMalloc(list->n * sizeof(*list->infos));
+	if (list->infos == NULL) {
+		free(list->core);
+		return -1;
+	}
+
+	for (Elf32_Word ndx = 0; ndx < list->n; ndx++)
+		list->infos[ndx] = list->core + ndx;
+
+	list->capacity = list->n;
+	return 0;
+}
+
+int elfFindModules(struct elf * restrict context,
+		   const char * const * restrict infoPaths, Elf32_Word nInfos)
+{
+	const struct elfImage * const image = &context->source;
+	struct elfInfos * const infos = &context->infos;
+
+	if (nInfos > 0) {
+		if (readInfos(infos, infoPaths, nInfos) != 0)
+			return -1;
+	} else {
+		if (readCoreInfos(image, infos) != 0)
+			return -1;
+
+		if (infos->n <= 0)
+			return elfDiscoverModules(image, &context->modules,
+						  &context->nModules);
+	}
+
+	struct elfImageModule * const modules
+		= noisyMalloc(infos->n * sizeof(*modules));
+	if (modules == NULL)
+		goto fail;
+
+	if (elfImageFindInfos(image,
+			      (const SceKernelModuleInfo * const *)infos->infos,
+			      infos->n, modules) != 0) {
+		free(modules);
+		goto fail;
+	}
+
+	context->modules = modules;
+	context->nModules = infos->n;
+	return 0;
+
+fail:
+	freeInfos(infos);
+	infos->infos = NULL;
+	infos->n = 0;
+	infos->core = NULL;
+	return -1;
+}
+
+static void initModules(struct elf * restrict context)
+{
+	context->infos.infos = NULL;
+	context->infos.n = 0;
+	context->infos.capacity = 0;
+	context->infos.core = NULL;
+	context->modules = NULL;
+	context->nModules = 0;
+	nidSetInit(&context->unresolved);
+}
+
 int elfInit(struct elf * restrict context, const char * restrict path)
 {
 	int result;
@@ -71,24 +298,61 @@ int elfInit(struct elf * restrict context, const char * restrict path)
 			free(context->source.buffer);
 
 		context->shnum = 0;
+		context->sections = NULL;
+		initModules(context);
 	}
 
 	return result;
 }
 
+int elfInitBuffer(struct elf * restrict context, void * restrict buffer,
+		  size_t size, const char * restrict path)
+{
+	context->source.buffer = buffer;
+	context->source.path = path;
+	context->source.size = size;
+	context->shnum = 0;
+	context->sections = NULL;
+	initModules(context);
+
+	return elfImageValidate(&context->source);
+}
 
-int elfMakeSections(struct elf * restrict context,
-		    const char * restrict infoPath)
+enum shnames {
+	ELF_SH_NULL,
+	ELF_SH_LOAD,
+	ELF_SH_EXIDX,
+	ELF_SH_EXTAB,
+	ELF_SH_SHSTRTAB,
+	ELF_SH_SYMTAB,
+	ELF_SH_STRTAB,
+	ELF_SH_REL,
+	ELF_SH_NUM
+};
+
+/* The sections made by elfMakeSections are in this order: null, loads,
+   unwind tables, .shstrtab, .symtab, .strtab and .rel.dyn. */
+int elfCountSections(struct elf *context)
 {
-	enum shnames {
-		ELF_SH_NULL,
-		ELF_SH_LOAD,
-		ELF_SH_SHSTRTAB,
-		ELF_SH_SYMTAB,
-		ELF_SH_STRTAB,
-		ELF_SH_NUM
-	};
+	const Elf32_Word loads = elfSectionLoadCount(&context->source);
+	const Elf32_Word unwinds = elfSectionUnwindCount(
+		&context->source, context->modules, context->nModules);
+	Elf32_Word dumped;
+
+	/* The null section and the sections after the unwind tables. */
+	if (waddOverflow(loads, unwinds, &dumped)
+	    || waddOverflow(dumped, 1 + ELF_SH_NUM - ELF_SH_SHSTRTAB,
+			    &context->shnum)) {
+		fputs("too many sections\n", stderr);
+		return -1;
+	}
 
+	context->shstrndx = ELF_LOADNDX + dumped;
+	return 0;
+}
+
+static int makeSections(struct elf * restrict context)
+{
 #define NAME(string) { string, sizeof(string) }
 	static struct {
 		const char *string;
@@ -96,20 +360,82 @@ int elfMakeSections(struct elf * restrict context,
 	} names[ELF_SH_NUM] = {
 		[ELF_SH_NULL] = NAME(""),
 		[ELF_SH_LOAD] = NAME("load"),
+		[ELF_SH_EXIDX] = NAME(".ARM.exidx"),
+		[ELF_SH_EXTAB] = NAME(".ARM.extab"),
 		[ELF_SH_SHSTRTAB] = NAME(".shstrtab"),
 		[ELF_SH_SYMTAB] = NAME(".symtab"),
-		[ELF_SH_STRTAB] = NAME(".strtab")
+		[ELF_SH_STRTAB] = NAME(".strtab"),
+		[ELF_SH_REL] = NAME(".rel.dyn")
 	};
 	struct elfSectionStrtab shstrtab;
 	struct elfSectionStrtab strtab;
+	struct nidOverlay overlay;
+	struct nidOverlay ported;
+	struct nidTable table;
+	struct elfSigs sigs;
 	Elf32_Word shstrtabNames[ELF_SH_NUM];
-	Elf32_Word num;
 	int result;
 
-	const Elf32_Word loads = elfSectionLoadCount(&context->source);
+	if (elfCountSections(context) != 0)
+		return -1;
 
-	if (waddOverflow(loads, 4, &num))
-		goto failTooMany;
+	char * const overlayPath = nidOverlayPath();
+	if (overlayPath == NULL)
+		return -1;
+
+	result = nidOverlayLoad(&overlay, overlayPath);
+	free(overlayPath);
+	if (result != 0)
+		return -1;
+
+	char * const tablePath = nidTablePath();
+	if (tablePath == NULL) {
+		nidOverlayDeinit(&overlay);
+		return -1;
+	}
+
+	result = nidTableOpen(&table, tablePath);
+	free(tablePath);
+	if (result != 0) {
+		nidOverlayDeinit(&overlay);
+		return -1;
+	}
+
+	char * const sigsPath = elfSigPath();
+	if (sigsPath == NULL) {
+		nidTableClose(&table);
+		nidOverlayDeinit(&overlay);
+		return -1;
+	}
+
+	result = elfSigOpen(&sigs, sigsPath);
+	free(sigsPath);
+	if (result != 0) {
+		nidTableClose(&table);
+		nidOverlayDeinit(&overlay);
+		return -1;
+	}
+
+	/* Ported names are of one dump, so there is no default file. */
+	if (nidOverlayLoad(&ported, getenv("VITA_ANALYZE_NAMES")) != 0) {
+		elfSigClose(&sigs);
+		nidTableClose(&table);
+		nidOverlayDeinit(&overlay);
+		return -1;
+	}
+
+	struct elfSectionSymtabNids nids = {
+		.overlay = &overlay,
+		.table = &table,
+		.unresolved = &context->unresolved,
+		.sigs = &sigs,
+		.names = &ported
+	};
+
+	const Elf32_Word loads = elfSectionLoadCount(&context->source);
+	const Elf32_Word unwinds = elfSectionUnwindCount(
+		&context->source, context->modules, context->nModules);
+	const Elf32_Word num = context->shnum;
 
 	Elf32_Word shsize;
 	if (wmulOverflow(num, sizeof(*context->shdrs), &shsize))
@@ -148,6 +474,13 @@ int elfMakeSections(struct elf * restrict context,
 			   shdrs + ndx, sections + ndx);
 
 	ndx += loads;
+	elfSectionUnwindMake(&context->source,
+			     context->modules, context->nModules,
+			     shstrtabNames[ELF_SH_EXIDX],
+			     shstrtabNames[ELF_SH_EXTAB],
+			     shdrs + ndx, sections + ndx);
+
+	ndx += unwinds;
 	elfSectionStrtabFinalize(&shstrtab, shstrtabNames[ELF_SH_SHSTRTAB],
 				 context->source.size + shsize,
 				 shdrs + ndx, sections + ndx);
@@ -155,20 +488,20 @@ int elfMakeSections(struct elf * restrict context,
 
 	elfSectionStrtabInit(&strtab);
 
-	SceKernelModuleInfo * const info = readInfo(infoPath);
-	if (info == NULL)
-		return -1;
-
 	ndx++;
-	result = elfSectionSymtabMake(&context->source, info, &strtab, ndx + 1,
+	result = elfSectionSymtabMake(&context->source,
+				      context->modules, context->nModules,
+				      &nids, &strtab, ndx + 1,
 				      shstrtabNames[ELF_SH_SYMTAB],
 				      shdrs[ndx - 1].sh_offset
 				      + shdrs[ndx - 1].sh_size,
 				      shdrs + ndx, sections + ndx);
 	if (result != 0)
-		goto failSymtab;
+		goto failShstrtab;
 
-	free(info);
+	result = nidSetFinalize(&context->unresolved);
+	if (result != 0)
+		goto failUnresolved;
 
 	ndx++;
 	elfSectionStrtabFinalize(&strtab,
@@ -177,103 +510,388 @@ int elfMakeSections(struct elf * restrict context,
 				 + shdrs[ndx - 1].sh_size,
 				 shdrs + ndx, sections + ndx);
 
+	ndx++;
+	result = elfSectionRelMake(&context->source,
+				   shstrtabNames[ELF_SH_REL], ndx - 2,
+				   shdrs[ndx - 1].sh_offset
+				   + shdrs[ndx - 1].sh_size,
+				   shdrs + ndx, sections + ndx);
+	if (result != 0)
+		goto failRel;
+
 	context->shdrs = shdrs;
 	context->sections = sections;
 	context->shnum = ndx + 1;
+	nidOverlayDeinit(&ported);
+	elfSigClose(&sigs);
+	nidTableClose(&table);
+	nidOverlayDeinit(&overlay);
 
 	return result;
 
 failTooMany:
-	fputs("too many sections", stderr);
-	return -1;
+	fputs("too many sections\n", stderr);
+	result = -1;
+	goto failOverlay;
 
 failSections:
 	free(shdrs);
 failShdrs:
-	return -1;
+	result = -1;
+	goto failOverlay;
 
-failSymtab:
-	free(info);
+failRel:
+	free(sections[ndx - 1]);
+	free(sections[ndx - 2]);
+	goto failShstrtab;
+
+failUnresolved:
+	free(sections[ndx]);
+	free(strtab.buffer);
 failShstrtab:
 	free(sections);
 	free(shdrs);
+failOverlay:
+	nidOverlayDeinit(&ported);
+	elfSigClose(&sigs);
+	nidTableClose(&table);
+	nidOverlayDeinit(&overlay);
 	return result;
 }
 
-int elfWrite(struct elf *context)
+int elfMakeSections(struct elf * restrict context,
+		    const char * const * restrict infoPaths,
+		    Elf32_Word nInfos)
 {
-	Elf32_Ehdr ehdr;
+	if (elfFindModules(context, infoPaths, nInfos) != 0)
+		return -1;
 
-	memcpy(&ehdr, context->source.buffer, sizeof(ehdr));
+	return makeSections(context);
+}
+
+void elfLayoutHead(const struct elf * restrict context,
+		   Elf32_Ehdr * restrict ehdr,
+		   struct elfChunk * restrict chunks)
+{
+	memcpy(ehdr, context->source.buffer, sizeof(*ehdr));
 
 	/* BFD doesn't accept sections if e_type is ET_CORE.
 	   According to "SYSTEM V APPLICATION BINARY INTERFACE" edition 4.1,
 	   the type should be executable or shared if symbol values have virtual
 	   address. */
-	ehdr.e_type = ET_EXEC;
+	ehdr->e_type = ET_EXEC;
 
-	ehdr.e_shoff = context->source.size;
-	ehdr.e_shentsize = sizeof(Elf32_Shdr);
-	ehdr.e_shnum = context->shnum;
-	ehdr.e_shstrndx = context->shstrndx;
+	ehdr->e_shoff = context->source.size;
+	ehdr->e_shentsize = sizeof(Elf32_Shdr);
+	ehdr->e_shnum = context->shnum;
+	ehdr->e_shstrndx = context->shstrndx;
+
+	chunks[0].buffer = ehdr;
+	chunks[0].offset = 0;
+	chunks[0].size = sizeof(*ehdr);
+
+	chunks[1].buffer = (char *)context->source.buffer + sizeof(*ehdr);
+	chunks[1].offset = sizeof(*ehdr);
+	chunks[1].size = context->source.size - sizeof(*ehdr);
+}
+
+static Elf32_Word layoutTable(const Elf32_Shdr * restrict shdrs,
+			      void * const * restrict sections,
+			      Elf32_Word shnum, Elf32_Off offset,
+			      struct elfChunk * restrict chunks)
+{
+	static const char padding[16];
+	Elf32_Word n = 0;
+
+	chunks[n].buffer = shdrs;
+	chunks[n].offset = offset;
+	chunks[n].size = shnum * sizeof(*shdrs);
+	offset += chunks[n].size;
+	n++;
 
+	for (Elf32_Word ndx = 0; ndx < shnum; ndx++) {
+		if (sections[ndx] == NULL)
+			continue;
+
+		if (offset < shdrs[ndx].sh_offset) {
+			chunks[n].buffer = padding;
+			chunks[n].offset = offset;
+			chunks[n].size = shdrs[ndx].sh_offset - offset;
+			assert(chunks[n].size <= sizeof(padding));
+			n++;
+		}
+
+		chunks[n].buffer = sections[ndx];
+		chunks[n].offset = shdrs[ndx].sh_offset;
+		chunks[n].size = shdrs[ndx].sh_size;
+		offset = chunks[n].offset + chunks[n].size;
+		n++;
+	}
+
+	return n;
+}
+
+Elf32_Word elfLayoutTail(const struct elf * restrict context,
+			 struct elfChunk * restrict chunks)
+{
+	return layoutTable(context->shdrs, context->sections, context->shnum,
+			   context->source.size, chunks);
+}
+
+Elf32_Word elfLayout(const struct elf * restrict context,
+		     Elf32_Ehdr * restrict ehdr,
+		     struct elfChunk * restrict chunks)
+{
+	elfLayoutHead(context, ehdr, chunks);
+	return ELF_CHUNK_HEAD
+	       + elfLayoutTail(context, chunks + ELF_CHUNK_HEAD);
+}
+
+static struct noisyFile *openStdout(void)
+{
 	struct noisyFile * const noisyStdout = noisyGetStdout();
 	if (noisyStdout == NULL)
-		goto failInit;
+		return NULL;
 
 	if (noisyIsatty(noisyStdout)) {
 		fputs("stdout is tty. refusing to output ELF.\n", stderr);
-		goto fail;
+		noisyClose(noisyStdout);
+		return NULL;
 	}
 
-	if (noisyWrite(noisyStdout, &ehdr, sizeof(ehdr)) != sizeof(ehdr))
-		goto fail;
+	return noisyStdout;
+}
 
-	const ssize_t left = context->source.size - sizeof(ehdr);
-	if (noisyWrite(noisyStdout,
-		       (char *)context->source.buffer + sizeof(ehdr), left)
-	    != left)
-		goto fail;
+/* Zero blocks are left as holes if the output is a regular file. */
+static int writeChunks(const struct noisyFile * restrict file,
+		       const struct elfChunk * restrict chunks, Elf32_Word n,
+		       size_t * restrict holes)
+{
+	const bool holeSafe = noisyIsHoleSafe(file);
 
-	const Elf32_Word shsize = context->shnum * sizeof(*context->shdrs);
-	if (noisyWrite(noisyStdout, context->shdrs, shsize) != shsize)
-		goto fail;
+	for (Elf32_Word ndx = 0; ndx < n; ndx++)
+		if (sparseWrite(file, chunks[ndx].buffer, chunks[ndx].size,
+				chunks[ndx].offset, holeSafe, holes)
+		    != chunks[ndx].size)
+			return -1;
+
+	return 0;
+}
+
+static void reportHoles(size_t holes)
+{
+	if (holes > 0)
+		fprintf(stderr, "stdout: %zu zero bytes are left as holes\n",
+			holes);
+}
+
+int elfWrite(struct elf *context)
+{
+	Elf32_Ehdr ehdr;
+	struct elfChunk chunks[ELF_CHUNK_MAX(context->shnum)];
+
+	const Elf32_Word n = elfLayout(context, &ehdr, chunks);
 
-	Elf32_Off offset = context->source.size + shsize;
-	for (Elf32_Word ndx = 0; ndx < context->shnum; ndx++) {
-		if (context->sections[ndx] == NULL)
+	struct noisyFile * const noisyStdout = openStdout();
+	if (noisyStdout == NULL)
+		return -1;
+
+	size_t holes = 0;
+	const int result = writeChunks(noisyStdout, chunks, n, &holes);
+	noisyClose(noisyStdout);
+
+	if (result == 0)
+		reportHoles(holes);
+
+	return result;
+}
+
+int elfWriteSplit(const struct elf * restrict context)
+{
+	static const char debuglinkName[] = ".gnu_debuglink";
+	const Elf32_Ehdr * const sourceEhdr = context->source.buffer;
+	const Elf32_Shdr * const shstrtabShdr
+		= context->shdrs + context->shstrndx;
+	const Elf32_Word shnum = context->shnum + 1;
+	const Elf32_Word debuglinkNdx = shnum - 1;
+	const Elf32_Word phsize = sourceEhdr->e_phnum * sizeof(Elf32_Phdr);
+	Elf32_Ehdr ehdr;
+	int result = -1;
+
+	Elf32_Shdr * const shdrs = noisyMalloc(shnum * sizeof(*shdrs));
+	if (shdrs == NULL)
+		goto failShdrs;
+
+	void ** const sections = noisyMalloc(shnum * sizeof(*sections));
+	if (sections == NULL)
+		goto failSections;
+
+	Elf32_Phdr * const phdrs = noisyMalloc(phsize);
+	if (phdrs == NULL)
+		goto failPhdrs;
+
+	struct elfChunk * const chunks
+		= noisyMalloc(ELF_CHUNK_MAX(shnum) * sizeof(*chunks));
+	if (chunks == NULL)
+		goto failChunks;
+
+	char * const shstrtab
+		= noisyMalloc(shstrtabShdr->sh_size + sizeof(debuglinkName));
+	if (shstrtab == NULL)
+		goto failShstrtab;
+
+	memcpy(shstrtab, context->sections[context->shstrndx],
+	       shstrtabShdr->sh_size);
+	memcpy(shstrtab + shstrtabShdr->sh_size,
+	       debuglinkName, sizeof(debuglinkName));
+
+	memcpy(shdrs, context->shdrs, context->shnum * sizeof(*shdrs));
+	memcpy(sections, context->sections,
+	       context->shnum * sizeof(*sections));
+
+	shdrs[context->shstrndx].sh_size += sizeof(debuglinkName);
+	sections[context->shstrndx] = shstrtab;
+
+	/* The contents stay in the original dump. */
+	for (Elf32_Word ndx = ELF_LOADNDX; ndx < context->shstrndx; ndx++)
+		shdrs[ndx].sh_type = SHT_NOBITS;
+
+	if (elfSectionDebuglinkMake(&context->source, shstrtabShdr->sh_size,
+				    0, shdrs + debuglinkNdx,
+				    sections + debuglinkNdx) != 0)
+		goto failDebuglink;
+
+	memcpy(phdrs, (char *)context->source.buffer + sourceEhdr->e_phoff,
+	       phsize);
+	for (Elf32_Word ndx = 0; ndx < sourceEhdr->e_phnum; ndx++)
+		phdrs[ndx].p_filesz = 0;
+
+	memcpy(&ehdr, sourceEhdr, sizeof(ehdr));
+	ehdr.e_type = ET_EXEC;
+	ehdr.e_phoff = sizeof(ehdr);
+	ehdr.e_shoff = sizeof(ehdr) + phsize;
+	ehdr.e_shentsize = sizeof(Elf32_Shdr);
+	ehdr.e_shnum = shnum;
+	ehdr.e_shstrndx = context->shstrndx;
+
+	/* Sections are packed right after the section header table here. */
+	Elf32_Off offset = ehdr.e_shoff + shnum * sizeof(*shdrs);
+	for (Elf32_Word ndx = 0; ndx < shnum; ndx++) {
+		if (sections[ndx] == NULL)
 			continue;
 
-		while (offset < context->shdrs[ndx].sh_offset) {
-			static const char padding = 0;
-			if (noisyWrite(noisyStdout, &padding, sizeof(padding))
-			    != sizeof(padding))
-				goto fail;
+		const Elf32_Off mod = offset % shdrs[ndx].sh_addralign;
+		if (mod)
+			offset += shdrs[ndx].sh_addralign - mod;
 
-			offset += sizeof(padding);
-		}
+		shdrs[ndx].sh_offset = offset;
+		offset += shdrs[ndx].sh_size;
+	}
 
-		if (noisyWrite(noisyStdout, context->sections[ndx],
-			       context->shdrs[ndx].sh_size)
-		    != context->shdrs[ndx].sh_size)
-			goto fail;
+	chunks[0].buffer = &ehdr;
+	chunks[0].offset = 0;
+	chunks[0].size = sizeof(ehdr);
+
+	chunks[1].buffer = phdrs;
+	chunks[1].offset = ehdr.e_phoff;
+	chunks[1].size = phsize;
+
+	const Elf32_Word n = ELF_CHUNK_HEAD
+			     + layoutTable(shdrs, sections, shnum, ehdr.e_shoff,
+					   chunks + ELF_CHUNK_HEAD);
 
-		offset += context->shdrs[ndx].sh_size;
+	struct noisyFile * const noisyStdout = openStdout();
+	if (noisyStdout != NULL) {
+		size_t holes = 0;
+
+		result = writeChunks(noisyStdout, chunks, n, &holes);
+		noisyClose(noisyStdout);
+	}
+
+	free(sections[debuglinkNdx]);
+failDebuglink:
+	free(shstrtab);
+failShstrtab:
+	free(chunks);
+failChunks:
+	free(phdrs);
+failPhdrs:
+	free(sections);
+failSections:
+	free(shdrs);
+failShdrs:
+	return result;
+}
+
+struct pipelineJob {
+	struct elf *context;
+	int result;
+};
+
+static void *pipelineMake(void *p)
+{
+	struct pipelineJob * const job = p;
+
+	job->result = makeSections(job->context);
+	return NULL;
+}
+
+int elfWritePipelined(struct elf * restrict context,
+		      const char * const * restrict infoPaths,
+		      Elf32_Word nInfos)
+{
+	struct pipelineJob job = { context, 0 };
+	struct elfChunk head[ELF_CHUNK_HEAD];
+	Elf32_Ehdr ehdr;
+	pthread_t thread;
+	int result;
+
+	/* The header only depends on the number of sections, which is known
+	   once modules are located and before any symbol is resolved. */
+	if (elfFindModules(context, infoPaths, nInfos) != 0
+	    || elfCountSections(context) != 0)
+		return -1;
+
+	elfLayoutHead(context, &ehdr, head);
+
+	struct noisyFile * const noisyStdout = openStdout();
+	if (noisyStdout == NULL)
+		return -1;
+
+	const int error = pthread_create(&thread, NULL, pipelineMake, &job);
+	if (error != 0) {
+		errno = error;
+		perror("pthread_create");
+		pipelineMake(&job);
+	}
+
+	size_t holes = 0;
+	result = writeChunks(noisyStdout, head, ELF_CHUNK_HEAD, &holes);
+
+	if (error == 0)
+		pthread_join(thread, NULL);
+
+	if (result == 0 && job.result == 0) {
+		struct elfChunk tail[ELF_CHUNK_MAX(context->shnum)
+				     - ELF_CHUNK_HEAD];
+		const Elf32_Word n = elfLayoutTail(context, tail);
+
+		result = writeChunks(noisyStdout, tail, n, &holes);
+	} else {
+		result = -1;
 	}
 
 	noisyClose(noisyStdout);
-	return 0;
 
-fail:
-	if (noisyStdout != NULL)
-		noisyClose(noisyStdout);
-failInit:
-	return -1;
+	if (result == 0)
+		reportHoles(holes);
+
+	return result;
 }
 
-void elfDeinit(const struct elf * restrict context)
+void elfDeinitSections(const struct elf * restrict context)
 {
-	if (context->shnum > 0) {
+	if (context->sections != NULL) {
 		for (Elf32_Word ndx = 0; ndx < context->shnum; ndx++)
 			free(context->sections[ndx]);
 
@@ -281,5 +899,13 @@ void elfDeinit(const struct elf * restrict context)
 		free(context->sections);
 	}
 
+	free(context->modules);
+	nidSetDeinit(&context->unresolved);
+	freeInfos(&context->infos);
+}
+
+void elfDeinit(const struct elf * restrict context)
+{
+	elfDeinitSections(context);
 	free(context->source.buffer);
 }
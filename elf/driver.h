@@ -18,7 +18,9 @@
 #ifndef ELF_DRIVER_H
 #define ELF_DRIVER_H
 
+#include <stddef.h>
 #include <stdint.h>
+#include "../nid/set.h"
 #include "image.h"
 #include "elf.h"
 
@@ -56,21 +58,95 @@ struct elfImp {
 	Elf32_Addr tlsEntries;
 };
 
+/* SceKernelModuleInfo given by files or the core dump. */
+struct elfInfos {
+	SceKernelModuleInfo **infos;
+	Elf32_Word n;
+	Elf32_Word capacity;
+
+	/* The storage of all infos if they are read from the core dump. */
+	SceKernelModuleInfo *core;
+};
+
 struct elf {
 	Elf32_Shdr *shdrs;
 	void **sections;
 	struct elfImage source;
+	struct elfInfos infos;
+	struct elfImageModule *modules;
+	Elf32_Word nModules;
+
+	/* NIDs which neither the database nor the overlay names. */
+	struct nidSet unresolved;
+
 	Elf32_Word shnum;
 	Elf32_Word shstrndx;
 };
 
+/* A piece of the output file. */
+struct elfChunk {
+	const void *buffer;
+	Elf32_Off offset;
+	Elf32_Word size;
+};
+
+/* The number of chunks elfLayoutHead produces: Ehdr and the rest of the
+   dump. */
+#define ELF_CHUNK_HEAD 2
+
+/* The maximum number of chunks elfLayout can produce. */
+#define ELF_CHUNK_MAX(shnum) (ELF_CHUNK_HEAD + 1 + 2 * (shnum))
+
 int elfInit(struct elf * restrict context, const char * restrict path);
 
+/* Takes a dump already in memory. The buffer is not freed on failure. */
+int elfInitBuffer(struct elf * restrict context, void * restrict buffer,
+		  size_t size, const char * restrict path);
+
+/* Each of infoPaths is INFO.BIN of a module or a directory of them. If
+   there is none, modules in the notes of the core dump are taken, or
+   modules are discovered in the dump. */
+int elfFindModules(struct elf * restrict context,
+		   const char * const * restrict infoPaths, Elf32_Word nInfos);
+
+/* Sets shnum and shstrndx to what elfMakeSections will make. Modules must
+   be found. */
+int elfCountSections(struct elf *context);
+
+/* Finds modules with elfFindModules and makes sections. */
 int elfMakeSections(struct elf * restrict context,
-		    const char * restrict infoPath);
+		    const char * const * restrict infoPaths,
+		    Elf32_Word nInfos);
+
+/* Fills chunks in the order of offset, without gaps, and returns the
+   number. They refer to ehdr and context so keep them alive. */
+Elf32_Word elfLayout(const struct elf * restrict context,
+		     Elf32_Ehdr * restrict ehdr,
+		     struct elfChunk * restrict chunks);
+
+/* The part of elfLayout which only needs elfCountSections. */
+void elfLayoutHead(const struct elf * restrict context,
+		   Elf32_Ehdr * restrict ehdr,
+		   struct elfChunk * restrict chunks);
+
+/* The rest of elfLayout, which needs elfMakeSections. */
+Elf32_Word elfLayoutTail(const struct elf * restrict context,
+			 struct elfChunk * restrict chunks);
 
 int elfWrite(struct elf *context);
 
+/* Writes only the headers and the new sections, and links the dump with
+   .gnu_debuglink. */
+int elfWriteSplit(const struct elf * restrict context);
+
+/* Makes sections on another thread while the dump is written to stdout. */
+int elfWritePipelined(struct elf * restrict context,
+		      const char * const * restrict infoPaths,
+		      Elf32_Word nInfos);
+
+/* Frees everything elfMakeSections allocated, but not the dump. */
+void elfDeinitSections(const struct elf * restrict context);
+
 void elfDeinit(const struct elf * restrict context);
 
 #endif
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../noisy/lib.h"
+#include "../overflow.h"
+#include "elf.h"
+#include "exidx.h"
+#include "image.h"
+#include "info.h"
+
+int elfExidxInit(struct elfExidx * restrict exidx,
+		 const struct elfImage * restrict image,
+		 Elf32_Addr top, Elf32_Addr btm)
+{
+	const Elf32_Word entrySize = 2 * sizeof(Elf32_Word);
+	Elf32_Word size;
+
+	exidx->entries = NULL;
+	exidx->vaddr = top;
+	exidx->n = 0;
+	exidx->starts = NULL;
+
+	if (wsubOverflow(btm, top, &size) || size % entrySize != 0)
+		goto failRange;
+
+	if (size <= 0)
+		return 0;
+
+	exidx->entries = elfImageVaddrToPtr(image, top, size, NULL);
+	if (exidx->entries == NULL)
+		goto failRange;
+
+	exidx->n = size / entrySize;
+	exidx->starts = noisyMalloc(exidx->n * sizeof(*exidx->starts));
+	if (exidx->starts == NULL)
+		return -1;
+
+	/* Independent iterations so that compilers vectorize them. */
+	for (Elf32_Word ndx = 0; ndx < exidx->n; ndx++)
+		exidx->starts[ndx] = elfExidxPrel31(top + ndx * entrySize,
+						    exidx->entries[ndx * 2]);
+
+	unsigned int unsorted = 0;
+	for (Elf32_Word ndx = 1; ndx < exidx->n; ndx++)
+		unsorted |= exidx->starts[ndx] < exidx->starts[ndx - 1];
+
+	if (unsorted) {
+		fprintf(stderr, "%s: exidx at 0x%08X is not sorted\n",
+			image->path, top);
+		free(exidx->starts);
+		exidx->starts = NULL;
+		exidx->n = 0;
+		return -1;
+	}
+
+	return 0;
+
+failRange:
+	fprintf(stderr, "%s: exidx 0x%08X-0x%08X is out of range\n",
+		image->path, top, btm);
+	exidx->n = 0;
+	return -1;
+}
+
+int elfExidxInitModule(struct elfExidx * restrict exidx,
+		       const struct elfImage * restrict image,
+		       const struct elfImageModule * restrict module)
+{
+	const SceModuleInfo * const info = module->info.ptr;
+
+	return elfExidxInit(exidx, image, module->base + info->exidxTop,
+			    module->base + info->exidxBtm);
+}
+
+Elf32_Word elfExidxLookup(const struct elfExidx * restrict exidx,
+			  Elf32_Addr vaddr)
+{
+	Elf32_Word lo = 0;
+	Elf32_Word hi = exidx->n;
+
+	/* The number of entries starting at or before vaddr. */
+	while (lo < hi) {
+		const Elf32_Word mid = lo + (hi - lo) / 2;
+
+		if (exidx->starts[mid] <= vaddr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo > 0 ? lo - 1 : exidx->n;
+}
+
+void elfExidxDeinit(const struct elfExidx * restrict exidx)
+{
+	free(exidx->starts);
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ELF_EXIDX_H
+#define ELF_EXIDX_H
+
+#include <stdbool.h>
+#include "elf.h"
+#include "image.h"
+
+/* The word of an entry telling the function cannot be unwound. */
+#define ELF_EXIDX_CANTUNWIND 1
+
+/* A decoded .ARM.exidx. */
+struct elfExidx {
+	/* Pairs of words, pointing into the image. */
+	const Elf32_Word *entries;
+	Elf32_Addr vaddr;
+	Elf32_Word n;
+
+	/* The start address of the function of each entry, in ascending
+	   order. */
+	Elf32_Addr *starts;
+};
+
+/* Decodes the table in [top, btm). It fails if the table is not in the
+   image or not sorted. */
+int elfExidxInit(struct elfExidx * restrict exidx,
+		 const struct elfImage * restrict image,
+		 Elf32_Addr top, Elf32_Addr btm);
+
+/* Decodes the table of the module. exidx->n is 0 if it has none. */
+int elfExidxInitModule(struct elfExidx * restrict exidx,
+		       const struct elfImage * restrict image,
+		       const struct elfImageModule * restrict module);
+
+/* Returns the index of the entry covering vaddr, or exidx->n if vaddr is
+   before the first function. */
+Elf32_Word elfExidxLookup(const struct elfExidx * restrict exidx,
+			  Elf32_Addr vaddr);
+
+/* Returns the address of the second word of the entry, which is either
+   ELF_EXIDX_CANTUNWIND, an inline table with the top bit set, or the prel31
+   address of the extab entry. */
+static inline Elf32_Addr elfExidxDataVaddr(
+	const struct elfExidx * restrict exidx, Elf32_Word ndx)
+{
+	return exidx->vaddr + ndx * 2 * sizeof(Elf32_Word)
+	       + sizeof(Elf32_Word);
+}
+
+/* Decodes a prel31 word at vaddr. */
+static inline Elf32_Addr elfExidxPrel31(Elf32_Addr vaddr, Elf32_Word word)
+{
+	/* Sign-extend bit 30. */
+	return vaddr + (((word & 0x7FFFFFFF) ^ 0x40000000) - 0x40000000);
+}
+
+void elfExidxDeinit(const struct elfExidx * restrict exidx);
+
+#endif
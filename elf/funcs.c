@@ -0,0 +1,485 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../noisy/lib.h"
+#include "../pool.h"
+#include "branch.h"
+#include "elf.h"
+#include "funcs.h"
+#include "image.h"
+
+/* Longer runs are not taken as a function. */
+#define FUNCS_SIZE_MAX (1 << 20)
+
+/* An executable segment and the first bit of its halfwords in visited. */
+struct funcsSegment {
+	const unsigned char *bytes;
+	Elf32_Addr vaddr;
+	Elf32_Word size;
+	size_t bit;
+};
+
+struct funcsPool {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+
+	const struct funcsSegment *segments;
+	Elf32_Half nSegments;
+
+	/* A bit for each halfword which is known to begin a function. */
+	_Atomic uint32_t *visited;
+
+	/* A copy of visited which does not change while traversing, so that
+	   where functions end doesn't depend on the order they are
+	   traversed. It has the seeds while calls are followed, and every
+	   function while sizes are measured. */
+	uint32_t *known;
+
+	/* Whether sizes are measured rather than calls followed. */
+	bool sizing;
+
+	/* Functions not traversed yet. */
+	Elf32_Addr *stack;
+	size_t n;
+	size_t capacity;
+
+	/* The number of workers traversing a function. */
+	unsigned int busy;
+
+	int result;
+};
+
+struct funcsWorker {
+	struct funcsPool *pool;
+	struct elfFunc *funcs;
+	size_t n;
+	size_t capacity;
+};
+
+static const struct funcsSegment *findSegment(
+	const struct funcsPool * restrict pool, Elf32_Addr vaddr)
+{
+	for (Elf32_Half ndx = 0; ndx < pool->nSegments; ndx++)
+		if (vaddr - pool->segments[ndx].vaddr
+		    < pool->segments[ndx].size)
+			return pool->segments + ndx;
+
+	return NULL;
+}
+
+static size_t bitOf(const struct funcsSegment * restrict segment,
+		    Elf32_Addr vaddr)
+{
+	return segment->bit + (vaddr - segment->vaddr) / sizeof(uint16_t);
+}
+
+static bool isKnown(const struct funcsPool * restrict pool, size_t bit)
+{
+	return (pool->known[bit / 32] >> (bit % 32) & 1) != 0;
+}
+
+/* Marks vaddr as a function start. Returns true if no one did before. */
+static bool claim(struct funcsPool * restrict pool,
+		  const struct funcsSegment * restrict segment,
+		  Elf32_Addr vaddr)
+{
+	const size_t bit = bitOf(segment, vaddr);
+	const uint32_t mask = (uint32_t)1 << (bit % 32);
+
+	return (atomic_fetch_or_explicit(pool->visited + bit / 32, mask,
+					 memory_order_relaxed) & mask) == 0;
+}
+
+/* Needs the lock. */
+static int push(struct funcsPool * restrict pool, Elf32_Addr vaddr)
+{
+	if (pool->n >= pool->capacity) {
+		const size_t capacity = pool->capacity <= 0 ?
+			256 : pool->capacity * 2;
+		Elf32_Addr * const stack = noisyRealloc(
+			pool->stack, capacity * sizeof(*stack));
+		if (stack == NULL)
+			return -1;
+
+		pool->stack = stack;
+		pool->capacity = capacity;
+	}
+
+	pool->stack[pool->n] = vaddr;
+	pool->n++;
+	return 0;
+}
+
+static int record(struct funcsWorker * restrict worker, Elf32_Addr vaddr,
+		  Elf32_Word size)
+{
+	if (worker->n >= worker->capacity) {
+		const size_t capacity = worker->capacity <= 0 ?
+			256 : worker->capacity * 2;
+		struct elfFunc * const funcs = noisyRealloc(
+			worker->funcs, capacity * sizeof(*funcs));
+		if (funcs == NULL)
+			return -1;
+
+		worker->funcs = funcs;
+		worker->capacity = capacity;
+	}
+
+	worker->funcs[worker->n].vaddr = vaddr;
+	worker->funcs[worker->n].size = size;
+	worker->n++;
+	return 0;
+}
+
+/* Decodes the function at vaddr until a return, a tail call or an indirect
+   branch which no forward branch jumps over, or until a known function.
+   Calls are followed, or the size is recorded if sizing. */
+static int traverse(struct funcsWorker * restrict worker,
+		    const struct funcsSegment * restrict segment,
+		    Elf32_Addr vaddr)
+{
+	struct funcsPool * const pool = worker->pool;
+	const unsigned char * const bytes
+		= segment->bytes + (vaddr - segment->vaddr);
+	const size_t bit = bitOf(segment, vaddr);
+	Elf32_Word limit = segment->size - (vaddr - segment->vaddr);
+	Elf32_Addr reach = vaddr;
+	Elf32_Word offset = 0;
+
+	if (limit > FUNCS_SIZE_MAX)
+		limit = FUNCS_SIZE_MAX;
+
+	while (limit - offset >= sizeof(uint16_t)) {
+		const Elf32_Addr pc = vaddr + offset;
+		struct elfBranchInsn insn;
+		uint16_t halves[2] = { 0, 0 };
+
+		if (offset > 0 && pc >= reach
+		    && isKnown(pool, bit + offset / sizeof(uint16_t)))
+			break;
+
+		memcpy(halves, bytes + offset,
+		       limit - offset >= sizeof(halves) ?
+			sizeof(halves) : sizeof(uint16_t));
+		elfBranchDecodeThumb(halves[0], halves[1], pc, &insn);
+		if (insn.size > limit - offset)
+			break;
+
+		offset += insn.size;
+
+		const Elf32_Addr target = insn.target & ~(Elf32_Addr)1;
+		const Elf32_Addr next = vaddr + offset;
+		const struct funcsSegment *callee;
+		bool terminates = false;
+
+		switch (insn.kind) {
+		case ELF_BRANCH_BL:
+			if (pool->sizing)
+				break;
+
+			callee = findSegment(pool, target);
+			if (callee != NULL && claim(pool, callee, target)) {
+				pthread_mutex_lock(&pool->lock);
+				const int result = push(pool, target);
+				if (result != 0)
+					pool->result = result;
+				else
+					pthread_cond_signal(&pool->cond);
+				pthread_mutex_unlock(&pool->lock);
+
+				if (result != 0)
+					return result;
+			}
+
+			break;
+
+		case ELF_BRANCH_COND:
+			if (target > reach && target - vaddr < limit)
+				reach = target;
+
+			break;
+
+		/* A jump forward into this function unless it is known to
+		   begin another one. */
+		case ELF_BRANCH_B:
+			if (target > pc && target - vaddr < limit
+			    && !isKnown(pool, bit + (target - vaddr)
+					      / sizeof(uint16_t))
+			    && target > reach)
+				reach = target;
+
+			terminates = true;
+			break;
+
+		case ELF_BRANCH_RETURN:
+		case ELF_BRANCH_INDIRECT:
+			terminates = true;
+			break;
+
+		default:
+			break;
+		}
+
+		if (terminates && next >= reach)
+			break;
+	}
+
+	return pool->sizing ? record(worker, vaddr, offset) : 0;
+}
+
+static void *funcsWork(void *p)
+{
+	struct funcsWorker * const worker = p;
+	struct funcsPool * const pool = worker->pool;
+
+	pthread_mutex_lock(&pool->lock);
+
+	while (true) {
+		while (pool->n <= 0 && pool->busy > 0 && pool->result == 0)
+			pthread_cond_wait(&pool->cond, &pool->lock);
+
+		if (pool->n <= 0 || pool->result != 0)
+			break;
+
+		pool->n--;
+		const Elf32_Addr vaddr = pool->stack[pool->n];
+		pool->busy++;
+		pthread_mutex_unlock(&pool->lock);
+
+		const int result = traverse(worker,
+					    findSegment(pool, vaddr), vaddr);
+
+		pthread_mutex_lock(&pool->lock);
+		pool->busy--;
+		if (result != 0)
+			pool->result = result;
+	}
+
+	/* Wake the others up to tell the stack ran out or failed. */
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+/* Runs workers until the stack runs out. The calling thread is a worker
+   too. */
+static void run(struct funcsPool * restrict pool,
+		struct funcsWorker * restrict workers, size_t nWorkers)
+{
+	poolSpawn(funcsWork, workers, sizeof(*workers),
+		  pool->n < nWorkers ? pool->n + 1 : nWorkers);
+}
+
+/* Copies visited to known. No one may claim meanwhile. */
+static void freeze(struct funcsPool * restrict pool, size_t words)
+{
+	for (size_t ndx = 0; ndx < words; ndx++)
+		pool->known[ndx] = atomic_load_explicit(pool->visited + ndx,
+						       memory_order_relaxed);
+}
+
+/* Pushes every known function to be sized. */
+static int pushKnown(struct funcsPool * restrict pool)
+{
+	for (Elf32_Half ndx = 0; ndx < pool->nSegments; ndx++) {
+		const struct funcsSegment * const segment
+			= pool->segments + ndx;
+		const size_t n = segment->size / sizeof(uint16_t);
+
+		for (size_t half = 0; half < n; half++) {
+			const size_t bit = segment->bit + half;
+
+			/* Skip words without functions. */
+			if (bit % 32 == 0 && pool->known[bit / 32] == 0) {
+				half += 31;
+				continue;
+			}
+
+			if (isKnown(pool, bit)
+			    && push(pool, segment->vaddr
+					  + half * sizeof(uint16_t)) != 0)
+				return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int compareFuncs(const void *a, const void *b)
+{
+	const Elf32_Addr x = ((const struct elfFunc *)a)->vaddr;
+	const Elf32_Addr y = ((const struct elfFunc *)b)->vaddr;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Collects the results of the workers, sorted and cut at the next
+   function. */
+static int gather(struct elfFuncs * restrict funcs,
+		  const struct funcsWorker * restrict workers,
+		  size_t nWorkers)
+{
+	size_t n = 0;
+
+	for (size_t ndx = 0; ndx < nWorkers; ndx++)
+		n += workers[ndx].n;
+
+	funcs->funcs = noisyMalloc(n * sizeof(*funcs->funcs));
+	if (funcs->funcs == NULL)
+		return -1;
+
+	funcs->n = 0;
+	for (size_t ndx = 0; ndx < nWorkers; ndx++) {
+		if (workers[ndx].n <= 0)
+			continue;
+
+		memcpy(funcs->funcs + funcs->n, workers[ndx].funcs,
+		       workers[ndx].n * sizeof(*funcs->funcs));
+		funcs->n += workers[ndx].n;
+	}
+
+	if (funcs->n > 0)
+		qsort(funcs->funcs, funcs->n, sizeof(*funcs->funcs),
+		      compareFuncs);
+
+	for (Elf32_Word ndx = 0; ndx + 1 < funcs->n; ndx++) {
+		struct elfFunc * const func = funcs->funcs + ndx;
+		const Elf32_Word gap = func[1].vaddr - func->vaddr;
+
+		if (func->size > gap)
+			func->size = gap;
+	}
+
+	return 0;
+}
+
+int elfFuncsDiscover(struct elfFuncs * restrict funcs,
+		     const struct elfImage * restrict image,
+		     const Elf32_Addr * restrict seeds, Elf32_Word nSeeds)
+{
+	const Elf32_Ehdr * const ehdr = image->buffer;
+	const Elf32_Phdr * const phdrs
+		= elfImageOffToPtr(image, ehdr->e_phoff);
+	struct funcsWorker workers[POOL_THREADS_MAX];
+	size_t bits = 0;
+	int result = -1;
+
+	struct funcsSegment * const segments
+		= noisyMalloc((ehdr->e_phnum + 1) * sizeof(*segments));
+	if (segments == NULL)
+		return -1;
+
+	struct funcsPool pool = {
+		PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+		segments, 0, NULL, NULL, false, NULL, 0, 0, 0, 0
+	};
+
+	/* Thumb instructions are aligned to halfwords. */
+	for (Elf32_Half ndx = 0; ndx < ehdr->e_phnum; ndx++) {
+		const Elf32_Phdr * const phdr = phdrs + ndx;
+		const Elf32_Word skew = phdr->p_vaddr & 1;
+
+		if (phdr->p_type != PT_LOAD || (phdr->p_flags & PF_X) == 0
+		    || phdr->p_filesz <= skew)
+			continue;
+
+		segments[pool.nSegments].bytes
+			= (const unsigned char *)elfImageOffToPtr(
+				image, phdr->p_offset) + skew;
+		segments[pool.nSegments].vaddr = phdr->p_vaddr + skew;
+		segments[pool.nSegments].size
+			= (phdr->p_filesz - skew) & ~(Elf32_Word)1;
+		segments[pool.nSegments].bit = bits;
+		bits += segments[pool.nSegments].size / sizeof(uint16_t);
+		pool.nSegments++;
+	}
+
+	const size_t words = bits / 32 + 1;
+	pool.visited = calloc(words, sizeof(*pool.visited));
+	if (pool.visited == NULL) {
+		perror(NULL);
+		goto failVisited;
+	}
+
+	pool.known = noisyMalloc(words * sizeof(*pool.known));
+	if (pool.known == NULL)
+		goto failKnown;
+
+	for (Elf32_Word ndx = 0; ndx < nSeeds; ndx++) {
+		const Elf32_Addr vaddr = seeds[ndx] & ~(Elf32_Addr)1;
+		const struct funcsSegment * const segment
+			= findSegment(&pool, vaddr);
+
+		if (segment != NULL && claim(&pool, segment, vaddr)
+		    && push(&pool, vaddr) != 0)
+			goto failStack;
+	}
+
+	freeze(&pool, words);
+
+	const size_t wanted = poolWorkers();
+
+	for (size_t ndx = 0; ndx < wanted; ndx++) {
+		workers[ndx].pool = &pool;
+		workers[ndx].funcs = NULL;
+		workers[ndx].n = 0;
+		workers[ndx].capacity = 0;
+	}
+
+	/* Follow calls, stopping only at seeds, and then measure every
+	   function with all of them known. */
+	run(&pool, workers, wanted);
+	if (pool.result != 0)
+		goto failRun;
+
+	freeze(&pool, words);
+	pool.sizing = true;
+	if (pushKnown(&pool) != 0)
+		goto failRun;
+
+	run(&pool, workers, wanted);
+	if (pool.result == 0)
+		result = gather(funcs, workers, wanted);
+
+failRun:
+	for (size_t ndx = 0; ndx < wanted; ndx++)
+		free(workers[ndx].funcs);
+
+failStack:
+	free(pool.stack);
+	free(pool.known);
+failKnown:
+	free(pool.visited);
+failVisited:
+	free(segments);
+	return result;
+}
+
+void elfFuncsDeinit(const struct elfFuncs * restrict funcs)
+{
+	free(funcs->funcs);
+}
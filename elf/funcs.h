@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ELF_FUNCS_H
+#define ELF_FUNCS_H
+
+#include "elf.h"
+#include "image.h"
+
+/* A function found by elfFuncsDiscover. */
+struct elfFunc {
+	/* Without the Thumb bit. */
+	Elf32_Addr vaddr;
+
+	/* Up to the last return or tail call reached by falling through, and
+	   not beyond the next function. */
+	Elf32_Word size;
+};
+
+struct elfFuncs {
+	/* Sorted by address. */
+	struct elfFunc *funcs;
+	Elf32_Word n;
+};
+
+/* Finds Thumb functions in executable loadable segments by following direct
+   calls from seeds, which are taken as Thumb whether they have the Thumb bit
+   or not. Seeds out of executable segments are ignored. The seeds are
+   included in the result. */
+int elfFuncsDiscover(struct elfFuncs * restrict funcs,
+		     const struct elfImage * restrict image,
+		     const Elf32_Addr * restrict seeds, Elf32_Word nSeeds);
+
+void elfFuncsDeinit(const struct elfFuncs * restrict funcs);
+
+#endif
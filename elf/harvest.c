@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../nid/crack.h"
+#include "../noisy/lib.h"
+#include "elf.h"
+#include "harvest.h"
+#include "image.h"
+
+/* The number of bytes classified at once. */
+#define HARVEST_BLOCK 64
+
+/* Shorter identifiers are mostly noise in strings. */
+#define HARVEST_WORD_MIN 4
+
+#define HARVEST_WORD_MAX 128
+
+struct harvest {
+	struct nidCrackWord *words;
+	size_t n;
+	size_t capacity;
+
+	/* Open addressing over indices of words plus one; 0 is empty. */
+	size_t *slots;
+	size_t nSlots;
+};
+
+static unsigned int firstSet(uint64_t mask)
+{
+#ifdef __GNUC__
+	return mask == 0 ? HARVEST_BLOCK : __builtin_ctzll(mask);
+#else
+	unsigned int ndx = 0;
+
+	while (ndx < HARVEST_BLOCK && (mask & (UINT64_C(1) << ndx)) == 0)
+		ndx++;
+
+	return ndx;
+#endif
+}
+
+static uint64_t isPrintable(unsigned char c)
+{
+	/* Log messages end with newlines. */
+	return (c >= 0x20 && c < 0x7F) | (c >= '\t' && c <= '\r');
+}
+
+/* Returns a mask of printable bytes. A full block has no branches so that
+   compilers vectorize it. */
+static uint64_t classify(const unsigned char * restrict bytes, size_t n)
+{
+	uint64_t mask = 0;
+
+	if (n >= HARVEST_BLOCK) {
+		for (unsigned int ndx = 0; ndx < HARVEST_BLOCK; ndx++)
+			mask |= isPrintable(bytes[ndx]) << ndx;
+	} else {
+		for (unsigned int ndx = 0; ndx < n; ndx++)
+			mask |= isPrintable(bytes[ndx]) << ndx;
+	}
+
+	return mask;
+}
+
+static bool isIdentifier(unsigned char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+	       || (c >= '0' && c <= '9') || c == '_';
+}
+
+static uint32_t hashWord(const char * restrict string, size_t size)
+{
+	uint32_t hash = 0x811C9DC5;
+
+	for (size_t ndx = 0; ndx < size; ndx++)
+		hash = (hash ^ (unsigned char)string[ndx]) * 0x01000193;
+
+	return hash;
+}
+
+static int grow(struct harvest * restrict harvest)
+{
+	const size_t nSlots = harvest->nSlots <= 0 ? 4096 : harvest->nSlots * 2;
+	size_t * const slots = noisyCalloc(nSlots * sizeof(*slots));
+	if (slots == NULL)
+		return -1;
+
+	for (size_t ndx = 0; ndx < harvest->n; ndx++) {
+		const struct nidCrackWord * const word = harvest->words + ndx;
+		size_t slot = hashWord(word->string, word->size) & (nSlots - 1);
+
+		while (slots[slot] != 0)
+			slot = (slot + 1) & (nSlots - 1);
+
+		slots[slot] = ndx + 1;
+	}
+
+	const size_t capacity = nSlots / 2;
+	struct nidCrackWord * const words = noisyRealloc(
+		harvest->words, capacity * sizeof(*words));
+	if (words == NULL) {
+		free(slots);
+		return -1;
+	}
+
+	free(harvest->slots);
+	harvest->slots = slots;
+	harvest->nSlots = nSlots;
+	harvest->words = words;
+	harvest->capacity = capacity;
+	return 0;
+}
+
+static int addWord(struct harvest * restrict harvest,
+		   const char * restrict string, size_t size)
+{
+	if (harvest->n >= harvest->capacity && grow(harvest) != 0)
+		return -1;
+
+	const size_t mask = harvest->nSlots - 1;
+	size_t slot = hashWord(string, size) & mask;
+
+	while (harvest->slots[slot] != 0) {
+		const struct nidCrackWord * const word
+			= harvest->words + harvest->slots[slot] - 1;
+
+		if (word->size == size
+		    && memcmp(word->string, string, size) == 0)
+			return 0;
+
+		slot = (slot + 1) & mask;
+	}
+
+	harvest->words[harvest->n].string = string;
+	harvest->words[harvest->n].size = size;
+	harvest->n++;
+	harvest->slots[slot] = harvest->n;
+	return 0;
+}
+
+/* Adds an identifier, and also its stem if it has a prefix or a suffix
+   the cracker tries anyway, so that sceIoOpen gives ksceIoOpen too. */
+static int addIdentifier(struct harvest * restrict harvest,
+			 const char * restrict string, size_t size)
+{
+	const char *stem = string;
+	size_t stemSize = size;
+
+	if (addWord(harvest, string, size) != 0)
+		return -1;
+
+	/* The longest matching prefix is the last one. */
+	for (size_t ndx = NID_CRACK_PREFIXES - 1; ndx > 0; ndx--) {
+		const size_t prefixSize = strlen(nidCrackPrefixes[ndx]);
+
+		if (stemSize > prefixSize
+		    && memcmp(stem, nidCrackPrefixes[ndx], prefixSize) == 0
+		    && stem[prefixSize] >= 'A' && stem[prefixSize] <= 'Z') {
+			stem += prefixSize;
+			stemSize -= prefixSize;
+			break;
+		}
+	}
+
+	for (size_t ndx = 1; ndx < NID_CRACK_SUFFIXES; ndx++) {
+		const size_t suffixSize = strlen(nidCrackSuffixes[ndx]);
+
+		if (stemSize > suffixSize
+		    && memcmp(stem + stemSize - suffixSize,
+			      nidCrackSuffixes[ndx], suffixSize) == 0) {
+			stemSize -= suffixSize;
+			break;
+		}
+	}
+
+	return stemSize == size || stemSize < HARVEST_WORD_MIN ?
+		0 : addWord(harvest, stem, stemSize);
+}
+
+/* Splits a printable string into identifiers which don't begin with a
+   digit. */
+static int takeString(struct harvest * restrict harvest,
+		      const char * restrict string, size_t size)
+{
+	size_t ndx = 0;
+
+	while (ndx < size) {
+		while (ndx < size && !isIdentifier(string[ndx]))
+			ndx++;
+
+		const size_t top = ndx;
+		while (ndx < size && isIdentifier(string[ndx]))
+			ndx++;
+
+		if (ndx - top >= HARVEST_WORD_MIN
+		    && ndx - top <= HARVEST_WORD_MAX
+		    && !(string[top] >= '0' && string[top] <= '9')
+		    && addIdentifier(harvest, string + top, ndx - top) != 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/* Streams over a segment in blocks and takes runs of printable bytes
+   terminated with NUL. */
+static int scanSegment(struct harvest * restrict harvest,
+		       const char * restrict segment, size_t size)
+{
+	const unsigned char * const bytes = (const void *)segment;
+	bool inString = false;
+	size_t start = 0;
+
+	for (size_t offset = 0; offset < size; offset += HARVEST_BLOCK) {
+		const size_t n = size - offset < HARVEST_BLOCK ?
+			size - offset : HARVEST_BLOCK;
+		const uint64_t printable = classify(bytes + offset, n);
+		unsigned int ndx = 0;
+
+		while (ndx < n) {
+			const uint64_t above = ~UINT64_C(0) << ndx;
+
+			ndx = firstSet((inString ? ~printable : printable)
+				       & above);
+			if (ndx >= n)
+				break;
+
+			if (!inString) {
+				start = offset + ndx;
+			} else if (bytes[offset + ndx] == 0
+				   && takeString(harvest, segment + start,
+						 offset + ndx - start) != 0) {
+				return -1;
+			}
+
+			inString = !inString;
+		}
+	}
+
+	return 0;
+}
+
+int elfHarvestWords(const struct elfImage * restrict image,
+		    struct nidCrackWord ** restrict words,
+		    size_t * restrict n)
+{
+	const Elf32_Ehdr * const ehdr = image->buffer;
+	const Elf32_Phdr * const phdrs
+		= elfImageOffToPtr(image, ehdr->e_phoff);
+	struct harvest harvest = { NULL, 0, 0, NULL, 0 };
+
+	for (Elf32_Half ndx = 0; ndx < ehdr->e_phnum; ndx++) {
+		if (phdrs[ndx].p_type != PT_LOAD)
+			continue;
+
+		if (scanSegment(&harvest,
+				elfImageOffToPtr(image, phdrs[ndx].p_offset),
+				phdrs[ndx].p_filesz) != 0) {
+			free(harvest.slots);
+			free(harvest.words);
+			return -1;
+		}
+	}
+
+	free(harvest.slots);
+	*words = harvest.words;
+	*n = harvest.n;
+	return 0;
+}
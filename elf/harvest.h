@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ELF_HARVEST_H
+#define ELF_HARVEST_H
+
+#include <stddef.h>
+#include "../nid/crack.h"
+#include "image.h"
+
+/* Collects distinct identifiers in NUL-terminated strings of the loadable
+   segments, and their stems without the conventional prefixes and
+   suffixes. words point into the image and must be freed. */
+int elfHarvestWords(const struct elfImage * restrict image,
+		    struct nidCrackWord ** restrict words,
+		    size_t * restrict n);
+
+#endif
@@ -0,0 +1,385 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../noisy/lib.h"
+#include "branch.h"
+#include "driver.h"
+#include "elf.h"
+#include "hooks.h"
+#include "image.h"
+
+/* An import stub as the loader writes: MOVW R12, MOVT R12, BX R12 and NOP in
+   ARM. Immediates are not compared. */
+static const uint32_t stubValues[4] = {
+	0xE300C000, 0xE340C000, 0xE12FFF1C, 0xE320F000
+};
+
+static const uint32_t stubMasks[4] = {
+	0xFFF0F000, 0xFFF0F000, 0xFFFFFFFF, 0xFFFFFFFF
+};
+
+struct hooksBuilder {
+	struct elfHook *hooks;
+	Elf32_Word n;
+	Elf32_Word capacity;
+};
+
+static int compareAddrs(const void *a, const void *b)
+{
+	const Elf32_Addr x = *(const Elf32_Addr *)a;
+	const Elf32_Addr y = *(const Elf32_Addr *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int add(struct hooksBuilder * restrict builder,
+	       enum elfHookKind kind, Elf32_Addr vaddr, bool known,
+	       Elf32_Addr target)
+{
+	if (builder->n >= builder->capacity) {
+		const Elf32_Word capacity = builder->capacity <= 0 ?
+			64 : builder->capacity * 2;
+		struct elfHook * const hooks = noisyRealloc(
+			builder->hooks, capacity * sizeof(*hooks));
+		if (hooks == NULL)
+			return -1;
+
+		builder->hooks = hooks;
+		builder->capacity = capacity;
+	}
+
+	builder->hooks[builder->n].kind = kind;
+	builder->hooks[builder->n].vaddr = vaddr;
+	builder->hooks[builder->n].known = known;
+	builder->hooks[builder->n].target = target;
+	builder->n++;
+	return 0;
+}
+
+static bool readWord(const struct elfImage * restrict image,
+		     Elf32_Addr vaddr, Elf32_Word * restrict word)
+{
+	const void * const ptr = elfImageVaddrToPtr(image, vaddr,
+						    sizeof(*word), NULL);
+	if (ptr == NULL)
+		return false;
+
+	memcpy(word, ptr, sizeof(*word));
+	return true;
+}
+
+static uint32_t armImm16(uint32_t word)
+{
+	return (word >> 4 & 0xF000) | (word & 0xFFF);
+}
+
+static uint32_t thumbImm16(uint16_t first, uint16_t second)
+{
+	return (first & 0xF) << 12 | (first >> 10 & 1) << 11
+	       | (second >> 12 & 7) << 8 | (second & 0xFF);
+}
+
+/* Decodes LDR PC, [PC, #imm], B, and MOVW and MOVT of a register followed by
+   BX of it, in ARM. */
+static bool decodeArm(const struct elfImage * restrict image,
+		      Elf32_Addr vaddr, bool branches,
+		      Elf32_Addr * restrict target)
+{
+	uint32_t words[3];
+
+	const void * const ptr = elfImageVaddrToPtr(image, vaddr,
+						    sizeof(words), NULL);
+	if (ptr == NULL)
+		return false;
+
+	memcpy(words, ptr, sizeof(words));
+
+	if ((words[0] & 0xFF7FF000) == 0xE51FF000) {
+		const Elf32_Word imm = words[0] & 0xFFF;
+
+		return readWord(image, (words[0] & 0x00800000) != 0 ?
+					vaddr + 8 + imm : vaddr + 8 - imm,
+				target);
+	}
+
+	if (branches && elfBranchArm(words[0], vaddr, target) == ELF_BRANCH_B)
+		return true;
+
+	const uint32_t rd = words[0] >> 12 & 0xF;
+	if ((words[0] & 0xFFF00000) == 0xE3000000
+	    && (words[1] & 0xFFF0F000) == (0xE3400000 | rd << 12)
+	    && words[2] == (0xE12FFF10 | rd)) {
+		*target = armImm16(words[0]) | armImm16(words[1]) << 16;
+		return true;
+	}
+
+	return false;
+}
+
+/* Decodes LDR.W PC, [PC, #imm], and MOVW and MOVT of a register followed by
+   BX of it, in Thumb. */
+static bool decodeThumb(const struct elfImage * restrict image,
+			Elf32_Addr vaddr, Elf32_Addr * restrict target)
+{
+	uint16_t halves[5];
+
+	const void * const ptr = elfImageVaddrToPtr(image, vaddr,
+						    sizeof(halves), NULL);
+	if (ptr == NULL)
+		return false;
+
+	memcpy(halves, ptr, sizeof(halves));
+
+	if ((halves[0] & 0xFF7F) == 0xF85F && (halves[1] & 0xF000) == 0xF000) {
+		const Elf32_Word imm = halves[1] & 0xFFF;
+		const Elf32_Addr base = (vaddr + 4) & ~(Elf32_Addr)3;
+
+		return readWord(image, (halves[0] & 0x80) != 0 ?
+					base + imm : base - imm,
+				target);
+	}
+
+	const uint16_t rd = halves[1] >> 8 & 0xF;
+	if ((halves[0] & 0xFBF0) == 0xF240 && (halves[1] & 0x8000) == 0
+	    && (halves[2] & 0xFBF0) == 0xF2C0
+	    && (halves[3] & 0x8F00) == rd << 8
+	    && halves[4] == (0x4700 | rd << 3)) {
+		*target = thumbImm16(halves[0], halves[1])
+			  | thumbImm16(halves[2], halves[3]) << 16;
+		return true;
+	}
+
+	return false;
+}
+
+/* Collects the entries of functions of imports or exports. */
+static int collect(const struct elfImage * restrict image,
+		   const struct elfImageModule * restrict modules,
+		   Elf32_Word nModules, bool exports,
+		   Elf32_Addr ** restrict addrs, Elf32_Word * restrict n)
+{
+	Elf32_Word capacity = 0;
+
+	*addrs = NULL;
+	*n = 0;
+
+	for (Elf32_Word module = 0; module < nModules; module++) {
+		if (!modules[module].found)
+			continue;
+
+		const char *cursor = exports ?
+			(const char *)modules[module].exp.top :
+			(const char *)modules[module].imp.top;
+		const char * const btm = exports ?
+			(const char *)modules[module].exp.btm :
+			(const char *)modules[module].imp.btm;
+
+		/* Imports are 44 bytes without TLS and 52 bytes with it. */
+		while (cursor < btm) {
+			const struct elfExp * const exp = (const void *)cursor;
+			const struct elfImp * const imp = (const void *)cursor;
+			const Elf32_Word nFuncs = exports ?
+				exp->nFuncs : imp->nFuncs;
+			const Elf32_Word *entries = elfImageVaddrToPtr(
+				image, exports ? exp->entries : imp->funcEntries,
+				nFuncs * sizeof(*entries), NULL);
+			const Elf32_Word size = exports ?
+				sizeof(*exp) : imp->size;
+
+			if (size <= 0)
+				break;
+
+			cursor += size;
+			if (entries == NULL)
+				continue;
+
+			if (*n + nFuncs > capacity) {
+				capacity = *n + nFuncs > capacity * 2 ?
+					*n + nFuncs : capacity * 2;
+				Elf32_Addr * const grown = noisyRealloc(
+					*addrs, capacity * sizeof(**addrs));
+				if (grown == NULL) {
+					free(*addrs);
+					return -1;
+				}
+
+				*addrs = grown;
+			}
+
+			memcpy(*addrs + *n, entries, nFuncs * sizeof(*entries));
+			*n += nFuncs;
+		}
+	}
+
+	if (*n > 0)
+		qsort(*addrs, *n, sizeof(**addrs), compareAddrs);
+
+	return 0;
+}
+
+/* Compares all stubs at once. It has no branches so that compilers
+   vectorize it. */
+static void compareStubs(const uint32_t (* restrict rows)[4], Elf32_Word n,
+			 bool * restrict mismatches)
+{
+	for (Elf32_Word ndx = 0; ndx < n; ndx++) {
+		uint32_t diff = 0;
+
+		for (int word = 0; word < 4; word++)
+			diff |= (rows[ndx][word] ^ stubValues[word])
+				& stubMasks[word];
+
+		mismatches[ndx] = diff != 0;
+	}
+}
+
+static int checkStubs(struct hooksBuilder * restrict builder,
+		      const struct elfImage * restrict image,
+		      const Elf32_Addr * restrict stubs, Elf32_Word nStubs,
+		      const Elf32_Addr * restrict exps, Elf32_Word nExps)
+{
+	int result = -1;
+
+	uint32_t (* const rows)[4] = noisyMalloc(nStubs * sizeof(*rows) + 1);
+	if (rows == NULL)
+		return -1;
+
+	bool * const mismatches = noisyMalloc(nStubs * sizeof(*mismatches)
+					      + 1);
+	if (mismatches == NULL)
+		goto failMismatches;
+
+	/* Stubs out of the dump are taken as written by the loader, jumping
+	   nowhere. */
+	for (Elf32_Word ndx = 0; ndx < nStubs; ndx++) {
+		const void * const ptr = elfImageVaddrToPtr(
+			image, stubs[ndx], sizeof(*rows), NULL);
+
+		if (ptr == NULL)
+			memcpy(rows[ndx], stubValues, sizeof(*rows));
+		else
+			memcpy(rows[ndx], ptr, sizeof(*rows));
+	}
+
+	compareStubs((const uint32_t (*)[4])rows, nStubs, mismatches);
+
+	for (Elf32_Word ndx = 0; ndx < nStubs; ndx++) {
+		if (ndx > 0 && stubs[ndx] == stubs[ndx - 1])
+			continue;
+
+		Elf32_Addr target;
+		if (mismatches[ndx]) {
+			const bool known = decodeArm(image, stubs[ndx], true,
+						     &target);
+			if (add(builder, ELF_HOOK_STUB, stubs[ndx], known,
+				known ? target : 0) != 0)
+				goto failAdd;
+
+			continue;
+		}
+
+		target = armImm16(rows[ndx][0]) | armImm16(rows[ndx][1]) << 16;
+		const Elf32_Addr code = target & ~(Elf32_Addr)1;
+		if (elfImageVaddrToPtr(image, code, 2, NULL) == NULL)
+			continue;
+
+		size_t lo = 0;
+		size_t hi = nExps;
+		while (lo < hi) {
+			const size_t mid = lo + (hi - lo) / 2;
+
+			if ((exps[mid] & ~(Elf32_Addr)1) < code)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		if ((lo >= nExps || (exps[lo] & ~(Elf32_Addr)1) != code)
+		    && add(builder, ELF_HOOK_REDIRECT, stubs[ndx], true,
+			   target) != 0)
+			goto failAdd;
+	}
+
+	result = 0;
+
+failAdd:
+	free(mismatches);
+failMismatches:
+	free(rows);
+	return result;
+}
+
+int elfHooksFind(struct elfHooks * restrict hooks,
+		 const struct elfImage * restrict image,
+		 const struct elfImageModule * restrict modules,
+		 Elf32_Word nModules, bool exports)
+{
+	struct hooksBuilder builder = { NULL, 0, 0 };
+	Elf32_Addr *stubs;
+	Elf32_Addr *exps;
+	Elf32_Word nStubs;
+	Elf32_Word nExps;
+	int result = -1;
+
+	if (collect(image, modules, nModules, false, &stubs, &nStubs) != 0)
+		return -1;
+
+	if (collect(image, modules, nModules, true, &exps, &nExps) != 0)
+		goto failExps;
+
+	if (checkStubs(&builder, image, stubs, nStubs, exps, nExps) != 0)
+		goto failCheck;
+
+	for (Elf32_Word ndx = 0; exports && ndx < nExps; ndx++) {
+		const Elf32_Addr vaddr = exps[ndx];
+		Elf32_Addr target;
+
+		if (ndx > 0 && vaddr == exps[ndx - 1])
+			continue;
+
+		const bool hooked = (vaddr & 1) != 0 ?
+			decodeThumb(image, vaddr & ~(Elf32_Addr)1, &target) :
+			decodeArm(image, vaddr, false, &target);
+		if (hooked && add(&builder, ELF_HOOK_EXPORT, vaddr, true,
+				  target) != 0)
+			goto failCheck;
+	}
+
+	hooks->hooks = builder.hooks;
+	hooks->n = builder.n;
+	result = 0;
+
+failCheck:
+	if (result != 0)
+		free(builder.hooks);
+
+	free(exps);
+failExps:
+	free(stubs);
+	return result;
+}
+
+void elfHooksDeinit(const struct elfHooks * restrict hooks)
+{
+	free(hooks->hooks);
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ELF_HOOKS_H
+#define ELF_HOOKS_H
+
+#include <stdbool.h>
+#include "elf.h"
+#include "image.h"
+
+enum elfHookKind {
+	/* An import stub which the loader didn't write. */
+	ELF_HOOK_STUB,
+
+	/* An import stub as the loader writes, jumping into the dump but to
+	   none of the exports of the modules. */
+	ELF_HOOK_REDIRECT,
+
+	/* An export beginning with a jump to a literal address. */
+	ELF_HOOK_EXPORT
+};
+
+struct elfHook {
+	enum elfHookKind kind;
+
+	/* The stub, or the export with the Thumb bit if it is Thumb code. */
+	Elf32_Addr vaddr;
+
+	/* Where it jumps, if known. */
+	bool known;
+	Elf32_Addr target;
+};
+
+struct elfHooks {
+	/* Imports first, each sorted by address. */
+	struct elfHook *hooks;
+	Elf32_Word n;
+};
+
+/* Compares the import stubs of modules with the encodings the loader writes,
+   and with exports set, checks the first instructions of exports for
+   trampolines. */
+int elfHooksFind(struct elfHooks * restrict hooks,
+		 const struct elfImage * restrict image,
+		 const struct elfImageModule * restrict modules,
+		 Elf32_Word nModules, bool exports);
+
+void elfHooksDeinit(const struct elfHooks * restrict hooks);
+
+#endif
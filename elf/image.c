@@ -15,8 +15,13 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include "../noisy/lib.h"
 #include "../overflow.h"
 #include "../readwhole.h"
 #include "elf.h"
@@ -24,83 +29,343 @@
 #include "image.h"
 #include "info.h"
 
-int elfImageFindInfo(const struct elfImage * restrict image,
+/* The number of words compared at once in findWord. */
+#define FIND_BLOCK 16
+
+/* The number of bits of the filter used by findInfosInSegment. */
+#define FIND_FILTER_BITS 16
+
+struct findPattern {
+	uint32_t key;
+	uint32_t mask;
+	size_t cmpSize;
+	Elf32_Word module;
+};
+
+/* Returns the offset of the first 4-byte aligned word in [from, to) which
+   matches key under mask, or to if nothing matches. Matches are looked for
+   a block at a time without branches so that compilers vectorize it. */
+static Elf32_Word findWord(const char * restrict segment,
+			   Elf32_Word from, Elf32_Word to,
+			   uint32_t key, uint32_t mask)
+{
+	Elf32_Word offset = from;
+
+	while (to - offset >= FIND_BLOCK * sizeof(uint32_t)) {
+		uint32_t words[FIND_BLOCK];
+		int any = 0;
+
+		memcpy(words, segment + offset, sizeof(words));
+		for (int ndx = 0; ndx < FIND_BLOCK; ndx++)
+			any |= (words[ndx] & mask) == key;
+
+		if (any)
+			break;
+
+		offset += sizeof(words);
+	}
+
+	for (; to - offset >= sizeof(uint32_t); offset += sizeof(uint32_t)) {
+		uint32_t word;
+
+		memcpy(&word, segment + offset, sizeof(word));
+		if ((word & mask) == key)
+			return offset;
+	}
+
+	return to;
+}
+
+/* Makes the leading bytes of the name, including the terminator if it is
+   short, a word to look for. */
+static void makePattern(const SceKernelModuleInfo * restrict kernelInfo,
+			Elf32_Word module, struct findPattern * restrict pattern)
+{
+	const size_t nameSize = strlen(kernelInfo->module_name) + 1;
+	unsigned char keyBytes[sizeof(uint32_t)] = { 0 };
+	unsigned char maskBytes[sizeof(uint32_t)] = { 0 };
+
+	for (size_t ndx = 0; ndx < sizeof(keyBytes) && ndx < nameSize; ndx++) {
+		keyBytes[ndx] = kernelInfo->module_name[ndx];
+		maskBytes[ndx] = 0xFF;
+	}
+
+	memcpy(&pattern->key, keyBytes, sizeof(pattern->key));
+	memcpy(&pattern->mask, maskBytes, sizeof(pattern->mask));
+	pattern->cmpSize = nameSize < sizeof(((SceModuleInfo *)NULL)->name) ?
+		nameSize : sizeof(((SceModuleInfo *)NULL)->name);
+	pattern->module = module;
+}
+
+/* Offsets in SceModuleInfo are relative to the base of the module, the
+   beginning of its text segment, which needn't be the beginning of the
+   PT_LOAD segment. SceKernelModuleInfo tells it if its text segment
+   contains SceModuleInfo; otherwise it is guessed from the exports right
+   after SceModuleInfo. */
+static Elf32_Addr guessBase(const Elf32_Phdr * restrict phdr, Elf32_Word ndx,
+			    const SceModuleInfo * restrict info,
+			    const SceKernelModuleInfo * restrict kernelInfo)
+{
+	const SceKernelSegmentInfo * const text = kernelInfo->segments;
+	const Elf32_Addr vaddr = phdr->p_vaddr + ndx;
+
+	if (text->vaddr <= vaddr && vaddr - text->vaddr < text->memsz)
+		return text->vaddr;
+
+	const Elf32_Word expTopOff = ndx + sizeof(SceModuleInfo);
+	return info->expTop <= expTopOff ?
+		phdr->p_vaddr + expTopOff - info->expTop : phdr->p_vaddr;
+}
+
+/* Validates a candidate at ndx of the segment. */
+static int checkInfo(const struct elfImage * restrict image,
+		     const Elf32_Phdr * restrict phdr, Elf32_Word ndx,
 		     const SceKernelModuleInfo * restrict kernelInfo,
-		     Elf32_Addr * restrict infoVaddr,
-		     struct elfImageExp * restrict exp,
-		     struct elfImageImp * restrict imp)
+		     size_t cmpSize, struct elfImageModule * restrict module)
 {
-	const void * const buffer = image->buffer;
-	const Elf32_Word phoff = ((Elf32_Ehdr *)buffer)->e_phoff;
-	const Elf32_Phdr * const phdr = (void *)((char *)buffer + phoff);
-	const char * const segment = (char *)buffer + phdr->p_offset;
+	const char * const segment = elfImageOffToPtr(image, phdr->p_offset);
+	const SceModuleInfo * const info = (void *)(segment + ndx);
 
-	if (phdr->p_filesz < sizeof(SceModuleInfo)) {
-		fprintf(stderr, "%s: too small segment 0\n", image->path);
+	if (memcmp(info->name, kernelInfo->module_name, cmpSize) != 0)
 		return -1;
-	}
 
-	for (Elf32_Word ndx = 0;
-	     ndx < phdr->p_filesz - sizeof(SceModuleInfo);
-	     ndx += 4) {
-		const SceModuleInfo * const info = (void *)(segment + ndx);
+	Elf32_Word expSize;
+	if (wsubOverflow(info->expBtm, info->expTop,
+			  &expSize))
+		return -1;
 
-		if (strcmp(info->name, kernelInfo->module_name) != 0)
-			continue;
+	/* Make a guess that exports are right after SceModuleInfo. */
+	const Elf32_Word expTopOff = ndx + sizeof(SceModuleInfo);
 
-		Elf32_Word expSize;
-		if (wsubOverflow(info->expBtm, info->expTop,
-				  &expSize))
-			continue;
+	Elf32_Word expBtmOff;
+	if (waddOverflow(expTopOff, expSize, &expBtmOff))
+		return -1;
 
-		/* Make a guess that exports are right after SceModuleInfo. */
-		const Elf32_Word expTopOff = ndx + sizeof(SceModuleInfo);
+	if (expBtmOff > phdr->p_filesz)
+		return -1;
 
-		Elf32_Word expBtmOff;
-		if (waddOverflow(expTopOff, expSize, &expBtmOff))
-			continue;
+	Elf32_Word impSize;
+	if (wsubOverflow(info->impBtm, info->impTop,
+			  &impSize))
+		return -1;
 
-		if (expBtmOff > phdr->p_filesz)
-			continue;
+	/* Make a guess that imports are right after exports */
+	const Elf32_Word impTopOff = expBtmOff;
 
-		Elf32_Word impSize;
-		if (wsubOverflow(info->impBtm, info->impTop,
-				  &impSize))
-			continue;
+	Elf32_Word impBtmOff;
+	if (waddOverflow(impTopOff, impSize, &impBtmOff))
+		return -1;
 
-		/* Make a guess that imports are right after exports */
-		const Elf32_Word impTopOff = expBtmOff;
+	if (impBtmOff > phdr->p_filesz)
+		return -1;
 
-		Elf32_Word impBtmOff;
-		if (waddOverflow(impTopOff, impSize, &impBtmOff))
-			continue;
+	module->info.ptr = info;
+	module->info.vaddr = phdr->p_vaddr + ndx;
 
-		if (impBtmOff > phdr->p_filesz)
-			continue;
+	module->exp.top = (void *)(segment + expTopOff);
+	module->exp.btm = (void *)(segment + expBtmOff);
 
-		const struct elfExp * const expTop
-			= (void *)(segment + expTopOff);
-		const struct elfExp * const expBtm
-			= (void *)(segment + expBtmOff);
+	module->imp.top = (void *)(segment + impTopOff);
+	module->imp.btm = (void *)(segment + impBtmOff);
 
-		const struct elfImp * const impTop
-			= (void *)(segment + impTopOff);
-		const struct elfImp * const impBtm
-			= (void *)(segment + impBtmOff);
+	module->name = kernelInfo->module_name;
+	module->base = guessBase(phdr, ndx, info, kernelInfo);
+	module->found = true;
 
-		*infoVaddr = phdr->p_vaddr + ndx;
+	return 0;
+}
 
-		exp->top = expTop;
-		exp->btm = expBtm;
+static void findInfoInSegment(const struct elfImage * restrict image,
+			      const Elf32_Phdr * restrict phdr,
+			      const SceKernelModuleInfo * restrict kernelInfo,
+			      struct elfImageModule * restrict module)
+{
+	const char * const segment = elfImageOffToPtr(image, phdr->p_offset);
+	const Elf32_Word nameOff = offsetof(SceModuleInfo, name);
+	struct findPattern pattern;
+
+	makePattern(kernelInfo, 0, &pattern);
+
+	const Elf32_Word last = phdr->p_filesz - sizeof(SceModuleInfo);
+	const Elf32_Word to = last + nameOff + sizeof(uint32_t);
+
+	for (Elf32_Word ndx = findWord(segment, nameOff, to,
+				       pattern.key, pattern.mask) - nameOff;
+	     ndx <= last;
+	     ndx = findWord(segment, ndx + nameOff + sizeof(uint32_t), to,
+			    pattern.key, pattern.mask) - nameOff)
+		if (checkInfo(image, phdr, ndx, kernelInfo, pattern.cmpSize,
+			      module) == 0)
+			return;
+}
 
-		imp->top = impTop;
-		imp->btm = impBtm;
+static uint32_t hashKey(uint32_t key)
+{
+	return (key * UINT32_C(0x9E3779B1)) >> (32 - FIND_FILTER_BITS);
+}
 
-		return 0;
+static int comparePatterns(const void *a, const void *b)
+{
+	const struct findPattern * const x = a;
+	const struct findPattern * const y = b;
+
+	if (x->key != y->key)
+		return x->key < y->key ? -1 : 1;
+
+	return x->module < y->module ? -1 : x->module > y->module;
+}
+
+/* Looks for all modules with a single pass over the segment. Each word is
+   first tested against a bit filter of the leading bytes of all names under
+   each distinct mask, and only hits are looked up in the sorted
+   patterns. */
+static void findInfosInSegment(const struct elfImage * restrict image,
+			       const Elf32_Phdr * restrict phdr,
+			       const SceKernelModuleInfo * const * restrict
+			       kernelInfos,
+			       const struct findPattern * restrict patterns,
+			       Elf32_Word nPatterns,
+			       const uint32_t * restrict masks,
+			       unsigned int nMasks,
+			       const uint64_t * restrict filter,
+			       struct elfImageModule * restrict modules,
+			       Elf32_Word * restrict left)
+{
+	const char * const segment = elfImageOffToPtr(image, phdr->p_offset);
+	const Elf32_Word nameOff = offsetof(SceModuleInfo, name);
+	const Elf32_Word last = phdr->p_filesz - sizeof(SceModuleInfo);
+
+	for (Elf32_Word ndx = 0; ndx <= last && *left > 0; ndx += 4) {
+		uint32_t word;
+
+		memcpy(&word, segment + ndx + nameOff, sizeof(word));
+
+		for (unsigned int m = 0; m < nMasks; m++) {
+			const uint32_t key = word & masks[m];
+			const uint32_t hash = hashKey(key);
+
+			if ((filter[hash / 64] & (UINT64_C(1) << hash % 64))
+			    == 0)
+				continue;
+
+			/* The first pattern with the key. */
+			Elf32_Word lo = 0;
+			Elf32_Word hi = nPatterns;
+			while (lo < hi) {
+				const Elf32_Word mid = lo + (hi - lo) / 2;
+				if (patterns[mid].key < key)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+
+			for (; lo < nPatterns && patterns[lo].key == key; lo++) {
+				const struct findPattern * const pattern
+					= patterns + lo;
+				struct elfImageModule * const module
+					= modules + pattern->module;
+
+				if (pattern->mask != masks[m] || module->found)
+					continue;
+
+				if (checkInfo(image, phdr, ndx,
+					      kernelInfos[pattern->module],
+					      pattern->cmpSize, module) == 0)
+					(*left)--;
+			}
+		}
 	}
+}
 
-	fprintf(stderr, "%s: sceModuleInfo not found\n", image->path);
-	return -1;
+static int findInfos(const struct elfImage * restrict image,
+		     const SceKernelModuleInfo * const * restrict kernelInfos,
+		     Elf32_Word n, struct elfImageModule * restrict modules)
+{
+	const void * const buffer = image->buffer;
+	const Elf32_Ehdr * const ehdr = buffer;
+	const Elf32_Phdr * const phdrsTop
+		= (void *)((char *)buffer + ehdr->e_phoff);
+	const Elf32_Phdr * const phdrsBtm = phdrsTop + ehdr->e_phnum;
+	uint32_t masks[sizeof(uint32_t)];
+	unsigned int nMasks = 0;
+	Elf32_Word left = n;
+
+	struct findPattern * const patterns = noisyMalloc(n * sizeof(*patterns));
+	if (patterns == NULL)
+		return -1;
+
+	uint64_t * const filter = noisyCalloc((1 << FIND_FILTER_BITS) / 8);
+	if (filter == NULL) {
+		free(patterns);
+		return -1;
+	}
+
+	for (Elf32_Word ndx = 0; ndx < n; ndx++) {
+		makePattern(kernelInfos[ndx], ndx, patterns + ndx);
+
+		const uint32_t hash = hashKey(patterns[ndx].key);
+		filter[hash / 64] |= UINT64_C(1) << hash % 64;
+
+		unsigned int m;
+		for (m = 0; m < nMasks; m++)
+			if (masks[m] == patterns[ndx].mask)
+				break;
+
+		if (m == nMasks)
+			masks[nMasks++] = patterns[ndx].mask;
+	}
+
+	qsort(patterns, n, sizeof(*patterns), comparePatterns);
+
+	for (const Elf32_Phdr *phdr = phdrsTop;
+	     phdr != phdrsBtm && left > 0;
+	     phdr++)
+		if (phdr->p_type == PT_LOAD
+		    && phdr->p_filesz >= sizeof(SceModuleInfo))
+			findInfosInSegment(image, phdr, kernelInfos,
+					   patterns, n, masks, nMasks, filter,
+					   modules, &left);
+
+	free(filter);
+	free(patterns);
+	return 0;
+}
+
+int elfImageFindInfos(const struct elfImage * restrict image,
+		      const SceKernelModuleInfo * const * restrict kernelInfos,
+		      Elf32_Word n, struct elfImageModule * restrict modules)
+{
+	const void * const buffer = image->buffer;
+	const Elf32_Ehdr * const ehdr = buffer;
+	const Elf32_Phdr * const phdrsTop
+		= (void *)((char *)buffer + ehdr->e_phoff);
+	const Elf32_Phdr * const phdrsBtm = phdrsTop + ehdr->e_phnum;
+	Elf32_Word found = 0;
+
+	for (Elf32_Word ndx = 0; ndx < n; ndx++)
+		modules[ndx].found = false;
+
+	if (n == 1) {
+		for (const Elf32_Phdr *phdr = phdrsTop;
+		     phdr != phdrsBtm && !modules->found;
+		     phdr++)
+			if (phdr->p_type == PT_LOAD
+			    && phdr->p_filesz >= sizeof(SceModuleInfo))
+				findInfoInSegment(image, phdr, *kernelInfos,
+						  modules);
+	} else if (findInfos(image, kernelInfos, n, modules) != 0) {
+		return -1;
+	}
+
+	for (Elf32_Word ndx = 0; ndx < n; ndx++) {
+		if (modules[ndx].found)
+			found++;
+		else
+			fprintf(stderr, "%s: sceModuleInfo of %s not found\n",
+				image->path, kernelInfos[ndx]->module_name);
+	}
+
+	return found > 0 ? 0 : -1;
 }
 
 int elfImageRead(struct elfImage * restrict image, const char * restrict path)
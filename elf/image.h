@@ -18,6 +18,7 @@
 #ifndef ELF_IMAGE_H
 #define ELF_IMAGE_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include "info.h"
 
@@ -42,11 +43,25 @@ struct elfImageImp {
 	const struct elfImp *btm;
 };
 
-int elfImageFindInfo(const struct elfImage * restrict image,
-		     const SceKernelModuleInfo * restrict kernelInfo,
-		     Elf32_Addr * restrict infoVaddr,
-		     struct elfImageExp * restrict exp,
-		     struct elfImageImp * restrict imp);
+/* A module located in the image. */
+struct elfImageModule {
+	const char *name;
+
+	/* The address of the segment containing SceModuleInfo, which offsets
+	   in it are relative to. */
+	Elf32_Addr base;
+
+	struct elfImageModuleInfo info;
+	struct elfImageExp exp;
+	struct elfImageImp imp;
+	bool found;
+};
+
+/* Locates SceModuleInfo of each module in all loadable segments. It fails
+   only if none is found. */
+int elfImageFindInfos(const struct elfImage * restrict image,
+		      const SceKernelModuleInfo * const * restrict kernelInfos,
+		      Elf32_Word n, struct elfImageModule * restrict modules);
 
 int elfImageRead(struct elfImage * restrict image, const char * restrict path);
 
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../noisy/lib.h"
+#include "elf.h"
+#include "index.h"
+#include "lookup.h"
+
+/* Stores distinct addresses of the lookup at k and its subtrees by an
+   in-order walk, and returns the next symbol of the lookup to store. */
+static Elf32_Word fill(struct elfIndex * restrict index,
+		       const struct elfLookup * restrict lookup,
+		       Elf32_Word sym, Elf32_Word k)
+{
+	if (k > index->n)
+		return sym;
+
+	sym = fill(index, lookup, sym, 2 * k);
+
+	index->keys[k] = lookup->syms[sym].value;
+	index->syms[k] = sym;
+
+	/* Symbols at the same address are sorted by size, so the first one
+	   of them is the best. */
+	do
+		sym++;
+	while (sym < lookup->n
+	       && lookup->syms[sym].value == lookup->syms[sym - 1].value);
+
+	return fill(index, lookup, sym, 2 * k + 1);
+}
+
+int elfIndexInit(struct elfIndex * restrict index,
+		 const struct elfLookup * restrict lookup)
+{
+	index->n = 0;
+	for (Elf32_Word ndx = 0; ndx < lookup->n; ndx++)
+		if (ndx <= 0
+		    || lookup->syms[ndx].value != lookup->syms[ndx - 1].value)
+			index->n++;
+
+	/* Keeps 2 * k + 1 in int for __builtin_ffs. */
+	if (index->n > INT32_MAX / 2 - 1) {
+		fputs("too many symbols\n", stderr);
+		return -1;
+	}
+
+	index->keys = noisyMalloc((index->n + 1) * sizeof(*index->keys));
+	if (index->keys == NULL)
+		return -1;
+
+	index->syms = noisyMalloc((index->n + 1) * sizeof(*index->syms));
+	if (index->syms == NULL) {
+		free(index->keys);
+		return -1;
+	}
+
+	index->keys[0] = 0;
+	index->syms[0] = UINT32_MAX;
+	fill(index, lookup, 0, 1);
+	return 0;
+}
+
+void elfIndexDeinit(const struct elfIndex * restrict index)
+{
+	free(index->keys);
+	free(index->syms);
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ELF_INDEX_H
+#define ELF_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "elf.h"
+#include "lookup.h"
+
+/* Addresses of symbols of a lookup in Eytzinger order, which keeps the top
+   of the implicit search tree in a few cache lines. It is never written
+   after elfIndexInit, so any number of threads may search it. */
+struct elfIndex {
+	/* From 1; the first of them is unused. */
+	Elf32_Addr *keys;
+
+	/* The index in the lookup of the best symbol at each key. */
+	Elf32_Word *syms;
+
+	Elf32_Word n;
+};
+
+int elfIndexInit(struct elfIndex * restrict index,
+		 const struct elfLookup * restrict lookup);
+
+/* Returns the index in the lookup of the symbol at or before vaddr nearest
+   to it, or UINT32_MAX if there is none. The search has no branches but the
+   loop, which runs as many times for any address. */
+static inline Elf32_Word elfIndexFind(const struct elfIndex * restrict index,
+				      Elf32_Addr vaddr)
+{
+	Elf32_Word k = 1;
+
+	while (k <= index->n) {
+#ifdef __GNUC__
+		/* The descendants four levels below share a cache line. */
+		__builtin_prefetch(index->keys
+				   + (k <= index->n / 16 ? k * 16 : 0));
+#endif
+		k = 2 * k + (index->keys[k] <= vaddr);
+	}
+
+	/* Going back to the last right turn gives the greatest key not above
+	   vaddr. */
+#ifdef __GNUC__
+	k >>= __builtin_ffs(k);
+#else
+	while ((k & 1) == 0)
+		k >>= 1;
+
+	k >>= 1;
+#endif
+	return k > 0 ? index->syms[k] : UINT32_MAX;
+}
+
+/* Returns the symbol containing vaddr, or the nearest one before it if its
+   size is unknown, as elfLookupFind does. Returns NULL if there is none. */
+static inline const struct elfLookupSym *elfIndexFindSym(
+	const struct elfIndex * restrict index,
+	const struct elfLookup * restrict lookup, Elf32_Addr vaddr)
+{
+	const Elf32_Word ndx = elfIndexFind(index, vaddr);
+	if (ndx == UINT32_MAX)
+		return NULL;
+
+	const struct elfLookupSym * const sym = lookup->syms + ndx;
+	return sym->size <= 0 || vaddr - sym->value < sym->size ? sym : NULL;
+}
+
+void elfIndexDeinit(const struct elfIndex * restrict index);
+
+#endif
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../noisy/lib.h"
+#include "driver.h"
+#include "elf.h"
+#include "lookup.h"
+
+static int compareSyms(const void *a, const void *b)
+{
+	const struct elfLookupSym * const x = a;
+	const struct elfLookupSym * const y = b;
+
+	if (x->value != y->value)
+		return x->value < y->value ? -1 : 1;
+
+	/* Prefer sized symbols at the same address. */
+	return x->size > y->size ? -1 : x->size < y->size;
+}
+
+int elfLookupInit(struct elfLookup * restrict lookup,
+		  const Elf32_Sym * restrict syms, Elf32_Word nSyms,
+		  const char * restrict strtab, Elf32_Word strtabSize)
+{
+	lookup->n = 0;
+	lookup->syms = noisyMalloc(nSyms * sizeof(*lookup->syms));
+	if (lookup->syms == NULL)
+		return -1;
+
+	for (Elf32_Word ndx = 0; ndx < nSyms; ndx++) {
+		const int type = ELF32_ST_TYPE(syms[ndx].st_info);
+
+		if ((type != STT_FUNC && type != STT_ARM_TFUNC
+		     && type != STT_OBJECT)
+		    || syms[ndx].st_shndx == SHN_UNDEF
+		    || syms[ndx].st_name >= strtabSize
+		    || memchr(strtab + syms[ndx].st_name, 0,
+			      strtabSize - syms[ndx].st_name) == NULL)
+			continue;
+
+		struct elfLookupSym * const sym = lookup->syms + lookup->n;
+
+		sym->value = syms[ndx].st_value;
+		if (type != STT_OBJECT)
+			sym->value &= ~(Elf32_Addr)1;
+
+		sym->size = syms[ndx].st_size;
+		sym->name = strtab + syms[ndx].st_name;
+		sym->ndx = ndx;
+		sym->info = syms[ndx].st_info;
+		lookup->n++;
+	}
+
+	qsort(lookup->syms, lookup->n, sizeof(*lookup->syms), compareSyms);
+	return 0;
+}
+
+int elfLookupInitElf(struct elfLookup * restrict lookup,
+		     const struct elf * restrict context)
+{
+	for (Elf32_Word ndx = 0; ndx < context->shnum; ndx++) {
+		const Elf32_Shdr * const shdr = context->shdrs + ndx;
+
+		if (shdr->sh_type == SHT_SYMTAB)
+			return elfLookupInit(
+				lookup, context->sections[ndx],
+				shdr->sh_size / sizeof(Elf32_Sym),
+				context->sections[shdr->sh_link],
+				context->shdrs[shdr->sh_link].sh_size);
+	}
+
+	return -1;
+}
+
+const struct elfLookupSym *elfLookupFind(
+	const struct elfLookup * restrict lookup, Elf32_Addr vaddr)
+{
+	Elf32_Word lo = 0;
+	Elf32_Word hi = lookup->n;
+
+	/* The number of symbols at or before vaddr. */
+	while (lo < hi) {
+		const Elf32_Word mid = lo + (hi - lo) / 2;
+
+		if (lookup->syms[mid].value <= vaddr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo <= 0)
+		return NULL;
+
+	/* Symbols at the same address are sorted by size, so the first one
+	   of them is the best. */
+	const struct elfLookupSym *sym = lookup->syms + lo - 1;
+	while (sym != lookup->syms && sym[-1].value == sym->value)
+		sym--;
+
+	return sym->size <= 0 || vaddr - sym->value < sym->size ? sym : NULL;
+}
+
+void elfLookupDeinit(const struct elfLookup * restrict lookup)
+{
+	free(lookup->syms);
+}
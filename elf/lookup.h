@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ELF_LOOKUP_H
+#define ELF_LOOKUP_H
+
+#include "driver.h"
+#include "elf.h"
+
+struct elfLookupSym {
+	Elf32_Addr value;
+	Elf32_Word size;
+	const char *name;
+
+	/* The index in the symbol table and st_info. */
+	Elf32_Word ndx;
+	unsigned char info;
+};
+
+/* Symbols with addresses, sorted by them. */
+struct elfLookup {
+	struct elfLookupSym *syms;
+	Elf32_Word n;
+};
+
+/* Takes functions and objects of a symbol table. The names refer to strtab,
+   which must be kept alive. */
+int elfLookupInit(struct elfLookup * restrict lookup,
+		  const Elf32_Sym * restrict syms, Elf32_Word nSyms,
+		  const char * restrict strtab, Elf32_Word strtabSize);
+
+/* Takes .symtab which elfMakeSections made. */
+int elfLookupInitElf(struct elfLookup * restrict lookup,
+		     const struct elf * restrict context);
+
+/* Returns the symbol containing vaddr, or the nearest one before it if its
+   size is unknown. Returns NULL if there is none. */
+const struct elfLookupSym *elfLookupFind(
+	const struct elfLookup * restrict lookup, Elf32_Addr vaddr);
+
+void elfLookupDeinit(const struct elfLookup * restrict lookup);
+
+#endif
@@ -0,0 +1,372 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../noisy/lib.h"
+#include "../pool.h"
+#include "branch.h"
+#include "elf.h"
+#include "port.h"
+
+/* Functions taken from the pool at once. */
+#define PORT_CHUNK 256
+
+/* Functions with fewer instructions are too common to tell. */
+#define PORT_INSNS_MIN 6
+
+/* Bands of MinHash values, each of which puts a function in a bucket. */
+#define PORT_BANDS 8
+#define PORT_ROWS (ELF_PORT_HASHES / PORT_BANDS)
+
+/* Larger buckets are full of trivial functions and skipped. */
+#define PORT_BUCKET_MAX 64
+
+struct portBucket {
+	uint64_t key;
+	uint32_t ndx;
+};
+
+struct portIndex {
+	struct portBucket *buckets;
+	size_t n;
+};
+
+/* The most similar function of the other dump. */
+struct portBest {
+	size_t ndx;
+	unsigned int score;
+	bool ambiguous;
+};
+
+struct portQuery {
+	const struct elfPortFunc *funcs;
+	const struct elfPortFunc *others;
+	const struct portIndex *index;
+	struct portBest *best;
+};
+
+/* The finalizer of SplitMix64. */
+static uint64_t mix(uint64_t x)
+{
+	x ^= x >> 30;
+	x *= UINT64_C(0xBF58476D1CE4E5B9);
+	x ^= x >> 27;
+	x *= UINT64_C(0x94D049BB133111EB);
+	return x ^ (x >> 31);
+}
+
+/* Lowers the MinHash values with a feature. The values are derived from two
+   halves of one hash, so that the loop vectorizes. */
+static void addFeature(uint32_t * restrict hashes, uint64_t feature)
+{
+	const uint64_t hash = mix(feature);
+	const uint32_t low = (uint32_t)hash;
+	const uint32_t high = (uint32_t)(hash >> 32) | 1;
+
+	for (uint32_t ndx = 0; ndx < ELF_PORT_HASHES; ndx++) {
+		const uint32_t value = low + ndx * high;
+
+		hashes[ndx] = value < hashes[ndx] ? value : hashes[ndx];
+	}
+}
+
+/* Returns the opcode of an instruction with registers and immediates dropped
+   as far as the encoding allows, or the kind of a branch. */
+static uint32_t tokenize(const struct elfPortFunc * restrict func,
+			 uint16_t first, uint16_t second, Elf32_Addr vaddr,
+			 const struct elfBranchInsn * restrict insn)
+{
+	switch (insn->kind) {
+	case ELF_BRANCH_NONE:
+		if (insn->size > 2)
+			return 0x20000 | (uint32_t)(first >> 4) << 1
+			       | second >> 15;
+
+		/* Data processing and miscellaneous instructions have their
+		   opcodes below the top five bits. */
+		return (first & 0xF800) == 0x4000 || (first & 0xF000) == 0xB000 ?
+		       (uint32_t)first >> 8 : (uint32_t)first >> 11;
+
+	case ELF_BRANCH_B:
+		return insn->target - func->vaddr < func->size ?
+		       0x10010 : 0x10011;
+
+	case ELF_BRANCH_COND:
+		return insn->target > vaddr ? 0x10020 : 0x10021;
+
+	default:
+		return 0x10000 | insn->kind;
+	}
+}
+
+static void hashFunc(void *context, size_t ndx)
+{
+	struct elfPortFunc * const func = (struct elfPortFunc *)context + ndx;
+	uint64_t trigram = 0;
+	uint64_t insns = 0;
+	uint64_t calls = 0;
+	uint64_t conds = 0;
+	uint64_t exits = 0;
+	Elf32_Word offset = 0;
+
+	for (uint32_t hash = 0; hash < ELF_PORT_HASHES; hash++)
+		func->hashes[hash] = UINT32_MAX;
+
+	while (func->size - offset >= 2) {
+		struct elfBranchInsn insn;
+		const unsigned char * const bytes = func->bytes + offset;
+		const Elf32_Addr vaddr = func->vaddr + offset;
+		const uint16_t first = bytes[0] | bytes[1] << 8;
+		const uint16_t second = func->size - offset >= 4 ?
+			bytes[2] | bytes[3] << 8 : 0;
+
+		elfBranchDecodeThumb(first, second, vaddr, &insn);
+		if (insn.size > func->size - offset)
+			break;
+
+		trigram = (trigram << 21 | tokenize(func, first, second, vaddr,
+						     &insn))
+			  & ((UINT64_C(1) << 63) - 1);
+		insns++;
+		if (insns >= 3)
+			addFeature(func->hashes, trigram);
+
+		calls += insn.kind == ELF_BRANCH_BL
+			 || insn.kind == ELF_BRANCH_BLX;
+		conds += insn.kind == ELF_BRANCH_COND;
+		exits += insn.kind == ELF_BRANCH_RETURN;
+		offset += insn.size;
+	}
+
+	func->hashed = insns >= PORT_INSNS_MIN;
+	if (!func->hashed)
+		return;
+
+	/* The shape of the function; the top bit keeps it apart from
+	   trigrams. */
+	uint64_t scale = 0;
+	while ((insns >> scale) > 1)
+		scale++;
+
+	addFeature(func->hashes, UINT64_C(1) << 63
+				 | (calls < 0xFFFF ? calls : 0xFFFF)
+				 | (conds < 0xFFFF ? conds : 0xFFFF) << 16
+				 | (exits < 0xFFFF ? exits : 0xFFFF) << 32
+				 | scale << 48);
+}
+
+void elfPortHash(struct elfPortFunc * restrict funcs, size_t n)
+{
+	poolRun(n, PORT_CHUNK, hashFunc, funcs);
+}
+
+static uint64_t bandKey(const struct elfPortFunc * restrict func,
+			unsigned int band)
+{
+	uint64_t key = band;
+
+	for (unsigned int row = 0; row < PORT_ROWS; row++)
+		key = mix(key ^ (uint64_t)func->hashes[band * PORT_ROWS + row]
+				<< 8);
+
+	return key;
+}
+
+static int compareBuckets(const void *a, const void *b)
+{
+	const struct portBucket * const x = a;
+	const struct portBucket * const y = b;
+
+	if (x->key != y->key)
+		return x->key < y->key ? -1 : 1;
+
+	return x->ndx < y->ndx ? -1 : x->ndx > y->ndx;
+}
+
+static int indexInit(struct portIndex * restrict index,
+		     const struct elfPortFunc * restrict funcs, size_t n)
+{
+	index->buckets = noisyMalloc(n * PORT_BANDS * sizeof(*index->buckets)
+				     + 1);
+	if (index->buckets == NULL)
+		return -1;
+
+	index->n = 0;
+	for (size_t ndx = 0; ndx < n; ndx++) {
+		if (!funcs[ndx].hashed)
+			continue;
+
+		for (unsigned int band = 0; band < PORT_BANDS; band++) {
+			index->buckets[index->n].key = bandKey(funcs + ndx,
+							       band);
+			index->buckets[index->n].ndx = ndx;
+			index->n++;
+		}
+	}
+
+	if (index->n > 0)
+		qsort(index->buckets, index->n, sizeof(*index->buckets),
+		      compareBuckets);
+
+	return 0;
+}
+
+static unsigned int compareHashes(const struct elfPortFunc * restrict a,
+				  const struct elfPortFunc * restrict b)
+{
+	unsigned int equal = 0;
+
+	for (uint32_t ndx = 0; ndx < ELF_PORT_HASHES; ndx++)
+		equal += a->hashes[ndx] == b->hashes[ndx];
+
+	return equal;
+}
+
+static void query(void *context, size_t ndx)
+{
+	const struct portQuery * const q = context;
+	const struct elfPortFunc * const func = q->funcs + ndx;
+	struct portBest * const best = q->best + ndx;
+
+	best->ndx = SIZE_MAX;
+	best->score = 0;
+	best->ambiguous = false;
+
+	if (!func->hashed)
+		return;
+
+	for (unsigned int band = 0; band < PORT_BANDS; band++) {
+		const uint64_t key = bandKey(func, band);
+		size_t first = 0;
+		size_t last = q->index->n;
+
+		while (first < last) {
+			const size_t mid = first + (last - first) / 2;
+
+			if (q->index->buckets[mid].key < key)
+				first = mid + 1;
+			else
+				last = mid;
+		}
+
+		for (last = first;
+		     last < q->index->n && q->index->buckets[last].key == key;
+		     last++);
+
+		if (last - first > PORT_BUCKET_MAX)
+			continue;
+
+		for (size_t bucket = first; bucket < last; bucket++) {
+			const size_t other = q->index->buckets[bucket].ndx;
+			const struct elfPortFunc * const candidate
+				= q->others + other;
+			const Elf32_Word larger = candidate->size > func->size ?
+				candidate->size : func->size;
+			const Elf32_Word smaller = candidate->size > func->size ?
+				func->size : candidate->size;
+
+			/* Sizes within a factor of two. */
+			if (smaller < larger / 2)
+				continue;
+
+			const unsigned int score = compareHashes(func,
+								 candidate);
+			if (score > best->score) {
+				best->ndx = other;
+				best->score = score;
+				best->ambiguous = false;
+			} else if (score == best->score && other != best->ndx
+				   && strcmp(candidate->name,
+					     q->others[best->ndx].name) != 0) {
+				best->ambiguous = true;
+			}
+		}
+	}
+}
+
+static int findBest(struct portBest ** restrict best,
+		    const struct elfPortFunc * restrict funcs, size_t n,
+		    const struct elfPortFunc * restrict others, size_t nOthers)
+{
+	struct portIndex index;
+
+	*best = noisyMalloc(n * sizeof(**best) + 1);
+	if (*best == NULL)
+		return -1;
+
+	if (indexInit(&index, others, nOthers) != 0) {
+		free(*best);
+		return -1;
+	}
+
+	struct portQuery q = { funcs, others, &index, *best };
+	poolRun(n, PORT_CHUNK, query, &q);
+
+	free(index.buckets);
+	return 0;
+}
+
+int elfPortMatch(const struct elfPortFunc * restrict olds, size_t nOlds,
+		 const struct elfPortFunc * restrict news, size_t nNews,
+		 double threshold, struct elfPortName ** restrict names,
+		 size_t * restrict nNames)
+{
+	struct portBest *oldBest;
+	struct portBest *newBest;
+	int result = -1;
+
+	if (findBest(&oldBest, olds, nOlds, news, nNews) != 0)
+		goto failOld;
+
+	if (findBest(&newBest, news, nNews, olds, nOlds) != 0)
+		goto failNew;
+
+	*names = noisyMalloc(nNews * sizeof(**names) + 1);
+	if (*names == NULL)
+		goto failNames;
+
+	*nNames = 0;
+	for (size_t ndx = 0; ndx < nNews; ndx++) {
+		const struct portBest * const best = newBest + ndx;
+
+		if (best->ndx == SIZE_MAX || best->ambiguous
+		    || best->score < threshold * ELF_PORT_HASHES
+		    || oldBest[best->ndx].ndx != ndx
+		    || oldBest[best->ndx].ambiguous)
+			continue;
+
+		(*names)[*nNames].vaddr = news[ndx].vaddr;
+		(*names)[*nNames].name = olds[best->ndx].name;
+		(*names)[*nNames].score = (double)best->score
+					  / ELF_PORT_HASHES;
+		(*nNames)++;
+	}
+
+	result = 0;
+
+failNames:
+	free(newBest);
+failNew:
+	free(oldBest);
+failOld:
+	return result;
+}
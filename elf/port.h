@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ELF_PORT_H
+#define ELF_PORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "elf.h"
+
+/* The number of MinHash values of a function. */
+#define ELF_PORT_HASHES 32
+
+/* The default fraction of MinHash values which must be equal. */
+#define ELF_PORT_THRESHOLD 0.75
+
+/* A Thumb function of either dump. */
+struct elfPortFunc {
+	const char *name;
+	const unsigned char *bytes;
+	Elf32_Addr vaddr;
+	Elf32_Word size;
+
+	/* Set by elfPortHash, unless the function is too short to tell. */
+	bool hashed;
+	uint32_t hashes[ELF_PORT_HASHES];
+};
+
+/* A name ported to a function of the new dump. */
+struct elfPortName {
+	Elf32_Addr vaddr;
+	const char *name;
+
+	/* The fraction of MinHash values which are equal. */
+	double score;
+};
+
+/* Hashes the trigrams of instructions of functions, with registers and
+   immediates dropped and branches told by kind and direction, and the
+   numbers of calls, conditional branches and returns, on all
+   processors. */
+void elfPortHash(struct elfPortFunc * restrict funcs, size_t n);
+
+/* Names functions of the new dump after those of the old dump which are
+   similar enough, and each the most similar to the other. Candidates are
+   found with locality-sensitive hashing of bands of MinHash values. Names
+   are sorted as the new functions are and refer to the names of the old
+   functions. */
+int elfPortMatch(const struct elfPortFunc * restrict olds, size_t nOlds,
+		 const struct elfPortFunc * restrict news, size_t nNews,
+		 double threshold, struct elfPortName ** restrict names,
+		 size_t * restrict nNames);
+
+#endif
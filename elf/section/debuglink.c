@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../crc32.h"
+#include "../../noisy/lib.h"
+#include "../elf.h"
+#include "../image.h"
+#include "debuglink.h"
+
+int elfSectionDebuglinkMake(const struct elfImage * restrict image,
+			    Elf32_Word name, Elf32_Off offset,
+			    Elf32_Shdr * restrict shdr,
+			    void ** restrict buffer)
+{
+	const char * const slash = strrchr(image->path, '/');
+	const char * const file = slash == NULL ? image->path : slash + 1;
+	const size_t length = strlen(file);
+
+	/* The name is followed by zero to three bytes of padding and the CRC
+	   aligned to 4 bytes. */
+	const size_t crcOffset = (length + 4) & ~(size_t)3;
+	const size_t size = crcOffset + sizeof(uint32_t);
+
+	if (size > 0xFFFFFFFF)
+		return -1;
+
+	char * const link = noisyMalloc(size);
+	if (link == NULL)
+		return -1;
+
+	memcpy(link, file, length);
+	memset(link + length, 0, crcOffset - length);
+
+	/* ELFDATA2LSB is checked by elfImageValidate. */
+	const uint32_t crc = crc32(image->buffer, image->size);
+	for (int ndx = 0; ndx < 4; ndx++)
+		link[crcOffset + ndx] = crc >> (ndx * 8);
+
+	const Elf32_Off mod = offset % 4;
+	if (mod)
+		offset += 4 - mod;
+
+	shdr->sh_name = name;
+	shdr->sh_type = SHT_PROGBITS;
+	shdr->sh_flags = 0;
+	shdr->sh_addr = 0;
+	shdr->sh_offset = offset;
+	shdr->sh_size = size;
+	shdr->sh_link = 0;
+	shdr->sh_info = 0;
+	shdr->sh_addralign = 4;
+	shdr->sh_entsize = 0;
+	*buffer = link;
+
+	return 0;
+}
@@ -0,0 +1,353 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../noisy/lib.h"
+#include "../elf.h"
+#include "../image.h"
+#include "rel.h"
+
+/* The number of words examined at once, i.e. twice as many halfwords. */
+#define REL_BLOCK 16
+
+/* Loadable segments are marked in the filter in units of 1 << REL_CHUNK. */
+#define REL_CHUNK 16
+
+/* How far MOVT may follow MOVW of the same register. */
+#define REL_PAIR_MAX 32
+
+struct relRange {
+	Elf32_Addr top;
+	Elf32_Addr btm;
+};
+
+struct relScan {
+	uint64_t filter[(1 << (32 - REL_CHUNK)) / 64];
+	struct relRange *ranges;
+	Elf32_Word nRanges;
+	Elf32_Rel *rels;
+	size_t n;
+	size_t capacity;
+
+	/* The last MOVW of each register; site is 0 if there is none. */
+	struct {
+		Elf32_Addr site;
+		uint32_t imm;
+	} movws[16];
+};
+
+static int compareRanges(const void *a, const void *b)
+{
+	const struct relRange * const x = a;
+	const struct relRange * const y = b;
+
+	return x->top < y->top ? -1 : x->top > y->top;
+}
+
+static int compareRels(const void *a, const void *b)
+{
+	const Elf32_Rel * const x = a;
+	const Elf32_Rel * const y = b;
+
+	return x->r_offset < y->r_offset ? -1 : x->r_offset > y->r_offset;
+}
+
+static uint64_t isMarked(const struct relScan * restrict scan,
+			 uint32_t value)
+{
+	const uint32_t chunk = value >> REL_CHUNK;
+
+	return (scan->filter[chunk / 64] >> chunk % 64) & 1;
+}
+
+static bool isInLoad(const struct relScan * restrict scan, uint32_t value)
+{
+	Elf32_Word lo = 0;
+	Elf32_Word hi = scan->nRanges;
+
+	if (!isMarked(scan, value))
+		return false;
+
+	/* The number of ranges beginning at or before value. */
+	while (lo < hi) {
+		const Elf32_Word mid = lo + (hi - lo) / 2;
+
+		if (scan->ranges[mid].top <= value)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo > 0 && value < scan->ranges[lo - 1].btm;
+}
+
+static int initRanges(struct relScan * restrict scan,
+		      const struct elfImage * restrict image)
+{
+	const Elf32_Ehdr * const ehdr = image->buffer;
+	const Elf32_Phdr * const phdrs
+		= elfImageOffToPtr(image, ehdr->e_phoff);
+
+	memset(scan->filter, 0, sizeof(scan->filter));
+	scan->nRanges = 0;
+	scan->ranges = noisyMalloc(ehdr->e_phnum * sizeof(*scan->ranges) + 1);
+	if (scan->ranges == NULL)
+		return -1;
+
+	for (Elf32_Half ndx = 0; ndx < ehdr->e_phnum; ndx++) {
+		const Elf32_Phdr * const phdr = phdrs + ndx;
+
+		if (phdr->p_type != PT_LOAD || phdr->p_memsz <= 0
+		    || phdr->p_memsz > UINT32_MAX - phdr->p_vaddr)
+			continue;
+
+		scan->ranges[scan->nRanges].top = phdr->p_vaddr;
+		scan->ranges[scan->nRanges].btm = phdr->p_vaddr
+						  + phdr->p_memsz;
+		scan->nRanges++;
+
+		for (uint32_t chunk = phdr->p_vaddr >> REL_CHUNK;
+		     chunk <= (phdr->p_vaddr + phdr->p_memsz - 1) >> REL_CHUNK;
+		     chunk++)
+			scan->filter[chunk / 64] |= UINT64_C(1) << chunk % 64;
+	}
+
+	qsort(scan->ranges, scan->nRanges, sizeof(*scan->ranges),
+	      compareRanges);
+	return 0;
+}
+
+static int addRel(struct relScan * restrict scan, Elf32_Addr site,
+		  unsigned int type)
+{
+	if (scan->n >= scan->capacity) {
+		const size_t capacity = scan->capacity <= 0 ?
+			1024 : scan->capacity * 2;
+		Elf32_Rel * const rels = noisyRealloc(
+			scan->rels, capacity * sizeof(*rels));
+		if (rels == NULL)
+			return -1;
+
+		scan->rels = rels;
+		scan->capacity = capacity;
+	}
+
+	scan->rels[scan->n].r_offset = site;
+	scan->rels[scan->n].r_info = ELF32_R_INFO(0, type);
+	scan->n++;
+	return 0;
+}
+
+/* Handles a 32-bit Thumb MOVW or MOVT, pairing it with the last MOVW of
+   the same register. */
+static int takeMov(struct relScan * restrict scan, Elf32_Addr site,
+		   uint16_t first, uint16_t second)
+{
+	const unsigned int rd = (second >> 8) & 0xF;
+	const uint32_t imm = ((first & 0xFu) << 12) | ((first & 0x400u) << 1)
+			     | ((second & 0x7000u) >> 4) | (second & 0xFFu);
+
+	if ((first & 0x0080) == 0) {
+		scan->movws[rd].site = site;
+		scan->movws[rd].imm = imm;
+		return 0;
+	}
+
+	const Elf32_Addr movw = scan->movws[rd].site;
+	if (movw == 0 || site - movw > REL_PAIR_MAX
+	    || !isInLoad(scan, (imm << 16) | scan->movws[rd].imm))
+		return 0;
+
+	scan->movws[rd].site = 0;
+
+	if (addRel(scan, movw, R_ARM_MOVW_ABS_NC) != 0
+	    || addRel(scan, site, R_ARM_MOVT_ABS) != 0)
+		return -1;
+
+	return 0;
+}
+
+/* Returns masks of halfwords which may begin MOVW or MOVT and of words
+   which may be addresses. It has no branches so that compilers vectorize
+   it. */
+static void prefilter(const struct relScan * restrict scan,
+		      const unsigned char * restrict bytes,
+		      uint32_t * restrict movs, uint32_t * restrict words)
+{
+	uint16_t halves[2 * REL_BLOCK + 1];
+	uint32_t values[REL_BLOCK];
+	uint32_t movMask = 0;
+	uint32_t wordMask = 0;
+
+	memcpy(halves, bytes, sizeof(halves));
+	memcpy(values, bytes, sizeof(values));
+
+	for (int ndx = 0; ndx < 2 * REL_BLOCK; ndx++)
+		movMask |= (uint32_t)((halves[ndx] & 0xFB70) == 0xF240
+				      && (halves[ndx + 1] & 0x8000) == 0)
+			   << ndx;
+
+	for (int ndx = 0; ndx < REL_BLOCK; ndx++)
+		wordMask |= (uint32_t)isMarked(scan, values[ndx]) << ndx;
+
+	*movs = movMask;
+	*words = wordMask;
+}
+
+/* Scans a segment whose vaddr is aligned to words. */
+static int scanSegment(struct relScan * restrict scan,
+		       const unsigned char * restrict bytes, Elf32_Word size,
+		       Elf32_Addr vaddr)
+{
+	const Elf32_Word blockSize = REL_BLOCK * sizeof(uint32_t);
+
+	memset(scan->movws, 0, sizeof(scan->movws));
+
+	for (Elf32_Word offset = 0;
+	     offset < size && size - offset >= sizeof(uint32_t);
+	     offset += blockSize) {
+		uint32_t movs;
+		uint32_t words;
+
+		/* The last halfword is needed to decode the last MOVW. */
+		if (size - offset >= blockSize + sizeof(uint16_t)) {
+			prefilter(scan, bytes + offset, &movs, &words);
+		} else {
+			const Elf32_Word rest = size - offset;
+
+			movs = rest >= 2 * sizeof(uint16_t) ?
+				(UINT32_C(1) << (rest / sizeof(uint16_t) - 1))
+				- 1 : 0;
+			words = (UINT32_C(1) << rest / sizeof(uint32_t)) - 1;
+		}
+
+		for (unsigned int ndx = 0; movs != 0 || words != 0; ndx++) {
+			const Elf32_Word position = offset
+						    + ndx * sizeof(uint16_t);
+
+			if ((movs & 1) != 0) {
+				uint16_t halves[2];
+
+				memcpy(halves, bytes + position,
+				       sizeof(halves));
+				if ((halves[0] & 0xFB70) == 0xF240
+				    && (halves[1] & 0x8000) == 0
+				    && takeMov(scan, vaddr + position,
+					       halves[0], halves[1]) != 0)
+					return -1;
+			}
+
+			if (ndx % 2 == 0 && (words & 1) != 0) {
+				uint32_t value;
+
+				memcpy(&value, bytes + position,
+				       sizeof(value));
+				if (isInLoad(scan, value)
+				    && addRel(scan, vaddr + position,
+					      R_ARM_ABS32) != 0)
+					return -1;
+			}
+
+			movs >>= 1;
+			if (ndx % 2 != 0)
+				words >>= 1;
+		}
+	}
+
+	return 0;
+}
+
+int elfSectionRelMake(const struct elfImage * restrict image,
+		      Elf32_Word name, Elf32_Word symtabNdx, Elf32_Off offset,
+		      Elf32_Shdr * restrict shdr, void ** restrict buffer)
+{
+	const Elf32_Ehdr * const ehdr = image->buffer;
+	const Elf32_Phdr * const phdrs
+		= elfImageOffToPtr(image, ehdr->e_phoff);
+
+	struct relScan * const scan = noisyMalloc(sizeof(*scan));
+	if (scan == NULL)
+		return -1;
+
+	scan->rels = NULL;
+	scan->n = 0;
+	scan->capacity = 0;
+
+	if (initRanges(scan, image) != 0)
+		goto failRanges;
+
+	for (Elf32_Half ndx = 0; ndx < ehdr->e_phnum; ndx++) {
+		const Elf32_Phdr * const phdr = phdrs + ndx;
+
+		if (phdr->p_type != PT_LOAD || (phdr->p_flags & PF_X) == 0)
+			continue;
+
+		/* Literal words are aligned in memory. */
+		const Elf32_Word skew = -phdr->p_vaddr & 3;
+		if (phdr->p_filesz > skew
+		    && scanSegment(scan, elfImageOffToPtr(
+					   image, phdr->p_offset + skew),
+				   phdr->p_filesz - skew,
+				   phdr->p_vaddr + skew) != 0)
+			goto failScan;
+	}
+
+	if (scan->n > UINT32_MAX / sizeof(Elf32_Rel)) {
+		fprintf(stderr, "%s: too many relocations\n", image->path);
+		goto failScan;
+	}
+
+	if (scan->n > 0)
+		qsort(scan->rels, scan->n, sizeof(*scan->rels), compareRels);
+
+	shdr->sh_name = name;
+	shdr->sh_type = SHT_REL;
+	shdr->sh_flags = 0;
+	shdr->sh_addr = 0;
+	shdr->sh_size = scan->n * sizeof(Elf32_Rel);
+	shdr->sh_link = symtabNdx;
+	shdr->sh_info = 0;
+	shdr->sh_addralign = 4;
+	shdr->sh_entsize = sizeof(Elf32_Rel);
+
+	const Elf32_Off mod = offset % shdr->sh_addralign;
+	if (mod)
+		offset += shdr->sh_addralign - mod;
+
+	shdr->sh_offset = offset;
+
+	/* An empty section still needs a buffer to be written. */
+	*buffer = scan->rels != NULL ? (void *)scan->rels : noisyMalloc(1);
+	if (*buffer == NULL)
+		goto failScan;
+
+	free(scan->ranges);
+	free(scan);
+	return 0;
+
+failScan:
+	free(scan->rels);
+	free(scan->ranges);
+failRanges:
+	free(scan);
+	return -1;
+}
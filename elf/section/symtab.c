@@ -20,12 +20,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "../../nid/overlay.h"
+#include "../../nid/set.h"
+#include "../../nid/table.h"
 #include "../../noisy/lib.h"
 #include "../../vita-import/helper.h"
 #include "../../vita-import/vita-import.h"
 #include "../../overflow.h"
 #include "../driver.h"
 #include "../elf.h"
+#include "../exidx.h"
+#include "../funcs.h"
+#include "../sig.h"
 #include "symtab.h"
 
 static int guessSttFunc(Elf32_Addr vaddr)
@@ -91,6 +97,29 @@ failOverflow:
 	return -1;
 }
 
+/* Names a NID the database doesn't know, with the overlay, the NID table or
+   a placeholder. */
+static int placeholderAdd(struct elfSectionSymtabNids * restrict nidNames,
+			  Elf32_Word * restrict ndx,
+			  struct elfSectionStrtab * restrict strtab,
+			  const char * restrict name, Elf32_Word nameSize,
+			  Elf32_Word nid)
+{
+	const char *known = nidOverlayFind(nidNames->overlay, nid);
+	if (known == NULL)
+		known = nidTableFind(nidNames->table, nid);
+
+	if (known != NULL)
+		return elfSectionStrtabAdd(ndx, strtab, strlen(known) + 1,
+					   "%s", known);
+
+	if (nidSetAdd(nidNames->unresolved, nid) != 0)
+		return -1;
+
+	return elfSectionStrtabAdd(ndx, strtab, nameSize + 9,
+				   "%s_%08X", name, nid);
+}
+
 static int notypeSymMake(Elf32_Sym * restrict sym,
 			  struct elfSectionStrtab * restrict strtab)
 {
@@ -108,8 +137,9 @@ static int notypeSymMake(Elf32_Sym * restrict sym,
 	return 0;
 }
 
-static int infoSymMake(Elf32_Addr vaddr, Elf32_Sym * restrict sym,
-			     struct elfSectionStrtab * restrict strtab)
+static int infoSymMake(const struct elfImage * restrict image,
+		       Elf32_Addr vaddr, Elf32_Sym * restrict sym,
+		       struct elfSectionStrtab * restrict strtab)
 {
 	const int result = elfSectionStrtabAdd(
 		&sym->st_name, strtab, sizeof("module_info"), "module_info");
@@ -120,15 +150,21 @@ static int infoSymMake(Elf32_Addr vaddr, Elf32_Sym * restrict sym,
 	sym->st_size = sizeof(SceModuleInfo);
 	sym->st_info = ELF32_ST_INFO(STB_GLOBAL, STT_OBJECT);
 	sym->st_other = ELF32_ST_VISIBILITY(STV_DEFAULT);
-	sym->st_shndx = ELF_LOADNDX;
+
+	Elf32_Word phndx;
+	if (elfImageGetPhndxByVaddr(image, vaddr, sym->st_size, &phndx, NULL))
+		sym->st_shndx = SHN_ABS;
+	else
+		sym->st_shndx = ELF_LOADNDX + phndx;
 
 	return 0;
 }
 
-static int expSymMake(const SceKernelModuleInfo * restrict kernelInfo,
+static int expSymMake(const char * restrict libName,
 		      const struct elfImageExp * restrict exp,
 		      const struct elfImage * restrict image,
 		      vita_imports_t * restrict vitaImp,
+		      struct elfSectionSymtabNids * restrict nidNames,
 		      Elf32_Sym * restrict syms,
 		      struct elfSectionStrtab * restrict strtab)
 {
@@ -139,10 +175,10 @@ static int expSymMake(const SceKernelModuleInfo * restrict kernelInfo,
 
 	/* The NID can vary with the firmware, so use the name instead. */
 	vita_imports_lib_t * const lib
-		= vitaImportsFindLibByName(vitaImp, kernelInfo->module_name);
+		= vitaImportsFindLibByName(vitaImp, libName);
 	if (lib == NULL)
 		fprintf(stderr, "warning: library \"%s\" not found\n",
-			kernelInfo->module_name);
+			libName);
 
 	for (const struct elfExp *cursor = exp->top;
 	     cursor != exp->btm;
@@ -231,9 +267,8 @@ static int expSymMake(const SceKernelModuleInfo * restrict kernelInfo,
 			}
 
 			result = entryName == NULL ?
-				elfSectionStrtabAdd(
-					&syms->st_name, strtab, nameSize + 9,
-					"%s_%08X", name, *nid) :
+				placeholderAdd(nidNames, &syms->st_name, strtab,
+					       name, nameSize, *nid) :
 				elfSectionStrtabAdd(
 					&syms->st_name, strtab,
 					entryNameSize, entryName);
@@ -282,9 +317,8 @@ static int expSymMake(const SceKernelModuleInfo * restrict kernelInfo,
 			}
 
 			result = entryName == NULL ?
-				elfSectionStrtabAdd(
-					&syms->st_name, strtab, nameSize + 9,
-					"%s_%08X", name, *nid) :
+				placeholderAdd(nidNames, &syms->st_name, strtab,
+					       name, nameSize, *nid) :
 				elfSectionStrtabAdd(
 					&syms->st_name, strtab,
 					entryNameSize, entryName);
@@ -340,6 +374,7 @@ failStrtab:
 }
 
 static int makeTable(const struct elfImage * restrict image,
+		     struct elfSectionSymtabNids * restrict nidNames,
 		     const char * restrict name, Elf32_Word nameSize,
 		     vita_imports_module_t * restrict module,
 		     vita_imports_stub_t *(* findStub)(
@@ -380,10 +415,10 @@ static int makeTable(const struct elfImage * restrict image,
 			NULL : findStub(module, *nid);
 
 		result = stub == NULL ?
+			placeholderAdd(nidNames, &syms->st_name, strtab,
+				       name, nameSize, *nid) :
 			elfSectionStrtabAdd(&syms->st_name, strtab,
-				nameSize + 9, "%s_%08X", name, *nid) :
-			elfSectionStrtabAdd(&syms->st_name, strtab,
-				nameSize + 9, stub->name);
+				strlen(stub->name) + 1, "%s", stub->name);
 		if (result < 0)
 			goto failSymbol;
 
@@ -421,6 +456,7 @@ fail:
 static int impSymMake(const struct elfImageImp * restrict imp,
 		      const struct elfImage * restrict image,
 		      vita_imports_t *vitaImp,
+		      struct elfSectionSymtabNids * restrict nidNames,
 		      Elf32_Sym * restrict syms,
 		      struct elfSectionStrtab * restrict strtab)
 {
@@ -430,7 +466,7 @@ static int impSymMake(const struct elfImageImp * restrict imp,
 
 	for (const struct elfImp *cursor = imp->top;
 	     cursor != imp->btm;
-	     cursor++) {
+	     cursor = (void *)((char *)cursor + cursor->size)) {
 		if (cursor->name == 0) {
 			name = "null";
 			nameSize = sizeof("null");
@@ -455,7 +491,7 @@ static int impSymMake(const struct elfImageImp * restrict imp,
 			fprintf(stderr, "warning: module \"%s\" (NID: 0x%08X) not found\n",
 				name, cursor->nid);
 
-		result = makeTable(image, name, nameSize, module,
+		result = makeTable(image, nidNames, name, nameSize, module,
 				   vita_imports_find_function,
 				   cursor->funcNids, cursor->funcEntries,
 				   cursor->nFuncs, 16, STT_FUNC, syms, strtab);
@@ -463,21 +499,23 @@ static int impSymMake(const struct elfImageImp * restrict imp,
 			goto failTable;
 
 		syms += cursor->nFuncs;
-		result = makeTable(image, name, nameSize, module,
+		result = makeTable(image, nidNames, name, nameSize, module,
 				   vita_imports_find_variable,
 				   cursor->varNids, cursor->varEntries,
 				   cursor->nVars, 0, STT_OBJECT, syms, strtab);
 		if (result != 0)
 			goto failTable;
 
+		syms += cursor->nVars;
 		if (cursor->size >= sizeof(*cursor)) {
-			syms += cursor->nVars;
 			result = makeTable(
-				image, name, nameSize, NULL, NULL,
+				image, nidNames, name, nameSize, NULL, NULL,
 				cursor->tlsNids, cursor->tlsEntries,
 				cursor->nTls, 4, STT_TLS, syms, strtab);
 			if (result != 0)
 				goto failTable;
+
+			syms += cursor->nTls;
 		}
 	}
 
@@ -497,49 +535,398 @@ failTable:
 	return -1;
 }
 
+static int compareAddrs(const void *a, const void *b)
+{
+	const Elf32_Addr x = *(const Elf32_Addr *)a;
+	const Elf32_Addr y = *(const Elf32_Addr *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Makes the sorted addresses of the functions among syms, without the Thumb
+   bit. */
+static Elf32_Addr *funcAddrsMake(const Elf32_Sym * restrict syms,
+				 Elf32_Word nSyms, Elf32_Word * restrict n)
+{
+	Elf32_Addr * const addrs = noisyMalloc(nSyms * sizeof(*addrs));
+	if (addrs == NULL)
+		return NULL;
+
+	*n = 0;
+	for (Elf32_Word ndx = 0; ndx < nSyms; ndx++) {
+		const int type = ELF32_ST_TYPE(syms[ndx].st_info);
+
+		if (type == STT_FUNC || type == STT_ARM_TFUNC) {
+			addrs[*n] = syms[ndx].st_value & ~(Elf32_Addr)1;
+			(*n)++;
+		}
+	}
+
+	qsort(addrs, *n, sizeof(*addrs), compareAddrs);
+	return addrs;
+}
+
+/* Drops matches of signatures at named functions. */
+static void matchesFilter(struct elfSigMatch * restrict matches,
+			  Elf32_Word * restrict n,
+			  const Elf32_Addr * restrict named, Elf32_Word nNamed)
+{
+	Elf32_Word kept = 0;
+
+	for (Elf32_Word ndx = 0; ndx < *n; ndx++)
+		if (bsearch(&matches[ndx].vaddr, named, nNamed, sizeof(*named),
+			    compareAddrs) == NULL) {
+			matches[kept] = matches[ndx];
+			kept++;
+		}
+
+	*n = kept;
+}
+
+/* Merges matches of signatures into the sorted addresses of named
+   functions. */
+static Elf32_Addr *knownAddrsMake(const Elf32_Addr * restrict named,
+				  Elf32_Word nNamed,
+				  const struct elfSigMatch * restrict matches,
+				  Elf32_Word nMatches, Elf32_Word * restrict n)
+{
+	Elf32_Addr * const addrs = noisyMalloc(
+		((size_t)nNamed + nMatches) * sizeof(*addrs) + 1);
+	if (addrs == NULL)
+		return NULL;
+
+	Elf32_Word namedNdx = 0;
+	Elf32_Word matchNdx = 0;
+
+	*n = 0;
+	while (namedNdx < nNamed || matchNdx < nMatches) {
+		if (matchNdx >= nMatches
+		    || (namedNdx < nNamed
+			&& named[namedNdx] < matches[matchNdx].vaddr)) {
+			addrs[*n] = named[namedNdx];
+			namedNdx++;
+		} else {
+			addrs[*n] = matches[matchNdx].vaddr;
+			matchNdx++;
+		}
+
+		(*n)++;
+	}
+
+	return addrs;
+}
+
+/* Makes local symbols for functions signatures matched. */
+static int sigSymMake(const struct elfImage * restrict image,
+		      const struct elfSigMatch * restrict matches,
+		      Elf32_Word n, Elf32_Sym * restrict syms,
+		      struct elfSectionStrtab * restrict strtab)
+{
+	for (Elf32_Word ndx = 0; ndx < n; ndx++) {
+		Elf32_Sym * const sym = syms + ndx;
+
+		if (elfSectionStrtabAdd(&sym->st_name, strtab,
+					strlen(matches[ndx].name) + 1,
+					"%s", matches[ndx].name) < 0)
+			return -1;
+
+		/* Signatures are of Thumb code. */
+		sym->st_value = matches[ndx].vaddr | 1;
+		sym->st_size = matches[ndx].size;
+		sym->st_info = ELF32_ST_INFO(STB_LOCAL, STT_ARM_TFUNC);
+		sym->st_other = ELF32_ST_VISIBILITY(STV_DEFAULT);
+
+		Elf32_Word phndx;
+		if (elfImageGetPhndxByVaddr(image, matches[ndx].vaddr,
+					    sym->st_size,
+					    &phndx, NULL))
+			sym->st_shndx = SHN_ABS;
+		else
+			sym->st_shndx = ELF_LOADNDX + phndx;
+	}
+
+	return 0;
+}
+
+/* Makes the seeds of function discovery: Thumb functions among syms,
+   matches of signatures and the functions in the unwind tables which are not
+   named. Named ones in the tables may be ARM import stubs. */
+static Elf32_Addr *seedsMake(const Elf32_Sym * restrict syms,
+			     Elf32_Word nSyms,
+			     const struct elfSigMatch * restrict matches,
+			     Elf32_Word nMatches,
+			     const struct elfExidx * restrict exidxs,
+			     Elf32_Word nExidxs,
+			     const Elf32_Addr * restrict named,
+			     Elf32_Word nNamed, Elf32_Word * restrict n)
+{
+	Elf32_Word max;
+
+	if (waddOverflow(nSyms, nMatches, &max)) {
+		fputs("too many functions\n", stderr);
+		return NULL;
+	}
+
+	for (Elf32_Word ndx = 0; ndx < nExidxs; ndx++)
+		if (waddOverflow(max, exidxs[ndx].n, &max)) {
+			fputs("too many functions\n", stderr);
+			return NULL;
+		}
+
+	Elf32_Addr * const seeds = noisyMalloc(max * sizeof(*seeds));
+	if (seeds == NULL)
+		return NULL;
+
+	*n = 0;
+	for (Elf32_Word ndx = 0; ndx < nSyms; ndx++) {
+		if (ELF32_ST_TYPE(syms[ndx].st_info) == STT_ARM_TFUNC) {
+			seeds[*n] = syms[ndx].st_value;
+			(*n)++;
+		}
+	}
+
+	for (Elf32_Word ndx = 0; ndx < nMatches; ndx++) {
+		seeds[*n] = matches[ndx].vaddr;
+		(*n)++;
+	}
+
+	for (Elf32_Word ndx = 0; ndx < nExidxs; ndx++) {
+		for (Elf32_Word entry = 0; entry < exidxs[ndx].n; entry++) {
+			const Elf32_Addr start = exidxs[ndx].starts[entry];
+
+			if (bsearch(&start, named, nNamed, sizeof(*named),
+				    compareAddrs) == NULL) {
+				seeds[*n] = start;
+				(*n)++;
+			}
+		}
+	}
+
+	return seeds;
+}
+
+/* Makes local symbols for discovered functions which have no name yet,
+   called sub_XXXXXXXX unless names has one. Only counts them if syms is NULL.
+   The size does not reach a named function. */
+static Elf32_Word funcSymMake(const struct elfImage * restrict image,
+			      const struct elfFuncs * restrict funcs,
+			      const Elf32_Addr * restrict named,
+			      Elf32_Word nNamed,
+			      const struct nidOverlay * restrict names,
+			      Elf32_Sym * restrict syms,
+			      struct elfSectionStrtab * restrict strtab)
+{
+	Elf32_Word n = 0;
+	Elf32_Word next = 0;
+
+	for (Elf32_Word ndx = 0; ndx < funcs->n; ndx++) {
+		const Elf32_Addr start = funcs->funcs[ndx].vaddr;
+
+		while (next < nNamed && named[next] <= start)
+			next++;
+
+		if (next > 0 && named[next - 1] == start)
+			continue;
+
+		if (syms != NULL) {
+			Elf32_Sym * const sym = syms + n;
+			const char * const ported
+				= nidOverlayFind(names, start);
+			const int added = ported == NULL ?
+				elfSectionStrtabAdd(&sym->st_name, strtab,
+						    sizeof("sub_XXXXXXXX"),
+						    "sub_%08X", start) :
+				elfSectionStrtabAdd(&sym->st_name, strtab,
+						    strlen(ported) + 1,
+						    "%s", ported);
+			if (added < 0)
+				return (Elf32_Word)-1;
+
+			/* Discovered functions are Thumb code. */
+			sym->st_value = start | 1;
+			sym->st_size = funcs->funcs[ndx].size;
+			if (next < nNamed && sym->st_size > named[next] - start)
+				sym->st_size = named[next] - start;
+
+			sym->st_info = ELF32_ST_INFO(STB_LOCAL, STT_ARM_TFUNC);
+			sym->st_other = ELF32_ST_VISIBILITY(STV_DEFAULT);
+
+			Elf32_Word phndx;
+			if (elfImageGetPhndxByVaddr(image, start, sym->st_size,
+						    &phndx, NULL))
+				sym->st_shndx = SHN_ABS;
+			else
+				sym->st_shndx = ELF_LOADNDX + phndx;
+		}
+
+		n++;
+	}
+
+	return n;
+}
+
+static int globalSymMake(const struct elfImage * restrict image,
+			 const struct elfImageModule * restrict modules,
+			 Elf32_Word nModules,
+			 struct elfSectionSymtabNids * restrict nidNames,
+			 Elf32_Sym * restrict syms,
+			 struct elfSectionStrtab * restrict strtab)
+{
+	Elf32_Sym *cursor = syms;
+	int result;
+
+	/* The database is shared by all modules. */
+	vita_imports_t * const imports = vitaImportsLoad();
+	if (imports == NULL)
+		return -1;
+
+	for (Elf32_Word ndx = 0; ndx < nModules; ndx++) {
+		const struct elfImageModule * const module = modules + ndx;
+
+		if (!module->found)
+			continue;
+
+		result = infoSymMake(image, module->info.vaddr, cursor, strtab);
+		if (result < 0)
+			goto fail;
+
+		cursor++;
+		result = expSymMake(module->name, &module->exp, image,
+				    imports, nidNames, cursor, strtab);
+		if (result < 0)
+			goto fail;
+
+		cursor += expSymSumUp(&module->exp, image);
+		result = impSymMake(&module->imp, image, imports, nidNames,
+				    cursor, strtab);
+		if (result < 0)
+			goto fail;
+
+		cursor += impSymSumUp(&module->imp, image);
+	}
+
+	result = 0;
+
+fail:
+	vita_imports_free(imports);
+	return result;
+}
+
 int elfSectionSymtabMake(const struct elfImage * restrict image,
-			 const SceKernelModuleInfo * restrict kernelInfo,
+			 const struct elfImageModule * restrict modules,
+			 Elf32_Word nModules,
+			 struct elfSectionSymtabNids * restrict nidNames,
 			 struct elfSectionStrtab * restrict strtab,
 			 Elf32_Word strtabNdx,
 			 Elf32_Word name, Elf32_Off offset,
 			 Elf32_Shdr * restrict shdr,
 			 void ** restrict buffer)
 {
-	struct elfImageExp exp;
-	struct elfImageImp imp;
-	Elf32_Addr info;
-	int result;
+	Elf32_Word nGlobals = 0;
+	int result = -1;
+
+	for (Elf32_Word ndx = 0; ndx < nModules; ndx++) {
+		if (!modules[ndx].found)
+			continue;
+
+		const Elf32_Sword expSum = expSymSumUp(&modules[ndx].exp,
+						       image);
+		if (expSum < 0)
+			return -1;
+
+		const Elf32_Sword impSum = impSymSumUp(&modules[ndx].imp,
+						       image);
+		if (impSum < 0)
+			return -1;
+
+		if (waddOverflow(nGlobals, 1, &nGlobals)
+		    || waddOverflow(nGlobals, expSum, &nGlobals)
+		    || waddOverflow(nGlobals, impSum, &nGlobals))
+			goto failTooMany;
+	}
 
-	result = elfImageFindInfo(image, kernelInfo, &info, &exp, &imp);
-	if (result != 0)
-		goto failNoInfo;
+	Elf32_Word globalsSize;
+	if (wmulOverflow(nGlobals, sizeof(Elf32_Sym), &globalsSize))
+		goto failTooMany;
 
-	const Elf32_Sword expSum = expSymSumUp(&exp, image);
-	if (expSum < 0)
-		goto failNoExp;
+	Elf32_Sym * const globals = noisyMalloc(globalsSize);
+	if (globals == NULL)
+		return -1;
+
+	if (globalSymMake(image, modules, nModules, nidNames, globals, strtab)
+	    != 0)
+		goto failGlobals;
+
+	Elf32_Word nNamed;
+	Elf32_Addr * const named = funcAddrsMake(globals, nGlobals, &nNamed);
+	if (named == NULL)
+		goto failGlobals;
+
+	struct elfSigMatch *matches;
+	Elf32_Word nMatches;
+	if (elfSigMatch(nidNames->sigs, image, &matches, &nMatches) != 0)
+		goto failMatches;
+
+	matchesFilter(matches, &nMatches, named, nNamed);
+
+	Elf32_Word nKnown;
+	Elf32_Addr * const known = knownAddrsMake(named, nNamed,
+						  matches, nMatches, &nKnown);
+	if (known == NULL)
+		goto failKnown;
+
+	struct elfExidx * const exidxs
+		= noisyMalloc(nModules * sizeof(*exidxs));
+	if (exidxs == NULL)
+		goto failExidxs;
+
+	/* A broken table costs only its seeds. */
+	for (Elf32_Word ndx = 0; ndx < nModules; ndx++) {
+		if (!modules[ndx].found)
+			elfExidxInit(exidxs + ndx, image, 0, 0);
+		else if (elfExidxInitModule(exidxs + ndx, image,
+					    modules + ndx) != 0)
+			exidxs[ndx].n = 0;
+	}
 
-	const Elf32_Sword impSum = impSymSumUp(&imp, image);
-	if (impSum < 0)
-		goto failNoImp;
+	Elf32_Word nSeeds;
+	Elf32_Addr * const seeds = seedsMake(globals, nGlobals,
+					     matches, nMatches,
+					     exidxs, nModules,
+					     known, nKnown, &nSeeds);
+	if (seeds == NULL)
+		goto failSeeds;
+
+	struct elfFuncs funcs;
+	const int discovered = elfFuncsDiscover(&funcs, image, seeds, nSeeds);
+	free(seeds);
+	if (discovered != 0)
+		goto failSeeds;
+
+	Elf32_Word nLocals;
+	if (waddOverflow(nMatches,
+			 funcSymMake(image, &funcs, known, nKnown,
+				     nidNames->names, NULL, NULL),
+			 &nLocals))
+		goto failExidxsTooMany;
+
+	/* The null symbol and locals must precede globals. */
+	Elf32_Word nSyms;
+	if (waddOverflow(1, nLocals, &nSyms)
+	    || waddOverflow(nSyms, nGlobals, &nSyms))
+		goto failExidxsTooMany;
 
 	shdr->sh_name = name;
 	shdr->sh_type = SHT_SYMTAB;
 	shdr->sh_flags = 0;
 	shdr->sh_addr = 0;
 	shdr->sh_link = strtabNdx;
-	shdr->sh_info = 1;
+	shdr->sh_info = 1 + nLocals;
 	shdr->sh_addralign = 4;
 	shdr->sh_entsize = sizeof(Elf32_Sym);
 
-	Elf32_Word nSyms;
-	if (waddOverflow(2, expSum, &nSyms))
-		goto failTooMany;
-
-	if (waddOverflow(nSyms, impSum, &nSyms))
-		goto failTooMany;
-
 	if (wmulOverflow(nSyms, shdr->sh_entsize, &shdr->sh_size))
-		goto failTooMany;
+		goto failExidxsTooMany;
 
 	const Elf32_Off mod = offset % shdr->sh_addralign;
 	if (mod)
@@ -548,10 +935,8 @@ int elfSectionSymtabMake(const struct elfImage * restrict image,
 	shdr->sh_offset = offset;
 
 	Elf32_Sym * const syms = noisyMalloc(shdr->sh_size);
-	if (syms == NULL) {
-		result = -1;
-		goto failMalloc;
-	}
+	if (syms == NULL)
+		goto failSyms;
 
 	Elf32_Sym *cursor = syms;
 
@@ -560,36 +945,56 @@ int elfSectionSymtabMake(const struct elfImage * restrict image,
 		goto failSym;
 
 	cursor++;
-	result = infoSymMake(info, cursor, strtab);
+	result = sigSymMake(image, matches, nMatches, cursor, strtab);
 	if (result < 0)
 		goto failSym;
 
-	cursor++;
-	vita_imports_t * const imports = vitaImportsLoad();
-	if (imports == NULL)
+	cursor += nMatches;
+	const Elf32_Word n = funcSymMake(image, &funcs, known, nKnown,
+					 nidNames->names, cursor, strtab);
+	if (n == (Elf32_Word)-1) {
+		result = -1;
 		goto failSym;
+	}
 
-	result = expSymMake(kernelInfo, &exp, image, imports, cursor, strtab);
-	if (result < 0)
-		goto failSym;
+	cursor += n;
+	memcpy(cursor, globals, globalsSize);
 
-	cursor += expSum;
-	result = impSymMake(&imp, image, imports, cursor, strtab);
-	if (result < 0)
-		goto failSym;
+	elfFuncsDeinit(&funcs);
+	for (Elf32_Word ndx = 0; ndx < nModules; ndx++)
+		elfExidxDeinit(exidxs + ndx);
 
-	vita_imports_free(imports);
+	free(exidxs);
+	free(known);
+	free(matches);
+	free(named);
+	free(globals);
 
 	*buffer = syms;
 	return 0;
 
 failSym:
 	free(syms);
-failMalloc:
-failNoExp:
-failNoImp:
-failNoInfo:
-	return result;
+	goto failSyms;
+
+failExidxsTooMany:
+	fprintf(stderr, "%s: too many symbols\n", image->path);
+failSyms:
+	elfFuncsDeinit(&funcs);
+failSeeds:
+	for (Elf32_Word ndx = 0; ndx < nModules; ndx++)
+		elfExidxDeinit(exidxs + ndx);
+
+	free(exidxs);
+failExidxs:
+	free(known);
+failKnown:
+	free(matches);
+failMatches:
+	free(named);
+failGlobals:
+	free(globals);
+	return -1;
 
 failTooMany:
 	fprintf(stderr, "%s: too many symbols\n", image->path);
@@ -17,13 +17,30 @@
 
 #ifndef ELF_SECTOPN_SYMTAB_H
 
+#include "../../nid/overlay.h"
+#include "../../nid/set.h"
+#include "../../nid/table.h"
 #include "../elf.h"
 #include "../image.h"
 #include "../info.h"
+#include "../sig.h"
 #include "strtab.h"
 
+/* Where NIDs the database doesn't know are looked up, where NIDs without
+   any name are collected, signatures naming functions without NIDs, and
+   names of discovered functions by address, as port-symbols prints them. */
+struct elfSectionSymtabNids {
+	const struct nidOverlay *overlay;
+	const struct nidTable *table;
+	struct nidSet *unresolved;
+	const struct elfSigs *sigs;
+	const struct nidOverlay *names;
+};
+
 int elfSectionSymtabMake(const struct elfImage * restrict image,
-			 const SceKernelModuleInfo * restrict kernelInfo,
+			 const struct elfImageModule * restrict modules,
+			 Elf32_Word nModules,
+			 struct elfSectionSymtabNids * restrict nidNames,
 			 struct elfSectionStrtab * restrict strtab,
 			 Elf32_Word strtabIndex,
 			 Elf32_Word name, Elf32_Off offset,
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "../../overflow.h"
+#include "../driver.h"
+#include "../elf.h"
+#include "../exidx.h"
+#include "../image.h"
+#include "unwind.h"
+
+/* Tells whether [top, btm) of the module is a table in the dump. */
+static bool isTable(const struct elfImage * restrict image,
+		    const struct elfImageModule * restrict module,
+		    Elf32_Word top, Elf32_Word btm, Elf32_Word entrySize)
+{
+	Elf32_Word size;
+
+	if (wsubOverflow(btm, top, &size) || size <= 0
+	    || size % entrySize != 0)
+		return false;
+
+	return elfImageVaddrToOff(image, module->base + top, size, NULL) > 0;
+}
+
+static bool hasExidx(const struct elfImage * restrict image,
+		     const struct elfImageModule * restrict module)
+{
+	return module->found
+	       && isTable(image, module, module->info.ptr->exidxTop,
+			  module->info.ptr->exidxBtm,
+			  2 * sizeof(Elf32_Word));
+}
+
+static bool hasExtab(const struct elfImage * restrict image,
+		     const struct elfImageModule * restrict module)
+{
+	return module->found
+	       && isTable(image, module, module->info.ptr->extabTop,
+			  module->info.ptr->extabBtm, sizeof(Elf32_Word));
+}
+
+Elf32_Word elfSectionUnwindCount(const struct elfImage * restrict image,
+				 const struct elfImageModule * restrict modules,
+				 Elf32_Word nModules)
+{
+	Elf32_Word n = 0;
+
+	for (Elf32_Word ndx = 0; ndx < nModules; ndx++)
+		n += hasExidx(image, modules + ndx)
+		     + hasExtab(image, modules + ndx);
+
+	return n;
+}
+
+static void tableMake(const struct elfImage * restrict image,
+		      Elf32_Addr top, Elf32_Addr btm, Elf32_Word name,
+		      Elf32_Word type, Elf32_Word flags, Elf32_Word entsize,
+		      Elf32_Shdr * restrict shdr)
+{
+	shdr->sh_name = name;
+	shdr->sh_type = type;
+	shdr->sh_flags = flags;
+	shdr->sh_addr = top;
+	shdr->sh_offset = elfImageVaddrToOff(image, top, btm - top, NULL);
+	shdr->sh_size = btm - top;
+	shdr->sh_link = 0;
+	shdr->sh_info = 0;
+	shdr->sh_addralign = 4;
+	shdr->sh_entsize = entsize;
+}
+
+void elfSectionUnwindMake(const struct elfImage * restrict image,
+			  const struct elfImageModule * restrict modules,
+			  Elf32_Word nModules,
+			  Elf32_Word exidxName, Elf32_Word extabName,
+			  Elf32_Shdr * restrict shdr,
+			  void ** restrict section)
+{
+	for (const struct elfImageModule *module = modules;
+	     module != modules + nModules;
+	     module++) {
+		const SceModuleInfo * const info = module->info.ptr;
+
+		if (hasExidx(image, module)) {
+			const Elf32_Addr top = module->base + info->exidxTop;
+			Elf32_Word phndx;
+
+			tableMake(image, top, module->base + info->exidxBtm,
+				  exidxName, SHT_ARM_EXIDX,
+				  SHF_ALLOC | SHF_LINK_ORDER,
+				  2 * sizeof(Elf32_Word), shdr);
+
+			/* Link the section of the code the first entry
+			   describes, or the one containing the table. */
+			const Elf32_Word * const entry
+				= elfImageVaddrToPtr(image, top,
+						     sizeof(*entry), NULL);
+			if (elfImageGetPhndxByVaddr(image,
+						    elfExidxPrel31(top, *entry),
+						    0, &phndx, NULL) == 0
+			    || elfImageGetPhndxByVaddr(image, top, 0,
+						       &phndx, NULL) == 0)
+				shdr->sh_link = ELF_LOADNDX + phndx;
+
+			*section = NULL;
+			shdr++;
+			section++;
+		}
+
+		if (hasExtab(image, module)) {
+			tableMake(image, module->base + info->extabTop,
+				  module->base + info->extabBtm,
+				  extabName, SHT_PROGBITS, SHF_ALLOC, 0, shdr);
+
+			*section = NULL;
+			shdr++;
+			section++;
+		}
+	}
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ELF_SECTION_UNWIND_H
+#define ELF_SECTION_UNWIND_H
+
+#include "../elf.h"
+#include "../image.h"
+
+/* Returns the number of .ARM.exidx and .ARM.extab sections of the modules
+   which elfSectionUnwindMake makes. */
+Elf32_Word elfSectionUnwindCount(const struct elfImage * restrict image,
+				 const struct elfImageModule * restrict modules,
+				 Elf32_Word nModules);
+
+/* Makes sections describing the unwind tables in the dump. They have no
+   contents of their own. */
+void elfSectionUnwindMake(const struct elfImage * restrict image,
+			  const struct elfImageModule * restrict modules,
+			  Elf32_Word nModules,
+			  Elf32_Word exidxName, Elf32_Word extabName,
+			  Elf32_Shdr * restrict shdr,
+			  void ** restrict section);
+
+#endif
@@ -0,0 +1,648 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../crc32.h"
+#include "../nid/path.h"
+#include "../noisy/fcntl.h"
+#include "../noisy/lib.h"
+#include "branch.h"
+#include "elf.h"
+#include "image.h"
+#include "sig.h"
+
+#define SIG_FILTER_BITS 16
+
+/* The number of positions prefiltered at once. */
+#define SIG_BLOCK 16
+
+struct sigCandidate {
+	Elf32_Addr vaddr;
+	uint32_t record;
+};
+
+struct sigScan {
+	const struct elfSigs *sigs;
+	struct sigCandidate *candidates;
+	size_t n;
+	size_t capacity;
+};
+
+static uint32_t hashAnchor(uint32_t anchor)
+{
+	return (anchor * 0x9E3779B1) >> (32 - SIG_FILTER_BITS);
+}
+
+int elfSigCompare(const void *a, const void *b)
+{
+	const struct elfSigRecord * const x = a;
+	const struct elfSigRecord * const y = b;
+	int result;
+
+	if (elfSigAnchorMask(x) != elfSigAnchorMask(y))
+		return elfSigAnchorMask(x) < elfSigAnchorMask(y) ? -1 : 1;
+
+	if (elfSigAnchor(x) != elfSigAnchor(y))
+		return elfSigAnchor(x) < elfSigAnchor(y) ? -1 : 1;
+
+	result = memcmp(x->bytes, y->bytes, sizeof(x->bytes));
+	if (result != 0)
+		return result;
+
+	result = memcmp(x->mask, y->mask, sizeof(x->mask));
+	if (result != 0)
+		return result;
+
+	if (x->patternSize != y->patternSize)
+		return x->patternSize < y->patternSize ? -1 : 1;
+
+	if (x->tailSize != y->tailSize)
+		return x->tailSize < y->tailSize ? -1 : 1;
+
+	if (x->tailCrc != y->tailCrc)
+		return x->tailCrc < y->tailCrc ? -1 : 1;
+
+	return x->size < y->size ? -1 : x->size > y->size;
+}
+
+/* Clears the mask of n bytes at offset of the function. */
+static void maskBytes(uint8_t * restrict mask, Elf32_Word size,
+		      Elf32_Word offset, Elf32_Word n)
+{
+	for (; n > 0 && offset < size; n--, offset++)
+		mask[offset] = 0;
+}
+
+/* Masks the word which a load relative to the instruction at offset reads,
+   if it is in the function. */
+static void maskLiteral(uint8_t * restrict mask, Elf32_Word size,
+			Elf32_Addr vaddr, Elf32_Word offset,
+			Elf32_Addr displacement)
+{
+	const Elf32_Addr literal = ((vaddr + offset + 4) & ~(Elf32_Addr)3)
+				   + displacement;
+
+	if (literal - vaddr < size)
+		maskBytes(mask, size, literal - vaddr, sizeof(uint32_t));
+}
+
+static void maskCode(uint8_t * restrict mask,
+		     const unsigned char * restrict bytes, Elf32_Word size,
+		     Elf32_Addr vaddr)
+{
+	struct elfBranchInsn insn;
+
+	for (Elf32_Word offset = 0;
+	     size - offset >= sizeof(uint16_t);
+	     offset += insn.size) {
+		uint16_t halves[2] = { 0, 0 };
+
+		memcpy(halves, bytes + offset,
+		       size - offset >= sizeof(halves) ?
+			sizeof(halves) : sizeof(uint16_t));
+		elfBranchDecodeThumb(halves[0], halves[1], vaddr + offset,
+				     &insn);
+		if (insn.size > size - offset)
+			break;
+
+		const Elf32_Addr target = insn.target & ~(Elf32_Addr)1;
+
+		switch (insn.kind) {
+		case ELF_BRANCH_BL:
+		case ELF_BRANCH_BLX:
+			maskBytes(mask, size, offset, insn.size);
+			break;
+
+		case ELF_BRANCH_B:
+		case ELF_BRANCH_COND:
+			if (target - vaddr >= size)
+				maskBytes(mask, size, offset, insn.size);
+
+			break;
+
+		default:
+			break;
+		}
+
+		/* MOVW, MOVT, LDR.W and LDR from literals. */
+		if (insn.size > sizeof(uint16_t)) {
+			if ((halves[0] & 0xFB70) == 0xF240)
+				maskBytes(mask, size, offset, insn.size);
+			else if ((halves[0] & 0xFF7F) == 0xF85F)
+				maskLiteral(mask, size, vaddr, offset,
+					    (halves[0] & 0x80) != 0 ?
+						halves[1] & 0xFFFu :
+						-(Elf32_Addr)(halves[1] & 0xFFF));
+		} else if ((halves[0] & 0xF800) == 0x4800) {
+			maskLiteral(mask, size, vaddr, offset,
+				    (halves[0] & 0xFFu) * 4);
+		}
+	}
+}
+
+/* FNV-1a. */
+static uint64_t hashRecord(const struct elfSigRecord * restrict record)
+{
+	const unsigned char * const p = (const unsigned char *)record;
+	uint64_t hash = UINT64_C(0xCBF29CE484222325);
+
+	for (size_t ndx = 0; ndx < sizeof(*record); ndx++)
+		hash = (hash ^ p[ndx]) * UINT64_C(0x100000001B3);
+
+	return hash;
+}
+
+int elfSigMake(struct elfSigEntry * restrict entry,
+	       const unsigned char * restrict bytes, Elf32_Word size,
+	       Elf32_Addr vaddr,
+	       const Elf32_Word * restrict relocs, Elf32_Word nRelocs)
+{
+	struct elfSigRecord * const record = &entry->record;
+	Elf32_Word significant = 0;
+
+	if (size < ELF_SIG_SIZE_MIN)
+		return -1;
+
+	uint8_t * const mask = noisyMalloc(size);
+	if (mask == NULL)
+		return -1;
+
+	memset(mask, 0xFF, size);
+	maskCode(mask, bytes, size, vaddr & ~(Elf32_Addr)1);
+	for (Elf32_Word ndx = 0; ndx < nRelocs; ndx++)
+		maskBytes(mask, size, relocs[ndx], sizeof(uint32_t));
+
+	/* Masked bytes are zero so that equal signatures compare equal. */
+	memset(record, 0, sizeof(*record));
+	record->patternSize = size < ELF_SIG_PATTERN ? size : ELF_SIG_PATTERN;
+	for (uint32_t ndx = 0; ndx < record->patternSize; ndx++) {
+		record->bytes[ndx] = bytes[ndx] & mask[ndx];
+		record->mask[ndx] = mask[ndx];
+		significant += mask[ndx] != 0;
+	}
+
+	while (record->patternSize + record->tailSize < size
+	       && mask[record->patternSize + record->tailSize] != 0)
+		record->tailSize++;
+
+	free(mask);
+
+	if (significant + record->tailSize < ELF_SIG_SIZE_MIN)
+		return -1;
+
+	record->tailCrc = crc32(bytes + record->patternSize, record->tailSize);
+	record->size = size;
+	record->name = 0;
+	entry->hash = hashRecord(record);
+	return 0;
+}
+
+static int compareHashes(const void *a, const void *b)
+{
+	const struct elfSigEntry * const x = a;
+	const struct elfSigEntry * const y = b;
+
+	if (x->hash != y->hash)
+		return x->hash < y->hash ? -1 : 1;
+
+	const int result = elfSigCompare(&x->record, &y->record);
+	return result != 0 ? result : strcmp(x->name, y->name);
+}
+
+static int compareEntries(const void *a, const void *b)
+{
+	return elfSigCompare(&((const struct elfSigEntry *)a)->record,
+			     &((const struct elfSigEntry *)b)->record);
+}
+
+int elfSigWrite(const char * restrict path,
+		struct elfSigEntry * restrict entries, size_t * restrict n)
+{
+	struct mappedHeader header;
+	size_t kept = 0;
+	size_t namesSize = 0;
+	int result = -1;
+
+	/* Hashes bring equal signatures together before they are ordered. */
+	if (*n > 0)
+		qsort(entries, *n, sizeof(*entries), compareHashes);
+
+	for (size_t ndx = 0; ndx < *n; ) {
+		bool agreed = true;
+		size_t next;
+
+		for (next = ndx + 1;
+		     next < *n && entries[next].hash == entries[ndx].hash
+		     && elfSigCompare(&entries[next].record,
+				      &entries[ndx].record) == 0;
+		     next++)
+			if (strcmp(entries[next].name, entries[ndx].name) != 0)
+				agreed = false;
+
+		/* Swapped so that the caller still frees every name. */
+		if (agreed) {
+			const struct elfSigEntry entry = entries[kept];
+
+			entries[kept] = entries[ndx];
+			entries[ndx] = entry;
+			namesSize += strlen(entries[kept].name) + 1;
+			kept++;
+		}
+
+		ndx = next;
+	}
+
+	if (namesSize > UINT32_MAX
+	    || kept > (UINT32_MAX - sizeof(header))
+		      / sizeof(struct elfSigRecord)) {
+		fputs("too many signatures\n", stderr);
+		return -1;
+	}
+
+	if (kept > 0)
+		qsort(entries, kept, sizeof(*entries), compareEntries);
+
+	struct elfSigRecord * const records
+		= noisyMalloc(kept * sizeof(*records) + 1);
+	if (records == NULL)
+		return -1;
+
+	char * const names = noisyMalloc(namesSize + 1);
+	if (names == NULL)
+		goto failNames;
+
+	namesSize = 0;
+	for (size_t ndx = 0; ndx < kept; ndx++) {
+		const size_t size = strlen(entries[ndx].name) + 1;
+
+		records[ndx] = entries[ndx].record;
+		records[ndx].name = namesSize;
+		memcpy(names + namesSize, entries[ndx].name, size);
+		namesSize += size;
+	}
+
+	memcpy(header.magic, ELF_SIG_MAGIC, sizeof(header.magic));
+	header.n = kept;
+	header.names = sizeof(header) + kept * sizeof(*records);
+
+	struct noisyFile * const file = noisyCreat(path);
+	if (file == NULL)
+		goto failCreat;
+
+	if (noisyWrite(file, &header, sizeof(header)) == sizeof(header)
+	    && noisyWrite(file, records, kept * sizeof(*records))
+	       == (ssize_t)(kept * sizeof(*records))
+	    && noisyWrite(file, names, namesSize) == (ssize_t)namesSize)
+		result = 0;
+
+	if (noisyClose(file) != 0)
+		result = -1;
+
+	*n = kept;
+
+failCreat:
+	free(names);
+failNames:
+	free(records);
+	return result;
+}
+
+char *elfSigPath(void)
+{
+	return nidPath("VITA_ANALYZE_SIGS", "signatures.bin");
+}
+
+static bool isValid(const struct elfSigRecord * restrict record,
+		    uint32_t namesSize)
+{
+	return record->patternSize >= sizeof(uint32_t)
+	       && record->patternSize <= ELF_SIG_PATTERN
+	       && record->patternSize <= record->size
+	       && record->tailSize <= record->size - record->patternSize
+	       && record->name < namesSize;
+}
+
+/* Groups records into runs and hashes their anchors. */
+static int makeRuns(struct elfSigs * restrict sigs)
+{
+	sigs->nRuns = 0;
+	for (uint32_t ndx = 0; ndx < sigs->mapped.n; ndx++)
+		if (ndx <= 0 || elfSigAnchorMask(sigs->records + ndx)
+				!= elfSigAnchorMask(sigs->records + ndx - 1))
+			sigs->nRuns++;
+
+	sigs->runs = noisyMalloc(sigs->nRuns * sizeof(*sigs->runs) + 1);
+	if (sigs->runs == NULL)
+		return -1;
+
+	sigs->filter = noisyCalloc((1 << SIG_FILTER_BITS) / 8);
+	if (sigs->filter == NULL) {
+		free(sigs->runs);
+		return -1;
+	}
+
+	sigs->nRuns = 0;
+	for (uint32_t ndx = 0; ndx < sigs->mapped.n; ndx++) {
+		const struct elfSigRecord * const record = sigs->records + ndx;
+		const uint32_t hash = hashAnchor(elfSigAnchor(record));
+
+		if (ndx <= 0 || elfSigAnchorMask(record)
+				!= elfSigAnchorMask(record - 1)) {
+			sigs->runs[sigs->nRuns].mask = elfSigAnchorMask(record);
+			sigs->runs[sigs->nRuns].first = ndx;
+			sigs->runs[sigs->nRuns].n = 0;
+			sigs->nRuns++;
+		}
+
+		sigs->runs[sigs->nRuns - 1].n++;
+		sigs->filter[hash / 64] |= UINT64_C(1) << hash % 64;
+	}
+
+	return 0;
+}
+
+int elfSigOpen(struct elfSigs * restrict sigs, const char * restrict path)
+{
+	sigs->runs = NULL;
+	sigs->nRuns = 0;
+	sigs->filter = NULL;
+
+	if (mappedOpen(&sigs->mapped, path, ELF_SIG_MAGIC,
+		       sizeof(*sigs->records), "signature file") != 0)
+		return -1;
+
+	sigs->records = sigs->mapped.records;
+
+	for (uint32_t ndx = 0; ndx < sigs->mapped.n; ndx++)
+		if (!isValid(sigs->records + ndx, sigs->mapped.namesSize)
+		    || (ndx > 0 && elfSigCompare(sigs->records + ndx - 1,
+						 sigs->records + ndx) > 0))
+			goto failFormat;
+
+	if (makeRuns(sigs) != 0)
+		goto failIndex;
+
+	return 0;
+
+failFormat:
+	fprintf(stderr, "%s: not a signature file\n", path);
+failIndex:
+	mappedClose(&sigs->mapped);
+	return -1;
+}
+
+/* Returns a mask of positions whose anchor may be of a signature. It has no
+   branches so that compilers vectorize it. */
+static uint32_t prefilter(const struct elfSigs * restrict sigs,
+			  const unsigned char * restrict bytes)
+{
+	uint32_t words[SIG_BLOCK];
+	uint32_t mask = 0;
+
+	for (int ndx = 0; ndx < SIG_BLOCK; ndx++)
+		memcpy(words + ndx, bytes + ndx * sizeof(uint16_t),
+		       sizeof(*words));
+
+	for (uint32_t run = 0; run < sigs->nRuns; run++)
+		for (int ndx = 0; ndx < SIG_BLOCK; ndx++) {
+			const uint32_t hash = hashAnchor(
+				words[ndx] & sigs->runs[run].mask);
+
+			mask |= (uint32_t)(sigs->filter[hash / 64]
+					   >> hash % 64 & 1) << ndx;
+		}
+
+	return mask;
+}
+
+static bool matches(const struct elfSigRecord * restrict record,
+		    const unsigned char * restrict bytes, Elf32_Word max)
+{
+	if (record->size > max)
+		return false;
+
+	for (uint32_t ndx = 0; ndx < record->patternSize; ndx++)
+		if (((bytes[ndx] ^ record->bytes[ndx]) & record->mask[ndx]) != 0)
+			return false;
+
+	return crc32(bytes + record->patternSize, record->tailSize)
+	       == record->tailCrc;
+}
+
+static int addCandidate(struct sigScan * restrict scan, Elf32_Addr vaddr,
+			uint32_t record)
+{
+	if (scan->n >= scan->capacity) {
+		const size_t capacity = scan->capacity <= 0 ?
+			256 : scan->capacity * 2;
+		struct sigCandidate * const candidates = noisyRealloc(
+			scan->candidates, capacity * sizeof(*candidates));
+		if (candidates == NULL)
+			return -1;
+
+		scan->candidates = candidates;
+		scan->capacity = capacity;
+	}
+
+	scan->candidates[scan->n].vaddr = vaddr;
+	scan->candidates[scan->n].record = record;
+	scan->n++;
+	return 0;
+}
+
+/* Looks the anchor at bytes up in each run. */
+static int check(struct sigScan * restrict scan,
+		 const unsigned char * restrict bytes, Elf32_Word max,
+		 Elf32_Addr vaddr)
+{
+	const struct elfSigs * const sigs = scan->sigs;
+	uint32_t word;
+
+	memcpy(&word, bytes, sizeof(word));
+
+	for (uint32_t run = 0; run < sigs->nRuns; run++) {
+		const uint32_t anchor = word & sigs->runs[run].mask;
+		uint32_t lo = sigs->runs[run].first;
+		const uint32_t btm = lo + sigs->runs[run].n;
+		uint32_t hi = btm;
+
+		while (lo < hi) {
+			const uint32_t mid = lo + (hi - lo) / 2;
+
+			if (elfSigAnchor(sigs->records + mid) < anchor)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		for (; lo < btm && elfSigAnchor(sigs->records + lo) == anchor;
+		     lo++)
+			if (matches(sigs->records + lo, bytes, max)
+			    && addCandidate(scan, vaddr, lo) != 0)
+				return -1;
+	}
+
+	return 0;
+}
+
+static int scanSegment(struct sigScan * restrict scan,
+		       const unsigned char * restrict bytes, Elf32_Word size,
+		       Elf32_Addr vaddr)
+{
+	Elf32_Word offset = 0;
+
+	while (size - offset >= sizeof(uint32_t)) {
+		uint32_t mask;
+		Elf32_Word n;
+
+		if (size - offset >= (SIG_BLOCK + 1) * sizeof(uint16_t)) {
+			mask = prefilter(scan->sigs, bytes + offset);
+			n = SIG_BLOCK;
+		} else {
+			mask = 1;
+			n = 1;
+		}
+
+		for (Elf32_Word ndx = 0; mask != 0; ndx++, mask >>= 1) {
+			const Elf32_Word position = offset
+						    + ndx * sizeof(uint16_t);
+
+			if ((mask & 1) != 0
+			    && check(scan, bytes + position, size - position,
+				     vaddr + position) != 0)
+				return -1;
+		}
+
+		offset += n * sizeof(uint16_t);
+	}
+
+	return 0;
+}
+
+static int compareCandidates(const void *a, const void *b)
+{
+	const struct sigCandidate * const x = a;
+	const struct sigCandidate * const y = b;
+
+	if (x->vaddr != y->vaddr)
+		return x->vaddr < y->vaddr ? -1 : 1;
+
+	return x->record < y->record ? -1 : x->record > y->record;
+}
+
+/* Keeps places where all candidates agree on the name, out of the previous
+   match. */
+static int resolve(const struct elfSigs * restrict sigs,
+		   struct sigCandidate * restrict candidates, size_t nCandidates,
+		   struct elfSigMatch ** restrict matches,
+		   Elf32_Word * restrict n)
+{
+	Elf32_Addr end = 0;
+
+	*matches = noisyMalloc(nCandidates * sizeof(**matches) + 1);
+	if (*matches == NULL)
+		return -1;
+
+	*n = 0;
+
+	if (nCandidates > 0)
+		qsort(candidates, nCandidates, sizeof(*candidates),
+		      compareCandidates);
+
+	for (size_t ndx = 0; ndx < nCandidates; ) {
+		const struct elfSigRecord * const record
+			= sigs->records + candidates[ndx].record;
+		const Elf32_Addr vaddr = candidates[ndx].vaddr;
+		const char * const name = sigs->mapped.names + record->name;
+		bool agreed = true;
+		size_t next;
+
+		for (next = ndx + 1;
+		     next < nCandidates && candidates[next].vaddr == vaddr;
+		     next++)
+			if (strcmp(sigs->mapped.names
+				   + sigs->records[candidates[next].record].name,
+				   name) != 0)
+				agreed = false;
+
+		ndx = next;
+		if (!agreed || (*n > 0 && vaddr < end))
+			continue;
+
+		(*matches)[*n].vaddr = vaddr;
+		(*matches)[*n].size = record->size;
+		(*matches)[*n].name = name;
+		(*n)++;
+		end = vaddr + record->size;
+	}
+
+	return 0;
+}
+
+int elfSigMatch(const struct elfSigs * restrict sigs,
+		const struct elfImage * restrict image,
+		struct elfSigMatch ** restrict matches,
+		Elf32_Word * restrict n)
+{
+	const Elf32_Ehdr * const ehdr = image->buffer;
+	const Elf32_Phdr * const phdrs
+		= elfImageOffToPtr(image, ehdr->e_phoff);
+	struct sigScan scan = { .sigs = sigs, .candidates = NULL,
+				.n = 0, .capacity = 0 };
+	int result = 0;
+
+	for (Elf32_Half ndx = 0; sigs->mapped.n > 0 && ndx < ehdr->e_phnum; ndx++) {
+		const Elf32_Phdr * const phdr = phdrs + ndx;
+
+		if (phdr->p_type != PT_LOAD || (phdr->p_flags & PF_X) == 0)
+			continue;
+
+		/* Thumb instructions are aligned to halfwords. */
+		const Elf32_Word skew = phdr->p_vaddr & 1;
+		if (phdr->p_filesz <= skew)
+			continue;
+
+		result = scanSegment(&scan,
+				     (const unsigned char *)elfImageOffToPtr(
+					image, phdr->p_offset) + skew,
+				     phdr->p_filesz - skew,
+				     phdr->p_vaddr + skew);
+		if (result != 0)
+			goto end;
+	}
+
+	result = resolve(sigs, scan.candidates, scan.n, matches, n);
+
+end:
+	free(scan.candidates);
+	return result;
+}
+
+void elfSigClose(const struct elfSigs * restrict sigs)
+{
+	free(sigs->filter);
+	free(sigs->runs);
+
+	mappedClose(&sigs->mapped);
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ELF_SIG_H
+#define ELF_SIG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "../mapped.h"
+#include "elf.h"
+#include "image.h"
+
+#define ELF_SIG_MAGIC "FUNCSIG1"
+
+/* The number of leading bytes of a function compared with a mask. */
+#define ELF_SIG_PATTERN 32
+
+/* The records of the mapped file, sorted by elfSigCompare. */
+struct elfSigRecord {
+	uint8_t bytes[ELF_SIG_PATTERN];
+
+	/* 0xFF for bytes which must match and 0 for relocated ones. */
+	uint8_t mask[ELF_SIG_PATTERN];
+
+	/* Up to ELF_SIG_PATTERN, and up to size. */
+	uint32_t patternSize;
+
+	/* The CRC of the bytes after the pattern up to the first relocated
+	   one. */
+	uint32_t tailSize;
+	uint32_t tailCrc;
+
+	uint32_t size;
+
+	/* The offset of the name from the beginning of names. */
+	uint32_t name;
+};
+
+/* Records are looked up by the masked first word, the anchor. Records with
+   the same anchor mask make a run. */
+struct elfSigRun {
+	uint32_t mask;
+	uint32_t first;
+	uint32_t n;
+};
+
+/* Signatures mapped from a file. */
+struct elfSigs {
+	struct mapped mapped;
+	const struct elfSigRecord *records;
+
+	struct elfSigRun *runs;
+	uint32_t nRuns;
+
+	/* Hashes of anchors. */
+	uint64_t *filter;
+};
+
+/* Functions shorter than this have no signature. */
+#define ELF_SIG_SIZE_MIN 12
+
+/* A signature with its name, before it is written. */
+struct elfSigEntry {
+	struct elfSigRecord record;
+	uint64_t hash;
+	const char *name;
+};
+
+/* A function a signature matched. */
+struct elfSigMatch {
+	/* Without the Thumb bit. */
+	Elf32_Addr vaddr;
+	Elf32_Word size;
+	const char *name;
+};
+
+static inline uint32_t elfSigAnchorMask(
+	const struct elfSigRecord * restrict record)
+{
+	uint32_t mask;
+
+	memcpy(&mask, record->mask, sizeof(mask));
+	return mask;
+}
+
+static inline uint32_t elfSigAnchor(const struct elfSigRecord * restrict record)
+{
+	uint32_t anchor;
+
+	memcpy(&anchor, record->bytes, sizeof(anchor));
+	return anchor & elfSigAnchorMask(record);
+}
+
+/* Orders records by anchor mask, anchor and the rest of the pattern. */
+int elfSigCompare(const void *a, const void *b);
+
+/* Makes the signature of the Thumb function at vaddr. Branches out of it,
+   MOVW, MOVT, literals it loads and relocated words at relocs, which are
+   sorted offsets from bytes, are masked. name is left to the caller. Returns
+   -1 if the function is too short, or too little of it is left. */
+int elfSigMake(struct elfSigEntry * restrict entry,
+	       const unsigned char * restrict bytes, Elf32_Word size,
+	       Elf32_Addr vaddr,
+	       const Elf32_Word * restrict relocs, Elf32_Word nRelocs);
+
+/* Drops repeated signatures, and all of ones shared by different names, and
+   writes the rest sorted. Written entries are moved to the beginning and n
+   is updated to their number. */
+int elfSigWrite(const char * restrict path,
+		struct elfSigEntry * restrict entries, size_t * restrict n);
+
+/* Returns VITA_ANALYZE_SIGS, or $VITASDK/share/signatures.bin, which must
+   be freed. */
+char *elfSigPath(void);
+
+/* A missing file is taken as no signatures. */
+int elfSigOpen(struct elfSigs * restrict sigs, const char * restrict path);
+
+/* Matches the signatures at every halfword of executable loadable segments.
+   Places where signatures of different names match and matches in other
+   matches are dropped. matches are sorted by address and must be freed. */
+int elfSigMatch(const struct elfSigs * restrict sigs,
+		const struct elfImage * restrict image,
+		struct elfSigMatch ** restrict matches,
+		Elf32_Word * restrict n);
+
+void elfSigClose(const struct elfSigs * restrict sigs);
+
+#endif
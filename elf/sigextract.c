@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../noisy/lib.h"
+#include "../pool.h"
+#include "elf.h"
+#include "sig.h"
+#include "sigextract.h"
+#include "symfile.h"
+
+struct extractPool {
+	pthread_mutex_t lock;
+	const char * const *paths;
+	size_t nPaths;
+	size_t next;
+	int result;
+};
+
+struct extractWorker {
+	struct extractPool *pool;
+	struct elfSigEntry *entries;
+	size_t n;
+	size_t capacity;
+};
+
+static int addEntry(struct extractWorker * restrict worker,
+		    const struct elfSigEntry * restrict entry,
+		    const char * restrict name)
+{
+	if (worker->n >= worker->capacity) {
+		const size_t capacity = worker->capacity <= 0 ?
+			1024 : worker->capacity * 2;
+		struct elfSigEntry * const entries = noisyRealloc(
+			worker->entries, capacity * sizeof(*entries));
+		if (entries == NULL)
+			return -1;
+
+		worker->entries = entries;
+		worker->capacity = capacity;
+	}
+
+	const size_t size = strlen(name) + 1;
+	char * const copy = noisyMalloc(size);
+	if (copy == NULL)
+		return -1;
+
+	memcpy(copy, name, size);
+	worker->entries[worker->n] = *entry;
+	worker->entries[worker->n].name = copy;
+	worker->n++;
+	return 0;
+}
+
+static int extractFunc(void *context, const struct elfSymFunc * restrict func)
+{
+	struct extractWorker * const worker = context;
+	struct elfSigEntry entry;
+
+	if (!elfSymFileIsNamed(func->name)
+	    || elfSigMake(&entry, func->bytes, func->size, func->vaddr,
+			  func->relocs, func->nRelocs) != 0)
+		return 0;
+
+	return addEntry(worker, &entry, func->name);
+}
+
+static int extractFile(struct extractWorker * restrict worker,
+		       const char * restrict path)
+{
+	struct elfSymFile file;
+
+	const int result = elfSymFileOpen(&file, path);
+	if (result != 0)
+		return result < 0 ? -1 : 0;
+
+	const int visited = elfSymFileFuncs(&file, extractFunc, worker);
+	elfSymFileClose(&file);
+	return visited;
+}
+
+static void *extractWork(void *p)
+{
+	struct extractWorker * const worker = p;
+	struct extractPool * const pool = worker->pool;
+
+	while (true) {
+		pthread_mutex_lock(&pool->lock);
+		const size_t ndx = pool->next;
+		const bool failed = pool->result != 0;
+		if (ndx < pool->nPaths)
+			pool->next++;
+		pthread_mutex_unlock(&pool->lock);
+
+		if (failed || ndx >= pool->nPaths)
+			break;
+
+		if (extractFile(worker, pool->paths[ndx]) != 0) {
+			pthread_mutex_lock(&pool->lock);
+			pool->result = -1;
+			pthread_mutex_unlock(&pool->lock);
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+int elfSigExtract(const char * const * restrict paths, size_t nPaths,
+		  struct elfSigEntry ** restrict entries, size_t * restrict n)
+{
+	struct extractPool pool = { PTHREAD_MUTEX_INITIALIZER,
+				    paths, nPaths, 0, 0 };
+	struct extractWorker workers[POOL_THREADS_MAX];
+	size_t total = 0;
+
+	size_t wanted = poolWorkers();
+	if (wanted > nPaths)
+		wanted = nPaths > 0 ? nPaths : 1;
+
+	for (size_t ndx = 0; ndx < wanted; ndx++) {
+		workers[ndx].pool = &pool;
+		workers[ndx].entries = NULL;
+		workers[ndx].n = 0;
+		workers[ndx].capacity = 0;
+	}
+
+	poolSpawn(extractWork, workers, sizeof(*workers), wanted);
+
+	for (size_t ndx = 0; ndx < wanted; ndx++)
+		total += workers[ndx].n;
+
+	*entries = pool.result == 0 ?
+		noisyMalloc(total * sizeof(**entries) + 1) : NULL;
+	*n = 0;
+
+	for (size_t ndx = 0; ndx < wanted; ndx++) {
+		if (*entries != NULL) {
+			if (workers[ndx].n > 0)
+				memcpy(*entries + *n, workers[ndx].entries,
+				       workers[ndx].n * sizeof(**entries));
+
+			*n += workers[ndx].n;
+		} else {
+			elfSigExtractFree(workers[ndx].entries,
+					  workers[ndx].n);
+			continue;
+		}
+
+		free(workers[ndx].entries);
+	}
+
+	return *entries == NULL ? -1 : 0;
+}
+
+void elfSigExtractFree(struct elfSigEntry * restrict entries, size_t n)
+{
+	for (size_t ndx = 0; ndx < n; ndx++)
+		free((void *)entries[ndx].name);
+
+	free(entries);
+}
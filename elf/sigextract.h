@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ELF_SIGEXTRACT_H
+#define ELF_SIGEXTRACT_H
+
+#include <stddef.h>
+#include "sig.h"
+
+/* Makes signatures of the sized Thumb functions named in .symtab of ELFs,
+   vita-analyze outputs and relocatable objects alike, on all processors.
+   Words relocated by SHT_REL sections are masked. Names are allocated for
+   each entry and freed by elfSigExtractFree. */
+int elfSigExtract(const char * const * restrict paths, size_t nPaths,
+		  struct elfSigEntry ** restrict entries, size_t * restrict n);
+
+void elfSigExtractFree(struct elfSigEntry * restrict entries, size_t n);
+
+#endif
@@ -0,0 +1,296 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../noisy/lib.h"
+#include "../readwhole.h"
+#include "elf.h"
+#include "symfile.h"
+
+static int compareOffs(const void *a, const void *b)
+{
+	const Elf32_Off x = *(const Elf32_Off *)a;
+	const Elf32_Off y = *(const Elf32_Off *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static bool isInFile(const struct elfSymFile * restrict file,
+		     Elf32_Off offset, Elf32_Word size)
+{
+	return offset <= file->size && size <= file->size - offset;
+}
+
+static int validate(struct elfSymFile * restrict file)
+{
+	const Elf32_Ehdr * const ehdr = file->ehdr;
+
+	if (file->size < sizeof(*ehdr)
+	    || memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0
+	    || ehdr->e_ident[EI_CLASS] != ELFCLASS32
+	    || ehdr->e_machine != EM_ARM
+	    || ehdr->e_shentsize != sizeof(Elf32_Shdr)
+	    || !isInFile(file, ehdr->e_shoff,
+			 ehdr->e_shnum * sizeof(Elf32_Shdr))) {
+		fprintf(stderr, "%s: not a 32-bit ARM ELF with sections; skipped\n",
+			file->path);
+		return -1;
+	}
+
+	file->shdrs = (const void *)(file->buffer + ehdr->e_shoff);
+	for (Elf32_Half ndx = 0; ndx < ehdr->e_shnum; ndx++) {
+		const Elf32_Shdr * const shdr = file->shdrs + ndx;
+
+		if (shdr->sh_type != SHT_NOBITS
+		    && !isInFile(file, shdr->sh_offset, shdr->sh_size)) {
+			fprintf(stderr, "%s: section %u is out of the file; skipped\n",
+				file->path, ndx);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* Returns the file offset of vaddr in an allocated section, or 0. */
+static Elf32_Off vaddrToOff(const struct elfSymFile * restrict file,
+			    Elf32_Addr vaddr)
+{
+	for (Elf32_Half ndx = 1; ndx < file->ehdr->e_shnum; ndx++) {
+		const Elf32_Shdr * const shdr = file->shdrs + ndx;
+
+		if ((shdr->sh_flags & SHF_ALLOC) != 0
+		    && shdr->sh_type != SHT_NOBITS
+		    && vaddr - shdr->sh_addr < shdr->sh_size)
+			return shdr->sh_offset + (vaddr - shdr->sh_addr);
+	}
+
+	return 0;
+}
+
+/* Collects relocated words. Objects relocate offsets in the section named
+   by sh_info; others relocate addresses. */
+static int collectRelocs(struct elfSymFile * restrict file)
+{
+	const bool object = file->ehdr->e_type == ET_REL;
+	size_t max = 0;
+
+	file->relocs = NULL;
+	file->nRelocs = 0;
+
+	for (Elf32_Half ndx = 0; ndx < file->ehdr->e_shnum; ndx++)
+		if (file->shdrs[ndx].sh_type == SHT_REL)
+			max += file->shdrs[ndx].sh_size / sizeof(Elf32_Rel);
+
+	file->relocs = noisyMalloc(max * sizeof(*file->relocs) + 1);
+	if (file->relocs == NULL)
+		return -1;
+
+	for (Elf32_Half ndx = 0; ndx < file->ehdr->e_shnum; ndx++) {
+		const Elf32_Shdr * const shdr = file->shdrs + ndx;
+
+		if (shdr->sh_type != SHT_REL
+		    || (object && (shdr->sh_info <= 0
+				   || shdr->sh_info >= file->ehdr->e_shnum)))
+			continue;
+
+		const Elf32_Rel * const rels
+			= (const void *)(file->buffer + shdr->sh_offset);
+		const Elf32_Shdr * const target = file->shdrs + shdr->sh_info;
+
+		for (Elf32_Word rel = 0;
+		     rel < shdr->sh_size / sizeof(Elf32_Rel);
+		     rel++) {
+			Elf32_Rel entry;
+			Elf32_Off offset;
+
+			memcpy(&entry, rels + rel, sizeof(entry));
+			if (object)
+				offset = entry.r_offset < target->sh_size ?
+					target->sh_offset + entry.r_offset : 0;
+			else
+				offset = vaddrToOff(file, entry.r_offset);
+
+			if (offset > 0) {
+				file->relocs[file->nRelocs] = offset;
+				file->nRelocs++;
+			}
+		}
+	}
+
+	if (file->nRelocs > 0)
+		qsort(file->relocs, file->nRelocs, sizeof(*file->relocs),
+		      compareOffs);
+
+	return 0;
+}
+
+int elfSymFileOpen(struct elfSymFile * restrict file, const char *path)
+{
+	file->path = path;
+	file->buffer = readWhole(path, &file->size);
+	if (file->buffer == NULL)
+		return -1;
+
+	file->ehdr = (const void *)file->buffer;
+
+	/* Other files given by a glob are skipped. */
+	if (validate(file) != 0) {
+		free((void *)file->buffer);
+		return 1;
+	}
+
+	if (collectRelocs(file) != 0) {
+		free((void *)file->buffer);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int visitSymtab(const struct elfSymFile * restrict file,
+		       const Elf32_Shdr * restrict symtab,
+		       elfSymFileVisit *visit, void *context)
+{
+	const Elf32_Half shnum = file->ehdr->e_shnum;
+	Elf32_Word *relocs = NULL;
+	size_t capacity = 0;
+	int result = 0;
+
+	if (symtab->sh_link >= shnum)
+		return 0;
+
+	const Elf32_Shdr * const strtab = file->shdrs + symtab->sh_link;
+	const char * const names = (const char *)file->buffer
+				   + strtab->sh_offset;
+	const Elf32_Sym * const syms
+		= (const void *)(file->buffer + symtab->sh_offset);
+
+	/* Names must end with NUL in the section. */
+	if (strtab->sh_size <= 0 || names[strtab->sh_size - 1] != 0)
+		return 0;
+
+	for (Elf32_Word ndx = 0;
+	     ndx < symtab->sh_size / sizeof(Elf32_Sym);
+	     ndx++) {
+		Elf32_Sym sym;
+		struct elfSymFunc func;
+
+		memcpy(&sym, syms + ndx, sizeof(sym));
+
+		const int type = ELF32_ST_TYPE(sym.st_info);
+		const bool thumb = type == STT_ARM_TFUNC
+				   || (type == STT_FUNC
+				       && (sym.st_value & 1) != 0);
+		if (!thumb || sym.st_size <= 0
+		    || sym.st_shndx <= SHN_UNDEF || sym.st_shndx >= shnum
+		    || sym.st_name >= strtab->sh_size
+		    || names[sym.st_name] == 0 || names[sym.st_name] == '$')
+			continue;
+
+		const Elf32_Shdr * const shdr = file->shdrs + sym.st_shndx;
+		const Elf32_Addr vaddr = sym.st_value & ~(Elf32_Addr)1;
+		const Elf32_Addr start = file->ehdr->e_type == ET_REL ?
+			vaddr : vaddr - shdr->sh_addr;
+
+		if (shdr->sh_type == SHT_NOBITS || start > shdr->sh_size
+		    || sym.st_size > shdr->sh_size - start)
+			continue;
+
+		const Elf32_Off offset = shdr->sh_offset + start;
+
+		/* Relocated words of the function, from its beginning. */
+		size_t first = 0;
+		size_t last = file->nRelocs;
+		while (first < last) {
+			const size_t mid = first + (last - first) / 2;
+
+			if (file->relocs[mid] < offset)
+				first = mid + 1;
+			else
+				last = mid;
+		}
+
+		size_t n = 0;
+		for (last = first;
+		     last < file->nRelocs
+		     && file->relocs[last] - offset < sym.st_size;
+		     last++) {
+			if (n >= capacity) {
+				capacity = capacity <= 0 ? 64 : capacity * 2;
+				Elf32_Word * const grown = noisyRealloc(
+					relocs, capacity * sizeof(*relocs));
+				if (grown == NULL) {
+					result = -1;
+					goto end;
+				}
+
+				relocs = grown;
+			}
+
+			relocs[n] = file->relocs[last] - offset;
+			n++;
+		}
+
+		func.name = names + sym.st_name;
+		func.bytes = file->buffer + offset;
+		func.size = sym.st_size;
+		func.vaddr = vaddr;
+		func.relocs = relocs;
+		func.nRelocs = n;
+
+		result = visit(context, &func);
+		if (result != 0)
+			goto end;
+	}
+
+end:
+	free(relocs);
+	return result;
+}
+
+int elfSymFileFuncs(const struct elfSymFile * restrict file,
+		    elfSymFileVisit *visit, void *context)
+{
+	int result = 0;
+
+	for (Elf32_Half ndx = 0;
+	     result == 0 && ndx < file->ehdr->e_shnum;
+	     ndx++)
+		if (file->shdrs[ndx].sh_type == SHT_SYMTAB)
+			result = visitSymtab(file, file->shdrs + ndx,
+					     visit, context);
+
+	return result;
+}
+
+bool elfSymFileIsNamed(const char * restrict name)
+{
+	return name[0] != 0
+	       && strncmp(name, "sub_", sizeof("sub_") - 1) != 0;
+}
+
+void elfSymFileClose(struct elfSymFile * restrict file)
+{
+	free(file->relocs);
+	free((void *)file->buffer);
+}
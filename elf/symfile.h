@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ELF_SYMFILE_H
+#define ELF_SYMFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "elf.h"
+
+/* An ELF read for its symbols: a program, a relocatable object or an output
+   of vita-analyze. */
+struct elfSymFile {
+	const char *path;
+	const unsigned char *buffer;
+	size_t size;
+	const Elf32_Ehdr *ehdr;
+	const Elf32_Shdr *shdrs;
+
+	/* File offsets of words relocated by SHT_REL sections, sorted. */
+	Elf32_Off *relocs;
+	size_t nRelocs;
+};
+
+/* A sized Thumb function of .symtab. */
+struct elfSymFunc {
+	const char *name;
+	const unsigned char *bytes;
+	Elf32_Word size;
+	Elf32_Addr vaddr;
+
+	/* Offsets of relocated words from the beginning of the function. */
+	const Elf32_Word *relocs;
+	size_t nRelocs;
+};
+
+/* A nonzero return stops elfSymFileFuncs with it. */
+typedef int elfSymFileVisit(void *context,
+			    const struct elfSymFunc * restrict func);
+
+/* Returns 0 if the file is read, 1 if it is not a 32-bit ARM ELF with sections
+   and is skipped with a message, or -1 on error. */
+int elfSymFileOpen(struct elfSymFile * restrict file, const char *path);
+
+/* Visits the functions of all .symtab, except ones named by mapping
+   symbols. */
+int elfSymFileFuncs(const struct elfSymFile * restrict file,
+		    elfSymFileVisit *visit, void *context);
+
+/* Tells names which are neither placeholders of vita-analyze nor empty. */
+bool elfSymFileIsNamed(const char * restrict name);
+
+void elfSymFileClose(struct elfSymFile * restrict file);
+
+#endif
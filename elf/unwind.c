@@ -0,0 +1,381 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../noisy/lib.h"
+#include "elf.h"
+#include "exidx.h"
+#include "image.h"
+#include "unwind.h"
+
+/* The most unwind instructions an entry can have: 255 additional words
+   and the bytes of the first. */
+#define UNWIND_OPS_MAX (4 * 256)
+
+struct unwindState {
+	Elf32_Word regs[16];
+	Elf32_Addr vsp;
+	bool pcSet;
+};
+
+static int compareEntries(const void *a, const void *b)
+{
+	const struct elfUnwindEntry * const x = a;
+	const struct elfUnwindEntry * const y = b;
+
+	return x->start < y->start ? -1 : x->start > y->start;
+}
+
+int elfUnwindInit(struct elfUnwind * restrict unwind,
+		  const struct elfImage * restrict image,
+		  const struct elfImageModule * restrict modules,
+		  Elf32_Word nModules)
+{
+	unwind->image = image;
+	unwind->ends = NULL;
+	unwind->nExidxs = 0;
+	unwind->entries = NULL;
+	unwind->n = 0;
+
+	unwind->exidxs = noisyMalloc(nModules * sizeof(*unwind->exidxs));
+	if (unwind->exidxs == NULL)
+		return -1;
+
+	unwind->ends = noisyMalloc(nModules * sizeof(*unwind->ends));
+	if (unwind->ends == NULL) {
+		elfUnwindDeinit(unwind);
+		return -1;
+	}
+
+	/* A broken table only leaves its functions unknown. */
+	for (Elf32_Word ndx = 0; ndx < nModules; ndx++) {
+		struct elfExidx * const exidx
+			= unwind->exidxs + unwind->nExidxs;
+		Elf32_Word phndx;
+		Elf32_Word max;
+
+		if (!modules[ndx].found
+		    || elfExidxInitModule(exidx, image, modules + ndx) != 0
+		    || exidx->n <= 0) {
+			continue;
+		}
+
+		if (elfImageGetPhndxByVaddr(image, exidx->starts[0], 0,
+					    &phndx, &max) != 0) {
+			elfExidxDeinit(exidx);
+			continue;
+		}
+
+		unwind->ends[unwind->nExidxs] = exidx->starts[0] + max;
+		unwind->n += exidx->n;
+		unwind->nExidxs++;
+	}
+
+	unwind->entries = noisyMalloc(unwind->n * sizeof(*unwind->entries)
+				      + 1);
+	if (unwind->entries == NULL) {
+		elfUnwindDeinit(unwind);
+		return -1;
+	}
+
+	struct elfUnwindEntry *entry = unwind->entries;
+	for (Elf32_Word exidx = 0; exidx < unwind->nExidxs; exidx++) {
+		for (Elf32_Word ndx = 0; ndx < unwind->exidxs[exidx].n; ndx++) {
+			entry->start = unwind->exidxs[exidx].starts[ndx];
+			entry->exidx = exidx;
+			entry->ndx = ndx;
+			entry++;
+		}
+	}
+
+	qsort(unwind->entries, unwind->n, sizeof(*unwind->entries),
+	      compareEntries);
+
+	return 0;
+}
+
+static const struct elfUnwindEntry *findEntry(
+	const struct elfUnwind * restrict unwind, Elf32_Addr vaddr)
+{
+	Elf32_Word lo = 0;
+	Elf32_Word hi = unwind->n;
+
+	while (lo < hi) {
+		const Elf32_Word mid = lo + (hi - lo) / 2;
+
+		if (unwind->entries[mid].start <= vaddr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo <= 0)
+		return NULL;
+
+	/* The last function of a table ends with its segment, not at the
+	   first function of the next table. */
+	const struct elfUnwindEntry * const entry = unwind->entries + lo - 1;
+	return vaddr < unwind->ends[entry->exidx] ? entry : NULL;
+}
+
+static bool readWord(const struct elfImage * restrict image,
+		     Elf32_Addr vaddr, Elf32_Word * restrict word)
+{
+	const void * const p = elfImageVaddrToPtr(image, vaddr,
+						  sizeof(*word), NULL);
+	if (p == NULL)
+		return false;
+
+	memcpy(word, p, sizeof(*word));
+	return true;
+}
+
+/* Appends bytes of words at vaddr, from the most significant one. */
+static bool appendWords(const struct elfImage * restrict image,
+			Elf32_Addr vaddr, Elf32_Word n,
+			uint8_t * restrict ops, size_t * restrict nOps)
+{
+	for (Elf32_Word ndx = 0; ndx < n; ndx++) {
+		Elf32_Word word;
+
+		if (!readWord(image, vaddr + ndx * sizeof(word), &word))
+			return false;
+
+		for (int shift = 24; shift >= 0; shift -= 8)
+			ops[(*nOps)++] = word >> shift;
+	}
+
+	return true;
+}
+
+/* Collects unwind instructions of the entry. Returns 1 if the function
+   cannot be unwound. */
+static int collectOps(const struct elfImage * restrict image,
+		      const struct elfExidx * restrict exidx, Elf32_Word ndx,
+		      uint8_t * restrict ops, size_t * restrict nOps)
+{
+	const Elf32_Addr dataVaddr = elfExidxDataVaddr(exidx, ndx);
+	Elf32_Word word = exidx->entries[ndx * 2 + 1];
+	Elf32_Addr vaddr;
+
+	*nOps = 0;
+
+	if (word == ELF_EXIDX_CANTUNWIND)
+		return 1;
+
+	if ((word & 0x80000000) != 0) {
+		vaddr = dataVaddr;
+	} else {
+		vaddr = elfExidxPrel31(dataVaddr, word);
+		if (!readWord(image, vaddr, &word))
+			return -1;
+
+		/* A generic personality routine, like GCC's, is followed by
+		   the words in the format of the long compact model. */
+		if ((word & 0x80000000) == 0) {
+			vaddr += sizeof(word);
+			if (!readWord(image, vaddr, &word))
+				return -1;
+
+			ops[(*nOps)++] = word >> 16;
+			ops[(*nOps)++] = word >> 8;
+			ops[(*nOps)++] = word;
+
+			return appendWords(image, vaddr + sizeof(word),
+					   word >> 24, ops, nOps) ? 0 : -1;
+		}
+	}
+
+	switch ((word >> 24) & 0xF) {
+	case 0:
+		ops[(*nOps)++] = word >> 16;
+		ops[(*nOps)++] = word >> 8;
+		ops[(*nOps)++] = word;
+		return 0;
+
+	case 1:
+	case 2:
+		ops[(*nOps)++] = word >> 8;
+		ops[(*nOps)++] = word;
+		return appendWords(image, vaddr + sizeof(word),
+				   (word >> 16) & 0xFF, ops, nOps) ? 0 : -1;
+
+	default:
+		return -1;
+	}
+}
+
+/* Pops registers in the mask, from the lowest. */
+static bool popRegs(const struct elfImage * restrict image,
+		    struct unwindState * restrict state,
+		    Elf32_Word mask, unsigned int first)
+{
+	const bool spPopped = (mask & (1 << (ELF_UNWIND_SP - first))) != 0;
+	Elf32_Addr vsp = state->vsp;
+
+	for (unsigned int reg = first; mask != 0; reg++, mask >>= 1) {
+		if ((mask & 1) == 0)
+			continue;
+
+		if (!readWord(image, vsp, state->regs + reg))
+			return false;
+
+		vsp += sizeof(Elf32_Word);
+		if (reg == ELF_UNWIND_PC)
+			state->pcSet = true;
+	}
+
+	/* A popped SP is the new vsp. */
+	state->vsp = spPopped ? state->regs[ELF_UNWIND_SP] : vsp;
+	return true;
+}
+
+static int execute(const struct elfImage * restrict image,
+		   struct unwindState * restrict state,
+		   const uint8_t * restrict ops, size_t nOps)
+{
+	size_t ndx = 0;
+
+	while (ndx < nOps) {
+		const uint8_t op = ops[ndx++];
+		const uint8_t next = ndx < nOps ? ops[ndx] : 0;
+
+		if ((op & 0xC0) == 0x00) {
+			state->vsp += ((op & 0x3F) << 2) + 4;
+		} else if ((op & 0xC0) == 0x40) {
+			state->vsp -= ((op & 0x3F) << 2) + 4;
+		} else if ((op & 0xF0) == 0x80) {
+			const Elf32_Word mask = ((op & 0xF) << 8) | next;
+
+			ndx++;
+			if (mask == 0)
+				return -1;
+
+			if (!popRegs(image, state, mask, 4))
+				return -1;
+		} else if ((op & 0xF0) == 0x90) {
+			if ((op & 0xF) == ELF_UNWIND_SP
+			    || (op & 0xF) == ELF_UNWIND_PC)
+				return -1;
+
+			state->vsp = state->regs[op & 0xF];
+		} else if ((op & 0xF0) == 0xA0) {
+			Elf32_Word mask = (1 << ((op & 7) + 1)) - 1;
+
+			if ((op & 8) != 0)
+				mask |= 1 << (ELF_UNWIND_LR - 4);
+
+			if (!popRegs(image, state, mask, 4))
+				return -1;
+		} else if (op == 0xB0) {
+			break;
+		} else if (op == 0xB1) {
+			ndx++;
+			if (next == 0 || (next & 0xF0) != 0)
+				return -1;
+
+			if (!popRegs(image, state, next, 0))
+				return -1;
+		} else if (op == 0xB2) {
+			Elf32_Word uleb = 0;
+			unsigned int shift = 0;
+			uint8_t byte;
+
+			do {
+				if (ndx >= nOps || shift >= 32)
+					return -1;
+
+				byte = ops[ndx++];
+				uleb |= (Elf32_Word)(byte & 0x7F) << shift;
+				shift += 7;
+			} while ((byte & 0x80) != 0);
+
+			state->vsp += 0x204 + (uleb << 2);
+		} else if (op == 0xB3 || op == 0xC8 || op == 0xC9) {
+			/* VFP registers, with the format word for FSTMFDX. */
+			ndx++;
+			state->vsp += ((next & 0xF) + 1) * 8
+				      + (op == 0xB3 ? 4 : 0);
+		} else if ((op & 0xF8) == 0xB8) {
+			state->vsp += ((op & 7) + 1) * 8 + 4;
+		} else if ((op & 0xF8) == 0xD0) {
+			state->vsp += ((op & 7) + 1) * 8;
+		} else if ((op & 0xF8) == 0xC0 && op != 0xC6 && op != 0xC7) {
+			state->vsp += ((op & 7) + 1) * 8;
+		} else if (op == 0xC6) {
+			ndx++;
+			state->vsp += ((next & 0xF) + 1) * 8;
+		} else if (op == 0xC7) {
+			ndx++;
+			if (next == 0 || (next & 0xF0) != 0)
+				return -1;
+
+			for (uint8_t mask = next; mask != 0; mask >>= 1)
+				state->vsp += (mask & 1) * 4;
+		} else {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int elfUnwindStep(const struct elfUnwind * restrict unwind,
+		  Elf32_Addr vaddr, Elf32_Word * restrict regs)
+{
+	uint8_t ops[UNWIND_OPS_MAX];
+	struct unwindState state;
+	size_t nOps;
+
+	const struct elfUnwindEntry * const entry = findEntry(unwind, vaddr);
+	if (entry == NULL)
+		return 1;
+
+	const int result = collectOps(unwind->image,
+				      unwind->exidxs + entry->exidx,
+				      entry->ndx, ops, &nOps);
+	if (result != 0)
+		return result;
+
+	memcpy(state.regs, regs, sizeof(state.regs));
+	state.vsp = regs[ELF_UNWIND_SP];
+	state.pcSet = false;
+
+	if (execute(unwind->image, &state, ops, nOps) != 0)
+		return -1;
+
+	state.regs[ELF_UNWIND_SP] = state.vsp;
+	if (!state.pcSet)
+		state.regs[ELF_UNWIND_PC] = state.regs[ELF_UNWIND_LR];
+
+	memcpy(regs, state.regs, sizeof(state.regs));
+	return 0;
+}
+
+void elfUnwindDeinit(const struct elfUnwind * restrict unwind)
+{
+	for (Elf32_Word ndx = 0; ndx < unwind->nExidxs; ndx++)
+		elfExidxDeinit(unwind->exidxs + ndx);
+
+	free(unwind->exidxs);
+	free(unwind->ends);
+	free(unwind->entries);
+}
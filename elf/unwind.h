@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ELF_UNWIND_H
+#define ELF_UNWIND_H
+
+#include "elf.h"
+#include "exidx.h"
+#include "image.h"
+
+#define ELF_UNWIND_SP 13
+#define ELF_UNWIND_LR 14
+#define ELF_UNWIND_PC 15
+
+struct elfUnwindEntry {
+	Elf32_Addr start;
+	Elf32_Word exidx;
+	Elf32_Word ndx;
+};
+
+/* exidx of all modules merged into one index sorted by address. */
+struct elfUnwind {
+	const struct elfImage *image;
+	struct elfExidx *exidxs;
+
+	/* The end of the segment containing the functions of each table. */
+	Elf32_Addr *ends;
+	Elf32_Word nExidxs;
+	struct elfUnwindEntry *entries;
+	Elf32_Word n;
+};
+
+int elfUnwindInit(struct elfUnwind * restrict unwind,
+		  const struct elfImage * restrict image,
+		  const struct elfImageModule * restrict modules,
+		  Elf32_Word nModules);
+
+/* Restores the registers of the caller of the function containing vaddr,
+   with the ARM EHABI unwind instructions. Returns 1 if the function has
+   no caller to unwind to, and -1 if the frame is broken. */
+int elfUnwindStep(const struct elfUnwind * restrict unwind,
+		  Elf32_Addr vaddr, Elf32_Word * restrict regs);
+
+void elfUnwindDeinit(const struct elfUnwind * restrict unwind);
+
+#endif
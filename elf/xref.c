@@ -0,0 +1,342 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../noisy/lib.h"
+#include "../readwhole.h"
+#include "branch.h"
+#include "elf.h"
+#include "image.h"
+#include "lookup.h"
+#include "xref.h"
+
+#define XREF_FILTER_BITS 16
+
+struct xrefPair {
+	Elf32_Word target;
+	Elf32_Addr site;
+};
+
+struct xrefSweep {
+	const struct elfXref *xref;
+	uint64_t filter[(1 << XREF_FILTER_BITS) / 64];
+	struct xrefPair *pairs;
+	size_t n;
+	size_t capacity;
+};
+
+static uint32_t hashTarget(Elf32_Addr vaddr)
+{
+	return ((vaddr >> 1) * 0x9E3779B1) >> (32 - XREF_FILTER_BITS);
+}
+
+/* Returns the index of the target at vaddr, or nTargets. */
+static Elf32_Word findTarget(const struct elfXref * restrict xref,
+			     Elf32_Addr vaddr)
+{
+	Elf32_Word lo = 0;
+	Elf32_Word hi = xref->nTargets;
+
+	while (lo < hi) {
+		const Elf32_Word mid = lo + (hi - lo) / 2;
+
+		if (xref->targets[mid].vaddr < vaddr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo < xref->nTargets && xref->targets[lo].vaddr == vaddr ?
+		lo : xref->nTargets;
+}
+
+static int visitBranch(void *context, Elf32_Addr site, Elf32_Addr target,
+		       enum elfBranchKind kind)
+{
+	struct xrefSweep * const sweep = context;
+	const Elf32_Addr vaddr = target & ~(Elf32_Addr)1;
+	const uint32_t hash = hashTarget(vaddr);
+
+	(void)kind;
+
+	if ((sweep->filter[hash / 64] & (UINT64_C(1) << hash % 64)) == 0)
+		return 0;
+
+	const Elf32_Word ndx = findTarget(sweep->xref, vaddr);
+	if (ndx >= sweep->xref->nTargets)
+		return 0;
+
+	if (sweep->n >= sweep->capacity) {
+		const size_t capacity = sweep->capacity <= 0 ?
+			1024 : sweep->capacity * 2;
+		struct xrefPair * const pairs = noisyRealloc(
+			sweep->pairs, capacity * sizeof(*pairs));
+		if (pairs == NULL)
+			return -1;
+
+		sweep->pairs = pairs;
+		sweep->capacity = capacity;
+	}
+
+	sweep->pairs[sweep->n].target = ndx;
+	sweep->pairs[sweep->n].site = site;
+	sweep->n++;
+	return 0;
+}
+
+static bool isTarget(const struct elfLookupSym * restrict sym)
+{
+	return ELF32_ST_BIND(sym->info) == STB_GLOBAL
+	       && (ELF32_ST_TYPE(sym->info) == STT_FUNC
+		   || ELF32_ST_TYPE(sym->info) == STT_ARM_TFUNC);
+}
+
+/* Takes global functions of lookup, one for each address. */
+static int makeTargets(struct elfXref * restrict xref,
+		       const struct elfLookup * restrict lookup)
+{
+	Elf32_Word n = 0;
+	Elf32_Addr last = 0;
+	size_t namesSize = 0;
+
+	/* Skips symbols as the loop filling targets does. */
+	for (Elf32_Word ndx = 0; ndx < lookup->n; ndx++) {
+		const struct elfLookupSym * const sym = lookup->syms + ndx;
+
+		if (!isTarget(sym) || (n > 0 && last == sym->value))
+			continue;
+
+		namesSize += strlen(sym->name) + 1;
+		last = sym->value;
+		n++;
+	}
+
+	if (namesSize > UINT32_MAX) {
+		fputs("too many names\n", stderr);
+		return -1;
+	}
+
+	xref->targets = noisyMalloc(n * sizeof(*xref->targets) + 1);
+	if (xref->targets == NULL)
+		return -1;
+
+	xref->names = noisyMalloc(namesSize + 1);
+	if (xref->names == NULL) {
+		free(xref->targets);
+		return -1;
+	}
+
+	xref->nTargets = 0;
+	xref->namesSize = 0;
+	for (Elf32_Word ndx = 0; ndx < lookup->n; ndx++) {
+		const struct elfLookupSym * const sym = lookup->syms + ndx;
+
+		if (!isTarget(sym)
+		    || (xref->nTargets > 0
+			&& xref->targets[xref->nTargets - 1].vaddr
+			   == sym->value))
+			continue;
+
+		const size_t size = strlen(sym->name) + 1;
+		struct elfXrefTarget * const target
+			= xref->targets + xref->nTargets;
+
+		target->vaddr = sym->value;
+		target->name = xref->namesSize;
+		target->first = 0;
+		target->n = 0;
+		memcpy(xref->names + xref->namesSize, sym->name, size);
+		xref->namesSize += size;
+		xref->nTargets++;
+	}
+
+	return 0;
+}
+
+int elfXrefInit(struct elfXref * restrict xref,
+		const struct elfImage * restrict image,
+		const struct elfLookup * restrict lookup, unsigned int sets)
+{
+	struct xrefSweep sweep = { .xref = xref, .pairs = NULL,
+				   .n = 0, .capacity = 0 };
+
+	if (makeTargets(xref, lookup) != 0)
+		return -1;
+
+	memset(sweep.filter, 0, sizeof(sweep.filter));
+	for (Elf32_Word ndx = 0; ndx < xref->nTargets; ndx++) {
+		const uint32_t hash = hashTarget(xref->targets[ndx].vaddr);
+
+		sweep.filter[hash / 64] |= UINT64_C(1) << hash % 64;
+	}
+
+	if (elfBranchSweep(image, sets, visitBranch, &sweep) != 0)
+		goto fail;
+
+	if (sweep.n > UINT32_MAX) {
+		fputs("too many branches\n", stderr);
+		goto fail;
+	}
+
+	xref->sites = noisyMalloc(sweep.n * sizeof(*xref->sites) + 1);
+	if (xref->sites == NULL)
+		goto fail;
+
+	xref->nSites = sweep.n;
+
+	/* Counting sort by target keeps sites in the order of addresses. */
+	for (size_t ndx = 0; ndx < sweep.n; ndx++)
+		xref->targets[sweep.pairs[ndx].target].n++;
+
+	Elf32_Word first = 0;
+	for (Elf32_Word ndx = 0; ndx < xref->nTargets; ndx++) {
+		xref->targets[ndx].first = first;
+		first += xref->targets[ndx].n;
+		xref->targets[ndx].n = 0;
+	}
+
+	for (size_t ndx = 0; ndx < sweep.n; ndx++) {
+		struct elfXrefTarget * const target
+			= xref->targets + sweep.pairs[ndx].target;
+
+		xref->sites[target->first + target->n] = sweep.pairs[ndx].site;
+		target->n++;
+	}
+
+	free(sweep.pairs);
+	return 0;
+
+fail:
+	free(sweep.pairs);
+	free(xref->names);
+	free(xref->targets);
+	return -1;
+}
+
+int elfXrefWrite(const struct elfXref * restrict xref, FILE * restrict fp)
+{
+	struct elfXrefHeader header;
+
+	const uint64_t names = sizeof(header)
+			       + (uint64_t)xref->nTargets
+				 * sizeof(*xref->targets)
+			       + (uint64_t)xref->nSites * sizeof(*xref->sites);
+	if (names > UINT32_MAX) {
+		fputs("too large xref index\n", stderr);
+		return -1;
+	}
+
+	memcpy(header.magic, ELF_XREF_MAGIC, sizeof(header.magic));
+	header.nTargets = xref->nTargets;
+	header.nSites = xref->nSites;
+	header.names = names;
+
+	if (fwrite(&header, sizeof(header), 1, fp) != 1
+	    || fwrite(xref->targets, sizeof(*xref->targets),
+		      xref->nTargets, fp) != xref->nTargets
+	    || fwrite(xref->sites, sizeof(*xref->sites),
+		      xref->nSites, fp) != xref->nSites
+	    || fwrite(xref->names, 1, xref->namesSize, fp)
+	       != xref->namesSize) {
+		perror(NULL);
+		return -1;
+	}
+
+	return 0;
+}
+
+static bool isNamed(const char * restrict name,
+		    const char * const * restrict names, size_t n)
+{
+	if (n <= 0)
+		return true;
+
+	for (size_t ndx = 0; ndx < n; ndx++)
+		if (strcmp(name, names[ndx]) == 0)
+			return true;
+
+	return false;
+}
+
+int elfXrefPrint(const char * restrict path,
+		 const char * const * restrict names, size_t n)
+{
+	const struct elfXrefHeader *header;
+	size_t size;
+
+	char * const buffer = readWhole(path, &size);
+	if (buffer == NULL)
+		return -1;
+
+	header = (void *)buffer;
+	if (size < sizeof(*header)
+	    || memcmp(header->magic, ELF_XREF_MAGIC,
+		      sizeof(header->magic)) != 0
+	    || header->nTargets > (size - sizeof(*header))
+				  / sizeof(struct elfXrefTarget)
+	    || header->nSites > (size - sizeof(*header)
+				 - header->nTargets
+				   * sizeof(struct elfXrefTarget))
+				/ sizeof(uint32_t)
+	    || header->names != sizeof(*header)
+				+ header->nTargets
+				  * sizeof(struct elfXrefTarget)
+				+ header->nSites * sizeof(uint32_t)
+	    || (header->names < size && buffer[size - 1] != 0))
+		goto failFormat;
+
+	const struct elfXrefTarget * const targets = (void *)(header + 1);
+	const uint32_t * const sites = (void *)(targets + header->nTargets);
+	const char * const strings = buffer + header->names;
+	const size_t stringsSize = size - header->names;
+
+	for (uint32_t ndx = 0; ndx < header->nTargets; ndx++) {
+		const struct elfXrefTarget * const target = targets + ndx;
+
+		if (target->name >= stringsSize
+		    || target->first > header->nSites
+		    || target->n > header->nSites - target->first)
+			goto failFormat;
+
+		if (!isNamed(strings + target->name, names, n))
+			continue;
+
+		printf("0x%08X %s\n", target->vaddr, strings + target->name);
+		for (uint32_t site = 0; site < target->n; site++)
+			printf("  0x%08X\n", sites[target->first + site]);
+	}
+
+	free(buffer);
+	return 0;
+
+failFormat:
+	fprintf(stderr, "%s: not an xref index\n", path);
+	free(buffer);
+	return -1;
+}
+
+void elfXrefDeinit(const struct elfXref * restrict xref)
+{
+	free(xref->sites);
+	free(xref->names);
+	free(xref->targets);
+}
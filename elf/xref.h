@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ELF_XREF_H
+#define ELF_XREF_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "elf.h"
+#include "image.h"
+#include "lookup.h"
+
+#define ELF_XREF_MAGIC "XREFIDX1"
+
+/* The index file is the header, the targets sorted by address, the sites
+   grouped by target and the names, all in the byte order of the host. */
+struct elfXrefHeader {
+	char magic[8];
+	uint32_t nTargets;
+	uint32_t nSites;
+	uint32_t names;
+};
+
+struct elfXrefTarget {
+	uint32_t vaddr;
+
+	/* The offset of the name from the beginning of names. */
+	uint32_t name;
+
+	/* The range of the sites calling or jumping to this. */
+	uint32_t first;
+	uint32_t n;
+};
+
+struct elfXref {
+	struct elfXrefTarget *targets;
+	Elf32_Word nTargets;
+
+	/* Sites of Thumb code have the Thumb bit. */
+	Elf32_Addr *sites;
+	Elf32_Word nSites;
+
+	char *names;
+	Elf32_Word namesSize;
+};
+
+/* Collects branches to global functions of lookup, i.e. exports and import
+   stubs, with elfBranchSweep. */
+int elfXrefInit(struct elfXref * restrict xref,
+		const struct elfImage * restrict image,
+		const struct elfLookup * restrict lookup, unsigned int sets);
+
+int elfXrefWrite(const struct elfXref * restrict xref, FILE * restrict fp);
+
+/* Prints sites of the named targets in an index file, or of all of them if
+   there is no name. */
+int elfXrefPrint(const char * restrict path,
+		 const char * const * restrict names, size_t n);
+
+void elfXrefDeinit(const struct elfXref * restrict xref);
+
+#endif
@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "elf/driver.h"
+#include "elf/elf.h"
+#include "elf/image.h"
+#include "elf/index.h"
+#include "elf/info.h"
+#include "elf/lookup.h"
+#include "noisy/lib.h"
+#include "libvita-analyze.h"
+
+#define VITA_ANALYZE_NAME_SIZE sizeof(((SceModuleInfo *)NULL)->name)
+
+struct vitaAnalyze {
+	struct elf elf;
+	struct elfLookup lookup;
+	struct elfIndex index;
+
+	/* The module of each symbol of the lookup, or NULL. */
+	const char **symModules;
+
+	/* Names of modules, terminated with NUL. */
+	char (*names)[VITA_ANALYZE_NAME_SIZE + 1];
+};
+
+/* Names each symbol with the module whose segment with SceModuleInfo
+   contains it. */
+static int makeSymModules(struct vitaAnalyze * restrict context)
+{
+	const struct elf * const elf = &context->elf;
+	Elf32_Word *phndxs;
+
+	context->names = noisyMalloc(elf->nModules * sizeof(*context->names)
+				     + 1);
+	if (context->names == NULL)
+		return -1;
+
+	phndxs = noisyMalloc(elf->nModules * sizeof(*phndxs) + 1);
+	if (phndxs == NULL)
+		goto failPhndxs;
+
+	context->symModules = noisyMalloc(context->lookup.n
+					  * sizeof(*context->symModules)
+					  + 1);
+	if (context->symModules == NULL)
+		goto failSymModules;
+
+	for (Elf32_Word ndx = 0; ndx < elf->nModules; ndx++) {
+		const struct elfImageModule * const module = elf->modules + ndx;
+		const size_t size = module->found ?
+			strnlen(module->name, VITA_ANALYZE_NAME_SIZE) : 0;
+
+		if (size > 0)
+			memcpy(context->names[ndx], module->name, size);
+
+		context->names[ndx][size] = 0;
+
+		if (!module->found
+		    || elfImageGetPhndxByVaddr(&elf->source, module->base, 0,
+					       phndxs + ndx, NULL) != 0)
+			phndxs[ndx] = UINT32_MAX;
+	}
+
+	for (Elf32_Word sym = 0; sym < context->lookup.n; sym++) {
+		Elf32_Word phndx;
+
+		context->symModules[sym] = NULL;
+		if (elfImageGetPhndxByVaddr(&elf->source,
+					    context->lookup.syms[sym].value, 0,
+					    &phndx, NULL) != 0)
+			continue;
+
+		for (Elf32_Word ndx = 0; ndx < elf->nModules; ndx++)
+			if (phndxs[ndx] == phndx) {
+				context->symModules[sym] = context->names[ndx];
+				break;
+			}
+	}
+
+	free(phndxs);
+	return 0;
+
+failSymModules:
+	free(phndxs);
+failPhndxs:
+	free(context->names);
+	return -1;
+}
+
+int vitaAnalyzeOpen(struct vitaAnalyze **context, const char *dump,
+		    const char * const *infos, unsigned int nInfos)
+{
+	*context = noisyMalloc(sizeof(**context));
+	if (*context == NULL)
+		return -1;
+
+	if (elfInit(&(*context)->elf, dump) != 0)
+		goto failElfInit;
+
+	if (elfMakeSections(&(*context)->elf, infos, nInfos) != 0)
+		goto failElfMakeSections;
+
+	if (elfLookupInitElf(&(*context)->lookup, &(*context)->elf) != 0)
+		goto failElfMakeSections;
+
+	if (elfIndexInit(&(*context)->index, &(*context)->lookup) != 0)
+		goto failIndex;
+
+	if (makeSymModules(*context) != 0)
+		goto failSymModules;
+
+	return 0;
+
+failSymModules:
+	elfIndexDeinit(&(*context)->index);
+failIndex:
+	elfLookupDeinit(&(*context)->lookup);
+failElfMakeSections:
+	elfDeinit(&(*context)->elf);
+failElfInit:
+	free(*context);
+	*context = NULL;
+	return -1;
+}
+
+int vitaAnalyzeLookup(const struct vitaAnalyze *context, uint32_t vaddr,
+		      struct vitaAnalyzeSymbol *symbol)
+{
+	const struct elfLookupSym * const sym = elfIndexFindSym(
+		&context->index, &context->lookup, vaddr);
+	if (sym == NULL)
+		return -1;
+
+	symbol->name = sym->name;
+	symbol->offset = vaddr - sym->value;
+	symbol->module = context->symModules[sym - context->lookup.syms];
+	return 0;
+}
+
+void vitaAnalyzeClose(struct vitaAnalyze *context)
+{
+	if (context == NULL)
+		return;
+
+	free(context->symModules);
+	free(context->names);
+	elfIndexDeinit(&context->index);
+	elfLookupDeinit(&context->lookup);
+	elfDeinit(&context->elf);
+	free(context);
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBVITA_ANALYZE_H
+#define LIBVITA_ANALYZE_H
+
+#include <stdint.h>
+
+/* The library hides every other symbol. */
+#define VITA_ANALYZE_API __attribute__((visibility("default")))
+
+/* A dump with the symbols vita-analyze would write for it. */
+struct vitaAnalyze;
+
+struct vitaAnalyzeSymbol {
+	const char *name;
+
+	/* From the beginning of the symbol. */
+	uint32_t offset;
+
+	/* The module whose segment with SceModuleInfo contains the symbol, or
+	   NULL. */
+	const char *module;
+};
+
+/* Reads the dump and makes the symbols for the modules in infos, INFO.BIN
+   files or directories of them, or in the dump as the command line does
+   without them. Returns 0 on success. */
+VITA_ANALYZE_API int vitaAnalyzeOpen(struct vitaAnalyze **context,
+				     const char *dump,
+				     const char * const *infos,
+				     unsigned int nInfos);
+
+/* Finds the symbol containing vaddr, or the nearest one before it if its
+   size is unknown. Returns 0 if there is one, or -1. Any number of threads
+   may look up at once. Strings live until vitaAnalyzeClose. */
+VITA_ANALYZE_API int vitaAnalyzeLookup(const struct vitaAnalyze *context,
+				       uint32_t vaddr,
+				       struct vitaAnalyzeSymbol *symbol);
+
+VITA_ANALYZE_API void vitaAnalyzeClose(struct vitaAnalyze *context);
+
+#endif
@@ -15,37 +15,131 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define _POSIX_C_SOURCE 200809L
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "command/batch.h"
+#include "command/callgraph.h"
+#include "command/crack.h"
+#include "command/hooks.h"
+#include "command/mksig.h"
+#include "command/nidtable.h"
+#include "command/port.h"
+#include "command/symbolize.h"
+#include "command/unwind.h"
+#include "command/update.h"
+#include "command/xref.h"
 #include "elf/driver.h"
 
+static const struct {
+	const char *name;
+	int (* main)(int argc, char *argv[]);
+} commands[] = {
+	{ "batch", batchMain },
+	{ "build-nidtable", nidtableMain },
+	{ "callgraph", callgraphMain },
+	{ "crack", crackMain },
+	{ "hooks", hooksMain },
+	{ "mksig", mksigMain },
+	{ "port-symbols", portMain },
+	{ "symbolize", symbolizeMain },
+	{ "unwind", unwindMain },
+	{ "update", updateMain },
+	{ "xref", xrefMain }
+};
+
 int main(int argc, char *argv[])
 {
 	struct elf elf;
+	bool pipelined = false;
+	bool split = false;
+	int opt;
+
+	if (argc > 1)
+		for (size_t ndx = 0;
+		     ndx < sizeof(commands) / sizeof(*commands);
+		     ndx++)
+			if (strcmp(argv[1], commands[ndx].name) == 0)
+				return commands[ndx].main(argc, argv);
+
+	while ((opt = getopt(argc, argv, "dp")) != -1) {
+		switch (opt) {
+		case 'd':
+			split = true;
+			break;
+
+		case 'p':
+			pipelined = true;
+			break;
 
-	if (argc != 3)
+		default:
+			goto failInval;
+		}
+	}
+
+	if (argc - optind < 1 || (split && pipelined))
 		goto failInval;
 
-	if (elfInit(&elf, argv[1]) != 0)
+	const char * const dumpPath = argv[optind];
+	const char * const * const infoPaths
+		= (const char * const *)argv + optind + 1;
+	const Elf32_Word nInfos = argc - optind - 1;
+
+	if (elfInit(&elf, dumpPath) != 0)
 		goto failElfInit;
 
-	if (elfMakeSections(&elf, argv[2]) != 0)
-		goto failElfMakeSections;
+	if (pipelined) {
+		if (elfWritePipelined(&elf, infoPaths, nInfos) != 0)
+			goto failElfWrite;
+	} else {
+		if (elfMakeSections(&elf, infoPaths, nInfos) != 0)
+			goto failElfMakeSections;
 
-	if (elfWrite(&elf) != 0)
-		goto failElfWrite;
+		if ((split ? elfWriteSplit(&elf) : elfWrite(&elf)) != 0)
+			goto failElfWrite;
+	}
 
 	elfDeinit(&elf);
 	return EXIT_SUCCESS;
 
 failInval:
-	fprintf(stderr, "usage: %s <DUMP.ELF> <INFO.BIN>\n"
+	fprintf(stderr, "usage: %s [-d | -p] <DUMP.ELF> [<INFO.BIN | DIRECTORY>...]\n"
+		"       %s batch <DUMP.ELF> <INFO.BIN> <OUTPUT>...\n"
+		"       %s build-nidtable [-o TABLE] [-s SUFFIX]... <CORPUS>...\n"
+		"       %s callgraph [-a] [-b] [-o OUTPUT] <DUMP.ELF> [<INFO.BIN | DIRECTORY>...]\n"
+		"       %s crack [-s SUFFIX]... [-w WORDLIST]... <DUMP.ELF> [<INFO.BIN | DIRECTORY>...]\n"
+		"       %s hooks [-e] <DUMP.ELF> [<INFO.BIN | DIRECTORY>...]\n"
+		"       %s mksig [-o SIGNATURES] <ELF>...\n"
+		"       %s port-symbols [-t THRESHOLD] <OLD.ELF> <DUMP.ELF> [<INFO.BIN | DIRECTORY>...]\n"
+		"       %s symbolize <DUMP.ELF> [<INFO.BIN | DIRECTORY>...] < <LOG> > <OUTPUT>\n"
+		"       %s update <OUTPUT.ELF> [<INFO.BIN | DIRECTORY>...]...\n"
+		"       %s unwind <DUMP.ELF> [<INFO.BIN | DIRECTORY>...]\n"
+		"       %s xref [-a] [-o INDEX] <DUMP.ELF> [<INFO.BIN | DIRECTORY>...]\n"
+		"       %s xref -l <INDEX> [NAME]...\n"
+		"\n"
+		"  -d  write only symbols, linked to DUMP.ELF with .gnu_debuglink\n"
+		"  -p  write the dump while symbols are being resolved\n"
 		"\n"
 		"Copyright (C) 2016  173210 <root.3.173210@live.com>\n"
 		"\n"
 		"This program comes with ABSOLUTELY NO WARRANTY.\n"
 		"This is free software, and you are welcome to redistribute it "
 		"under certain conditions; see LICENSE for details.\n",
+		argc > 0 ? argv[0] : "<EXECUTABLE>",
+		argc > 0 ? argv[0] : "<EXECUTABLE>",
+		argc > 0 ? argv[0] : "<EXECUTABLE>",
+		argc > 0 ? argv[0] : "<EXECUTABLE>",
+		argc > 0 ? argv[0] : "<EXECUTABLE>",
+		argc > 0 ? argv[0] : "<EXECUTABLE>",
+		argc > 0 ? argv[0] : "<EXECUTABLE>",
+		argc > 0 ? argv[0] : "<EXECUTABLE>",
+		argc > 0 ? argv[0] : "<EXECUTABLE>",
+		argc > 0 ? argv[0] : "<EXECUTABLE>",
+		argc > 0 ? argv[0] : "<EXECUTABLE>",
+		argc > 0 ? argv[0] : "<EXECUTABLE>",
 		argc > 0 ? argv[0] : "<EXECUTABLE>");
 
 	return EXIT_FAILURE;
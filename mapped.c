@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "noisy/fcntl.h"
+#include "noisy/mman.h"
+#include "mapped.h"
+
+int mappedOpen(struct mapped * restrict mapped, const char * restrict path,
+	       const char * restrict magic, size_t recordSize,
+	       const char * restrict what)
+{
+	const struct mappedHeader *header;
+	struct stat st;
+
+	mapped->map = NULL;
+	mapped->size = 0;
+	mapped->records = NULL;
+	mapped->n = 0;
+	mapped->names = NULL;
+	mapped->namesSize = 0;
+
+	if (path == NULL || (stat(path, &st) != 0 && errno == ENOENT))
+		return 0;
+
+	struct noisyFile * const file = noisyOpen(path, O_RDONLY);
+	if (file == NULL)
+		return -1;
+
+	const off_t size = noisyLseek(file, 0, SEEK_END);
+	if (size < 0)
+		goto failSeek;
+
+	if ((size_t)size < sizeof(*header))
+		goto failFormat;
+
+	mapped->map = noisyMmap(file, size);
+	if (mapped->map == NULL)
+		goto failSeek;
+
+	mapped->size = size;
+	header = mapped->map;
+
+	/* Names must end with NUL so that none runs out of the map. */
+	if (memcmp(header->magic, magic, sizeof(header->magic)) != 0
+	    || header->n > (size - sizeof(*header)) / recordSize
+	    || header->names < sizeof(*header) + header->n * recordSize
+	    || header->names > size
+	    || (header->names < size
+		&& ((char *)mapped->map)[size - 1] != 0))
+		goto failMap;
+
+	mapped->records = header + 1;
+	mapped->n = header->n;
+	mapped->names = (char *)mapped->map + header->names;
+	mapped->namesSize = size - header->names;
+
+	noisyClose(file);
+	return 0;
+
+failMap:
+	noisyMunmap(mapped->map, size);
+	mapped->map = NULL;
+	mapped->size = 0;
+failFormat:
+	fprintf(stderr, "%s: not a %s\n", path, what);
+failSeek:
+	noisyClose(file);
+	return -1;
+}
+
+void mappedClose(const struct mapped * restrict mapped)
+{
+	if (mapped->map != NULL)
+		noisyMunmap(mapped->map, mapped->size);
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAPPED_H
+#define MAPPED_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* The file is the header, n records of a fixed size and the names, all in
+   the byte order of the host. */
+struct mappedHeader {
+	char magic[8];
+	uint32_t n;
+
+	/* The offset of the names from the beginning of the file. */
+	uint32_t names;
+};
+
+/* A table mapped from a file. */
+struct mapped {
+	void *map;
+	size_t size;
+	const void *records;
+	uint32_t n;
+	const char *names;
+	uint32_t namesSize;
+};
+
+/* Maps the file if it has magic and its records and names are within it.
+   A missing file is taken as an empty table. what names the format in the
+   error. */
+int mappedOpen(struct mapped * restrict mapped, const char * restrict path,
+	       const char * restrict magic, size_t recordSize,
+	       const char * restrict what);
+
+void mappedClose(const struct mapped * restrict mapped);
+
+#endif
@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <ctype.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../noisy/lib.h"
+#include "../pool.h"
+#include "crack.h"
+#include "set.h"
+#include "sha1.h"
+
+/* The number of words a worker takes at once. */
+#define CRACK_CHUNK 256
+
+/* Longer candidates are not function names. */
+#define CRACK_NAME_MAX 255
+
+const char * const nidCrackPrefixes[NID_CRACK_PREFIXES] = {
+	"", "sce", "sceKernel", "ksce", "ksceKernel", "_sce"
+};
+
+const char * const nidCrackSuffixes[NID_CRACK_SUFFIXES] = {
+	"", "ForDriver", "ForUser", "ForKernel", "Internal"
+};
+
+struct crackPool {
+	pthread_mutex_t lock;
+	struct nidCrack *crack;
+	size_t capacity;
+	size_t next;
+	int result;
+};
+
+/* Candidates waiting to be hashed together. */
+struct crackLanes {
+	char messages[NID_SHA1_LANES][NID_SHA1_BLOCK_MAX + 1];
+	size_t sizes[NID_SHA1_LANES];
+	size_t nameSizes[NID_SHA1_LANES];
+	unsigned int n;
+	uint64_t hashes;
+};
+
+static int addHit(struct crackPool * restrict pool, uint32_t nid,
+		  const char * restrict name, size_t size)
+{
+	struct nidCrack * const crack = pool->crack;
+	int result = 0;
+
+	pthread_mutex_lock(&pool->lock);
+
+	for (size_t ndx = 0; ndx < crack->nHits; ndx++)
+		if (crack->hits[ndx].nid == nid
+		    && strncmp(crack->hits[ndx].name, name, size) == 0
+		    && crack->hits[ndx].name[size] == 0)
+			goto unlock;
+
+	if (crack->nHits >= pool->capacity) {
+		const size_t capacity = pool->capacity <= 0 ?
+			16 : pool->capacity * 2;
+		struct nidCrackHit * const hits = noisyRealloc(
+			crack->hits, capacity * sizeof(*hits));
+		if (hits == NULL)
+			goto fail;
+
+		crack->hits = hits;
+		pool->capacity = capacity;
+	}
+
+	char * const copy = noisyMalloc(size + 1);
+	if (copy == NULL)
+		goto fail;
+
+	memcpy(copy, name, size);
+	copy[size] = 0;
+	crack->hits[crack->nHits].nid = nid;
+	crack->hits[crack->nHits].name = copy;
+	crack->nHits++;
+	goto unlock;
+
+fail:
+	result = -1;
+	pool->result = -1;
+unlock:
+	pthread_mutex_unlock(&pool->lock);
+	return result;
+}
+
+static int flushLanes(struct crackPool * restrict pool,
+		      struct crackLanes * restrict lanes)
+{
+	const char *messages[NID_SHA1_LANES];
+	uint32_t nids[NID_SHA1_LANES];
+
+	/* Idle lanes hash an empty message and are ignored. */
+	for (unsigned int ndx = 0; ndx < NID_SHA1_LANES; ndx++) {
+		messages[ndx] = lanes->messages[ndx];
+		if (ndx >= lanes->n)
+			lanes->sizes[ndx] = 0;
+	}
+
+	nidSha1Lanes(messages, lanes->sizes, nids);
+	lanes->hashes += lanes->n;
+
+	for (unsigned int ndx = 0; ndx < lanes->n; ndx++)
+		if (nidSetHas(pool->crack->targets, nids[ndx])
+		    && addHit(pool, nids[ndx], lanes->messages[ndx],
+			      lanes->nameSizes[ndx]) != 0)
+			return -1;
+
+	lanes->n = 0;
+	return 0;
+}
+
+/* Hashes name with every suffix of the library. name is NUL-terminated. */
+static int tryName(struct crackPool * restrict pool,
+		   struct crackLanes * restrict lanes,
+		   const char * restrict name, size_t size)
+{
+	const struct nidCrack * const crack = pool->crack;
+
+	for (size_t ndx = 0; ndx < crack->nSuffixes; ndx++) {
+		const char * const suffix = crack->suffixes[ndx];
+		const size_t suffixSize = strlen(suffix);
+
+		if (size + suffixSize > NID_SHA1_BLOCK_MAX) {
+			const uint32_t nid = nidHash(name, suffix);
+
+			lanes->hashes++;
+			if (nidSetHas(crack->targets, nid)
+			    && addHit(pool, nid, name, size) != 0)
+				return -1;
+
+			continue;
+		}
+
+		char * const message = lanes->messages[lanes->n];
+		memcpy(message, name, size);
+		memcpy(message + size, suffix, suffixSize);
+		lanes->sizes[lanes->n] = size + suffixSize;
+		lanes->nameSizes[lanes->n] = size;
+		lanes->n++;
+
+		if (lanes->n >= NID_SHA1_LANES && flushLanes(pool, lanes) != 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+static int tryWord(struct crackPool * restrict pool,
+		   struct crackLanes * restrict lanes,
+		   const struct nidCrackWord * restrict word)
+{
+	char name[CRACK_NAME_MAX + 1];
+
+	for (size_t prefixNdx = 0; prefixNdx < NID_CRACK_PREFIXES;
+	     prefixNdx++) {
+		const char * const prefix = nidCrackPrefixes[prefixNdx];
+		const size_t prefixSize = strlen(prefix);
+
+		for (size_t suffixNdx = 0; suffixNdx < NID_CRACK_SUFFIXES;
+		     suffixNdx++) {
+			const char * const suffix = nidCrackSuffixes[suffixNdx];
+			const size_t suffixSize = strlen(suffix);
+			const size_t size = prefixSize + word->size
+					    + suffixSize;
+
+			if (word->size <= 0 || size > CRACK_NAME_MAX)
+				continue;
+
+			memcpy(name, prefix, prefixSize);
+			memcpy(name + prefixSize, word->string, word->size);
+			memcpy(name + prefixSize + word->size,
+			       suffix, suffixSize);
+			name[size] = 0;
+
+			/* sce + ioOpen is sceIoOpen. */
+			if (prefixSize > 0)
+				name[prefixSize] = toupper(
+					(unsigned char)name[prefixSize]);
+
+			if (tryName(pool, lanes, name, size) != 0)
+				return -1;
+		}
+	}
+
+	return 0;
+}
+
+static void *crackWorker(void *p)
+{
+	struct crackPool * const pool = p;
+	const struct nidCrack * const crack = pool->crack;
+	struct crackLanes lanes;
+
+	lanes.n = 0;
+	lanes.hashes = 0;
+
+	while (true) {
+		pthread_mutex_lock(&pool->lock);
+		const size_t top = pool->next;
+		const bool failed = pool->result != 0;
+		if (top < crack->nWords)
+			pool->next = crack->nWords - top < CRACK_CHUNK ?
+				crack->nWords : top + CRACK_CHUNK;
+		const size_t btm = pool->next;
+		pthread_mutex_unlock(&pool->lock);
+
+		if (failed || top >= crack->nWords)
+			break;
+
+		for (size_t ndx = top; ndx < btm; ndx++)
+			if (tryWord(pool, &lanes, crack->words + ndx) != 0)
+				goto fail;
+	}
+
+	if (lanes.n > 0)
+		flushLanes(pool, &lanes);
+
+fail:
+	pthread_mutex_lock(&pool->lock);
+	pool->crack->hashes += lanes.hashes;
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+int nidCrackRun(struct nidCrack * restrict crack)
+{
+	struct crackPool pool = { PTHREAD_MUTEX_INITIALIZER, crack, 0, 0, 0 };
+
+	crack->hits = NULL;
+	crack->nHits = 0;
+	crack->hashes = 0;
+
+	const size_t workers = poolWorkers();
+	const size_t chunks = (crack->nWords + CRACK_CHUNK - 1) / CRACK_CHUNK;
+
+	poolSpawn(crackWorker, &pool, 0,
+		  chunks <= 1 ? 1 : chunks < workers ? chunks : workers);
+
+	if (pool.result != 0) {
+		nidCrackDeinit(crack);
+		return -1;
+	}
+
+	return 0;
+}
+
+void nidCrackDeinit(const struct nidCrack * restrict crack)
+{
+	for (size_t ndx = 0; ndx < crack->nHits; ndx++)
+		free(crack->hits[ndx].name);
+
+	free(crack->hits);
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NID_CRACK_H
+#define NID_CRACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "set.h"
+
+/* A word is not NUL-terminated so that it can point into a dump. */
+struct nidCrackWord {
+	const char *string;
+	size_t size;
+};
+
+#define NID_CRACK_PREFIXES 6
+#define NID_CRACK_SUFFIXES 5
+
+/* What is tried before and after every word. The first ones are empty. */
+extern const char * const nidCrackPrefixes[NID_CRACK_PREFIXES];
+extern const char * const nidCrackSuffixes[NID_CRACK_SUFFIXES];
+
+struct nidCrackHit {
+	uint32_t nid;
+	char *name;
+};
+
+struct nidCrack {
+	/* Only candidates hashing to these are reported. */
+	const struct nidSet *targets;
+
+	const struct nidCrackWord *words;
+	size_t nWords;
+
+	/* Appended to every candidate before hashing. */
+	const char * const *suffixes;
+	size_t nSuffixes;
+
+	struct nidCrackHit *hits;
+	size_t nHits;
+	uint64_t hashes;
+};
+
+/* Hashes every word with the conventional prefixes and suffixes of
+   function names on all processors, and collects hits with their names
+   deduplicated. */
+int nidCrackRun(struct nidCrack * restrict crack);
+
+void nidCrackDeinit(const struct nidCrack * restrict crack);
+
+#endif
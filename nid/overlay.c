@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <sys/stat.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../noisy/lib.h"
+#include "../readwhole.h"
+#include "overlay.h"
+#include "path.h"
+
+char *nidOverlayPath(void)
+{
+	return nidPath("VITA_ANALYZE_NIDS", "nids.txt");
+}
+
+static int compareEntries(const void *a, const void *b)
+{
+	const struct nidOverlayEntry * const x = a;
+	const struct nidOverlayEntry * const y = b;
+
+	return x->nid < y->nid ? -1 : x->nid > y->nid;
+}
+
+int nidOverlayLoad(struct nidOverlay * restrict overlay,
+		   const char * restrict path)
+{
+	struct stat st;
+	size_t size;
+
+	overlay->entries = NULL;
+	overlay->n = 0;
+	overlay->buffer = NULL;
+
+	if (path == NULL || (stat(path, &st) != 0 && errno == ENOENT))
+		return 0;
+
+	char * const buffer = readWhole(path, &size);
+	if (buffer == NULL)
+		return -1;
+
+	/* Lines are terminated in place, so the last one needs a byte. */
+	overlay->buffer = noisyRealloc(buffer, size + 1);
+	if (overlay->buffer == NULL) {
+		free(buffer);
+		return -1;
+	}
+
+	overlay->buffer[size] = '\n';
+
+	size_t lines = 0;
+	for (size_t ndx = 0; ndx <= size; ndx++)
+		lines += overlay->buffer[ndx] == '\n';
+
+	overlay->entries = noisyMalloc(lines * sizeof(*overlay->entries));
+	if (overlay->entries == NULL) {
+		free(overlay->buffer);
+		return -1;
+	}
+
+	for (char *line = overlay->buffer;
+	     line <= overlay->buffer + size; ) {
+		char * const end = memchr(line, '\n',
+					  overlay->buffer + size + 1 - line);
+		char *name;
+
+		*end = '\0';
+		if (end > line && end[-1] == '\r')
+			end[-1] = '\0';
+
+		const unsigned long nid = strtoul(line, &name, 16);
+		if (name != line && *name == ' ' && name[1] != '\0'
+		    && name[1] != ' ') {
+			char * const space = strchr(name + 1, ' ');
+			if (space != NULL)
+				*space = '\0';
+
+			overlay->entries[overlay->n].nid = nid;
+			overlay->entries[overlay->n].name = name + 1;
+			overlay->n++;
+		}
+
+		line = end + 1;
+	}
+
+	qsort(overlay->entries, overlay->n, sizeof(*overlay->entries),
+	      compareEntries);
+
+	return 0;
+}
+
+const char *nidOverlayFind(const struct nidOverlay * restrict overlay,
+			   uint32_t nid)
+{
+	const struct nidOverlayEntry key = { nid, NULL };
+
+	if (overlay->n <= 0)
+		return NULL;
+
+	const struct nidOverlayEntry * const entry
+		= bsearch(&key, overlay->entries, overlay->n,
+			  sizeof(*overlay->entries), compareEntries);
+
+	return entry == NULL ? NULL : entry->name;
+}
+
+int nidOverlayAppend(const char * restrict path,
+		     uint32_t nid, const char * restrict name)
+{
+	FILE * const file = fopen(path, "a");
+	if (file == NULL) {
+		perror(path);
+		return -1;
+	}
+
+	int result = fprintf(file, "0x%08X %s\n", nid, name) < 0 ? -1 : 0;
+	if (fclose(file) != 0)
+		result = -1;
+
+	if (result != 0)
+		perror(path);
+
+	return result;
+}
+
+void nidOverlayDeinit(const struct nidOverlay * restrict overlay)
+{
+	free(overlay->entries);
+	free(overlay->buffer);
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NID_OVERLAY_H
+#define NID_OVERLAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct nidOverlayEntry {
+	uint32_t nid;
+	const char *name;
+};
+
+/* Names of NIDs found locally, for example by crack, which the database
+   doesn't know. The file has a line of "0xNID NAME" for each NID; anything
+   after the name is ignored. */
+struct nidOverlay {
+	struct nidOverlayEntry *entries;
+	size_t n;
+	char *buffer;
+};
+
+/* Returns the path of the overlay, VITA_ANALYZE_NIDS or
+   $VITASDK/share/nids.txt, which must be freed. */
+char *nidOverlayPath(void);
+
+/* Loads the overlay. A missing file is an empty overlay. */
+int nidOverlayLoad(struct nidOverlay * restrict overlay,
+		   const char * restrict path);
+
+const char *nidOverlayFind(const struct nidOverlay * restrict overlay,
+			   uint32_t nid);
+
+/* Adds a NID to the file. */
+int nidOverlayAppend(const char * restrict path,
+		     uint32_t nid, const char * restrict name);
+
+void nidOverlayDeinit(const struct nidOverlay * restrict overlay);
+
+#endif
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../noisy/lib.h"
+#include "path.h"
+
+char *nidPath(const char * restrict variable, const char * restrict name)
+{
+	static const char share[] = "/share/";
+
+	const char * const path = getenv(variable);
+	if (path != NULL) {
+		char * const copy = noisyMalloc(strlen(path) + 1);
+		if (copy != NULL)
+			strcpy(copy, path);
+
+		return copy;
+	}
+
+	const char * const vitasdk = getenv("VITASDK");
+	if (vitasdk == NULL)
+		return NULL;
+
+	char * const result = noisyMalloc(strlen(vitasdk) + sizeof(share)
+					  + strlen(name));
+	if (result != NULL)
+		sprintf(result, "%s%s%s", vitasdk, share, name);
+
+	return result;
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "../noisy/lib.h"
+#include "set.h"
+
+void nidSetInit(struct nidSet * restrict set)
+{
+	set->nids = NULL;
+	set->n = 0;
+	set->capacity = 0;
+	set->filter = NULL;
+}
+
+int nidSetAdd(struct nidSet * restrict set, uint32_t nid)
+{
+	if (set->n >= set->capacity) {
+		const size_t capacity
+			= set->capacity == 0 ? 64 : set->capacity * 2;
+		uint32_t * const nids = noisyRealloc(
+			set->nids, capacity * sizeof(*nids));
+		if (nids == NULL)
+			return -1;
+
+		set->nids = nids;
+		set->capacity = capacity;
+	}
+
+	set->nids[set->n] = nid;
+	set->n++;
+	return 0;
+}
+
+static int compareNids(const void *a, const void *b)
+{
+	const uint32_t x = *(const uint32_t *)a;
+	const uint32_t y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static uint32_t hashNid(uint32_t nid)
+{
+	/* NIDs are already uniform. */
+	return nid >> (32 - NID_SET_FILTER_BITS);
+}
+
+int nidSetFinalize(struct nidSet * restrict set)
+{
+	free(set->filter);
+	set->filter = noisyCalloc((1 << NID_SET_FILTER_BITS) / 8);
+	if (set->filter == NULL)
+		return -1;
+
+	if (set->n > 0)
+		qsort(set->nids, set->n, sizeof(*set->nids), compareNids);
+
+	size_t n = 0;
+	for (size_t ndx = 0; ndx < set->n; ndx++) {
+		if (n > 0 && set->nids[n - 1] == set->nids[ndx])
+			continue;
+
+		const uint32_t hash = hashNid(set->nids[ndx]);
+
+		set->filter[hash / 64] |= UINT64_C(1) << hash % 64;
+		set->nids[n] = set->nids[ndx];
+		n++;
+	}
+
+	set->n = n;
+	return 0;
+}
+
+bool nidSetHas(const struct nidSet * restrict set, uint32_t nid)
+{
+	const uint32_t hash = hashNid(nid);
+
+	if ((set->filter[hash / 64] & (UINT64_C(1) << hash % 64)) == 0)
+		return false;
+
+	return bsearch(&nid, set->nids, set->n, sizeof(*set->nids),
+		       compareNids) != NULL;
+}
+
+void nidSetDeinit(const struct nidSet * restrict set)
+{
+	free(set->nids);
+	free(set->filter);
+}
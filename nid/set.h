@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NID_SET_H
+#define NID_SET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* The number of bits of the filter tested before the binary search. */
+#define NID_SET_FILTER_BITS 16
+
+/* A set of NIDs. NIDs are added and then nidSetFinalize makes it
+   searchable. */
+struct nidSet {
+	uint32_t *nids;
+	size_t n;
+	size_t capacity;
+	uint64_t *filter;
+};
+
+void nidSetInit(struct nidSet * restrict set);
+int nidSetAdd(struct nidSet * restrict set, uint32_t nid);
+
+/* Sorts and dedupes NIDs, and makes the filter. */
+int nidSetFinalize(struct nidSet * restrict set);
+
+bool nidSetHas(const struct nidSet * restrict set, uint32_t nid);
+
+void nidSetDeinit(const struct nidSet * restrict set);
+
+#endif
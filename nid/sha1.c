@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "sha1.h"
+
+#define SHA1_BLOCK 64
+
+static const uint32_t sha1Init[5] = {
+	0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0
+};
+
+static uint32_t rol(uint32_t x, unsigned int n)
+{
+	return (x << n) | (x >> (32 - n));
+}
+
+static uint32_t bswap(uint32_t x)
+{
+	return (x >> 24) | ((x >> 8) & 0xFF00)
+	       | ((x << 8) & 0xFF0000) | (x << 24);
+}
+
+static uint32_t loadBe(const unsigned char * restrict p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16)
+	       | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void compress(uint32_t * restrict state,
+		     const unsigned char * restrict block)
+{
+	uint32_t w[80];
+	uint32_t a = state[0];
+	uint32_t b = state[1];
+	uint32_t c = state[2];
+	uint32_t d = state[3];
+	uint32_t e = state[4];
+
+	for (int ndx = 0; ndx < 16; ndx++)
+		w[ndx] = loadBe(block + ndx * 4);
+
+	for (int ndx = 16; ndx < 80; ndx++)
+		w[ndx] = rol(w[ndx - 3] ^ w[ndx - 8] ^ w[ndx - 14]
+			     ^ w[ndx - 16], 1);
+
+	for (int ndx = 0; ndx < 80; ndx++) {
+		uint32_t f;
+		uint32_t k;
+
+		if (ndx < 20) {
+			f = (b & c) | (~b & d);
+			k = 0x5A827999;
+		} else if (ndx < 40) {
+			f = b ^ c ^ d;
+			k = 0x6ED9EBA1;
+		} else if (ndx < 60) {
+			f = (b & c) | (b & d) | (c & d);
+			k = 0x8F1BBCDC;
+		} else {
+			f = b ^ c ^ d;
+			k = 0xCA62C1D6;
+		}
+
+		const uint32_t t = rol(a, 5) + f + e + k + w[ndx];
+		e = d;
+		d = c;
+		c = rol(b, 30);
+		b = a;
+		a = t;
+	}
+
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+}
+
+uint32_t nidHash(const char * restrict name, const char * restrict suffix)
+{
+	const size_t nameSize = strlen(name);
+	const size_t suffixSize = strlen(suffix);
+	const uint64_t bits = (uint64_t)(nameSize + suffixSize) * 8;
+	unsigned char block[SHA1_BLOCK];
+	uint32_t state[5];
+	size_t filled = 0;
+
+	memcpy(state, sha1Init, sizeof(state));
+
+	/* Feeds the name, the suffix and the padding. */
+	for (int part = 0; part < 2; part++) {
+		const char *p = part == 0 ? name : suffix;
+		size_t left = part == 0 ? nameSize : suffixSize;
+
+		while (left > 0) {
+			const size_t n = SHA1_BLOCK - filled < left ?
+					 SHA1_BLOCK - filled : left;
+
+			memcpy(block + filled, p, n);
+			filled += n;
+			p += n;
+			left -= n;
+
+			if (filled == SHA1_BLOCK) {
+				compress(state, block);
+				filled = 0;
+			}
+		}
+	}
+
+	block[filled++] = 0x80;
+	if (filled > SHA1_BLOCK - 8) {
+		memset(block + filled, 0, SHA1_BLOCK - filled);
+		compress(state, block);
+		filled = 0;
+	}
+
+	memset(block + filled, 0, SHA1_BLOCK - 8 - filled);
+	for (int ndx = 0; ndx < 8; ndx++)
+		block[SHA1_BLOCK - 1 - ndx] = bits >> (ndx * 8);
+
+	compress(state, block);
+
+	return bswap(state[0]);
+}
+
+void nidSha1Lanes(const char * const messages[NID_SHA1_LANES],
+		  const size_t sizes[NID_SHA1_LANES],
+		  uint32_t nids[NID_SHA1_LANES])
+{
+	/* Word-major so that each step over lanes is contiguous. */
+	uint32_t w[80][NID_SHA1_LANES];
+	uint32_t a[NID_SHA1_LANES];
+	uint32_t b[NID_SHA1_LANES];
+	uint32_t c[NID_SHA1_LANES];
+	uint32_t d[NID_SHA1_LANES];
+	uint32_t e[NID_SHA1_LANES];
+
+	for (int lane = 0; lane < NID_SHA1_LANES; lane++) {
+		unsigned char block[SHA1_BLOCK] = { 0 };
+
+		memcpy(block, messages[lane], sizes[lane]);
+		block[sizes[lane]] = 0x80;
+		block[SHA1_BLOCK - 2] = sizes[lane] >> 5;
+		block[SHA1_BLOCK - 1] = sizes[lane] << 3;
+
+		for (int ndx = 0; ndx < 16; ndx++)
+			w[ndx][lane] = loadBe(block + ndx * 4);
+	}
+
+	for (int lane = 0; lane < NID_SHA1_LANES; lane++) {
+		a[lane] = sha1Init[0];
+		b[lane] = sha1Init[1];
+		c[lane] = sha1Init[2];
+		d[lane] = sha1Init[3];
+		e[lane] = sha1Init[4];
+	}
+
+	for (int ndx = 16; ndx < 80; ndx++)
+		for (int lane = 0; lane < NID_SHA1_LANES; lane++)
+			w[ndx][lane] = rol(w[ndx - 3][lane] ^ w[ndx - 8][lane]
+					   ^ w[ndx - 14][lane]
+					   ^ w[ndx - 16][lane], 1);
+
+	/* Rounds are grouped by function so that no lane loop branches. */
+	for (int ndx = 0; ndx < 80; ndx++) {
+		uint32_t f[NID_SHA1_LANES];
+
+		if (ndx < 20)
+			for (int lane = 0; lane < NID_SHA1_LANES; lane++)
+				f[lane] = 0x5A827999 + (d[lane]
+					  ^ (b[lane] & (c[lane] ^ d[lane])));
+		else if (ndx < 40)
+			for (int lane = 0; lane < NID_SHA1_LANES; lane++)
+				f[lane] = 0x6ED9EBA1
+					  + (b[lane] ^ c[lane] ^ d[lane]);
+		else if (ndx < 60)
+			for (int lane = 0; lane < NID_SHA1_LANES; lane++)
+				f[lane] = 0x8F1BBCDC + ((b[lane] & c[lane])
+					  | (d[lane] & (b[lane] | c[lane])));
+		else
+			for (int lane = 0; lane < NID_SHA1_LANES; lane++)
+				f[lane] = 0xCA62C1D6
+					  + (b[lane] ^ c[lane] ^ d[lane]);
+
+		for (int lane = 0; lane < NID_SHA1_LANES; lane++) {
+			const uint32_t t = rol(a[lane], 5) + f[lane] + e[lane]
+					   + w[ndx][lane];
+			e[lane] = d[lane];
+			d[lane] = c[lane];
+			c[lane] = rol(b[lane], 30);
+			b[lane] = a[lane];
+			a[lane] = t;
+		}
+	}
+
+	/* Only the first word of the digest is needed. */
+	for (int lane = 0; lane < NID_SHA1_LANES; lane++)
+		nids[lane] = bswap(a[lane] + sha1Init[0]);
+}
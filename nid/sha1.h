@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NID_SHA1_H
+#define NID_SHA1_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* The number of messages nidSha1Lanes hashes at once. */
+#define NID_SHA1_LANES 8
+
+/* The longest message which fits in a block with its padding. */
+#define NID_SHA1_BLOCK_MAX 55
+
+/* A NID is the first 4 bytes of SHA-1 of the name and the suffix of the
+   library, in little endian. */
+uint32_t nidHash(const char * restrict name, const char * restrict suffix);
+
+/* Computes NIDs of NID_SHA1_LANES messages of at most NID_SHA1_BLOCK_MAX
+   bytes. Loops over lanes are independent so that compilers vectorize
+   them. */
+void nidSha1Lanes(const char * const messages[NID_SHA1_LANES],
+		  const size_t sizes[NID_SHA1_LANES],
+		  uint32_t nids[NID_SHA1_LANES]);
+
+#endif
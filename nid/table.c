@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../noisy/fcntl.h"
+#include "../noisy/lib.h"
+#include "../pool.h"
+#include "path.h"
+#include "sha1.h"
+#include "table.h"
+
+struct tableJob {
+	const char * const *names;
+	const uint32_t *offsets;
+	size_t from;
+	size_t to;
+	const char * const *suffixes;
+	size_t nSuffixes;
+	struct nidTableEntry *entries;
+};
+
+char *nidTablePath(void)
+{
+	return nidPath("VITA_ANALYZE_NIDTABLE", "nidtable.bin");
+}
+
+int nidTableOpen(struct nidTable * restrict table, const char * restrict path)
+{
+	const int result = mappedOpen(&table->mapped, path, NID_TABLE_MAGIC,
+				      sizeof(*table->entries), "NID table");
+
+	table->entries = table->mapped.records;
+	return result;
+}
+
+/* NIDs are uniform, so interpolation finds one in a few probes. */
+const char *nidTableFind(const struct nidTable * restrict table, uint32_t nid)
+{
+	const struct nidTableEntry * const entries = table->entries;
+	size_t low = 0;
+	size_t high = table->mapped.n;
+
+	while (low < high
+	       && nid >= entries[low].nid && nid <= entries[high - 1].nid) {
+		const uint32_t span = entries[high - 1].nid - entries[low].nid;
+		const size_t ndx = span == 0 ? low :
+			low + (uint64_t)(nid - entries[low].nid)
+			      * (high - 1 - low) / span;
+
+		if (entries[ndx].nid == nid)
+			return entries[ndx].name < table->mapped.namesSize ?
+				table->mapped.names + entries[ndx].name : NULL;
+
+		if (entries[ndx].nid < nid)
+			low = ndx + 1;
+		else
+			high = ndx;
+	}
+
+	return NULL;
+}
+
+void nidTableClose(const struct nidTable * restrict table)
+{
+	mappedClose(&table->mapped);
+}
+
+static void *tableWorker(void *p)
+{
+	const struct tableJob * const job = p;
+	char messages[NID_SHA1_LANES][NID_SHA1_BLOCK_MAX + 1];
+	const char *pointers[NID_SHA1_LANES];
+	size_t sizes[NID_SHA1_LANES];
+	size_t targets[NID_SHA1_LANES];
+	uint32_t nids[NID_SHA1_LANES];
+	unsigned int n = 0;
+
+	for (unsigned int lane = 0; lane < NID_SHA1_LANES; lane++)
+		pointers[lane] = messages[lane];
+
+	for (size_t ndx = job->from; ndx < job->to; ndx++) {
+		const char * const name = job->names[ndx];
+		const size_t nameSize = strlen(name);
+
+		for (size_t suffix = 0; suffix < job->nSuffixes; suffix++) {
+			const size_t target = ndx * job->nSuffixes + suffix;
+			const size_t suffixSize
+				= strlen(job->suffixes[suffix]);
+
+			job->entries[target].name = job->offsets[ndx];
+
+			if (nameSize + suffixSize > NID_SHA1_BLOCK_MAX) {
+				job->entries[target].nid = nidHash(
+					name, job->suffixes[suffix]);
+				continue;
+			}
+
+			memcpy(messages[n], name, nameSize);
+			memcpy(messages[n] + nameSize, job->suffixes[suffix],
+			       suffixSize);
+			sizes[n] = nameSize + suffixSize;
+			targets[n] = target;
+			n++;
+
+			if (n < NID_SHA1_LANES)
+				continue;
+
+			nidSha1Lanes(pointers, sizes, nids);
+			for (unsigned int lane = 0; lane < n; lane++)
+				job->entries[targets[lane]].nid = nids[lane];
+
+			n = 0;
+		}
+	}
+
+	if (n > 0) {
+		for (unsigned int lane = n; lane < NID_SHA1_LANES; lane++)
+			sizes[lane] = 0;
+
+		nidSha1Lanes(pointers, sizes, nids);
+		for (unsigned int lane = 0; lane < n; lane++)
+			job->entries[targets[lane]].nid = nids[lane];
+	}
+
+	return NULL;
+}
+
+static int compareEntries(const void *a, const void *b)
+{
+	const struct nidTableEntry * const x = a;
+	const struct nidTableEntry * const y = b;
+
+	return x->nid != y->nid ? (x->nid < y->nid ? -1 : 1) :
+		x->name < y->name ? -1 : x->name > y->name;
+}
+
+/* Hashes on all processors. The calling thread takes the first job. */
+static void hashAll(struct tableJob * restrict base, size_t n)
+{
+	struct tableJob jobs[POOL_THREADS_MAX];
+
+	size_t wanted = poolWorkers();
+	if (wanted > n)
+		wanted = n > 0 ? n : 1;
+
+	for (size_t ndx = 0; ndx < wanted; ndx++) {
+		jobs[ndx] = *base;
+		jobs[ndx].from = n * ndx / wanted;
+		jobs[ndx].to = n * (ndx + 1) / wanted;
+	}
+
+	poolSpawn(tableWorker, jobs, sizeof(*jobs), wanted);
+}
+
+int nidTableBuild(const char * restrict path,
+		  const char * const * restrict names, size_t n,
+		  const char * const * restrict suffixes, size_t nSuffixes)
+{
+	struct mappedHeader header;
+	int result = -1;
+
+	/* Offsets in the file must fit in 32 bits. */
+	if (n > UINT32_MAX / nSuffixes
+	    || n * nSuffixes > (UINT32_MAX - sizeof(header))
+			       / sizeof(struct nidTableEntry))
+		goto failTooMany;
+
+	uint32_t * const offsets = noisyMalloc(n * sizeof(*offsets));
+	if (offsets == NULL)
+		goto failOffsets;
+
+	size_t namesSize = 0;
+	for (size_t ndx = 0; ndx < n; ndx++) {
+		offsets[ndx] = namesSize;
+		namesSize += strlen(names[ndx]) + 1;
+		if (namesSize > UINT32_MAX) {
+			free(offsets);
+			goto failTooMany;
+		}
+	}
+
+	char * const pool = noisyMalloc(namesSize);
+	if (pool == NULL)
+		goto failPool;
+
+	for (size_t ndx = 0; ndx < n; ndx++)
+		strcpy(pool + offsets[ndx], names[ndx]);
+
+	struct tableJob job = {
+		.names = names,
+		.offsets = offsets,
+		.suffixes = suffixes,
+		.nSuffixes = nSuffixes
+	};
+	size_t nEntries = n * nSuffixes;
+
+	job.entries = noisyMalloc(nEntries * sizeof(*job.entries));
+	if (job.entries == NULL)
+		goto failEntries;
+
+	hashAll(&job, n);
+
+	/* Corpora overlap; drop the same name repeated for a NID. */
+	if (nEntries > 0) {
+		qsort(job.entries, nEntries, sizeof(*job.entries),
+		      compareEntries);
+
+		size_t kept = 1;
+		for (size_t ndx = 1; ndx < nEntries; ndx++) {
+			const struct nidTableEntry * const last
+				= job.entries + kept - 1;
+			const struct nidTableEntry * const entry
+				= job.entries + ndx;
+
+			if (last->nid == entry->nid
+			    && strcmp(pool + last->name,
+				      pool + entry->name) == 0)
+				continue;
+
+			job.entries[kept] = *entry;
+			kept++;
+		}
+
+		nEntries = kept;
+	}
+
+	memcpy(header.magic, NID_TABLE_MAGIC, sizeof(header.magic));
+	header.n = nEntries;
+	header.names = sizeof(header) + nEntries * sizeof(*job.entries);
+
+	struct noisyFile * const file = noisyCreat(path);
+	if (file == NULL)
+		goto failCreat;
+
+	if (noisyWrite(file, &header, sizeof(header)) == sizeof(header)
+	    && noisyWrite(file, job.entries,
+			  nEntries * sizeof(*job.entries))
+	       == (ssize_t)(nEntries * sizeof(*job.entries))
+	    && noisyWrite(file, pool, namesSize) == (ssize_t)namesSize)
+		result = 0;
+
+	if (noisyClose(file) != 0)
+		result = -1;
+
+failCreat:
+	free(job.entries);
+failEntries:
+	free(pool);
+failPool:
+	free(offsets);
+failOffsets:
+	return result;
+
+failTooMany:
+	fputs("too many names\n", stderr);
+	return -1;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NID_TABLE_H
+#define NID_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../mapped.h"
+
+#define NID_TABLE_MAGIC "NIDTABL1"
+
+/* The records of the mapped file are the entries, sorted by NID. */
+
+struct nidTableEntry {
+	uint32_t nid;
+
+	/* The offset of the name from the beginning of names. */
+	uint32_t name;
+};
+
+/* A table mapped from a file. */
+struct nidTable {
+	struct mapped mapped;
+	const struct nidTableEntry *entries;
+};
+
+/* Returns VITA_ANALYZE_NIDTABLE, or $VITASDK/share/nidtable.bin, which must
+   be freed. */
+char *nidTablePath(void);
+
+/* A missing file is taken as an empty table. */
+int nidTableOpen(struct nidTable * restrict table, const char * restrict path);
+
+const char *nidTableFind(const struct nidTable * restrict table, uint32_t nid);
+
+void nidTableClose(const struct nidTable * restrict table);
+
+/* Hashes names with every suffix on all processors and writes the table.
+   names must be NUL-terminated. */
+int nidTableBuild(const char * restrict path,
+		  const char * const * restrict names, size_t n,
+		  const char * const * restrict suffixes, size_t nSuffixes);
+
+#endif
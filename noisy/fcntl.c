@@ -16,19 +16,18 @@
  */
 
 #define _POSIX_C_SOURCE 200809L
+/* For SEEK_DATA and SEEK_HOLE, which are not in POSIX.1-2008. */
+#define _GNU_SOURCE
 #include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include "fcntl.h"
+#include "file.h"
 #include "lib.h"
 
-struct noisyFile {
-	int fileno;
-	const char * restrict path;
-};
-
 struct noisyFile *noisyGetStdout()
 {
 	struct noisyFile * const context = noisyMalloc(sizeof(*context));
@@ -45,11 +44,32 @@ int noisyIsatty(const struct noisyFile * restrict context)
 	return isatty(context->fileno);
 }
 
+int noisyIsHoleSafe(const struct noisyFile * restrict context)
+{
+	struct stat st;
+
+	if (fstat(context->fileno, &st) != 0) {
+		perror(context->path);
+		return 0;
+	}
+
+	if (!S_ISREG(st.st_mode))
+		return 0;
+
+	/* Writes with O_APPEND go to the end whatever lseek did. */
+	const int flags = fcntl(context->fileno, F_GETFL);
+	if (flags < 0 || (flags & O_APPEND) != 0)
+		return 0;
+
+	/* Skipped bytes read as zero only if nothing is there yet. */
+	return lseek(context->fileno, 0, SEEK_CUR) == st.st_size;
+}
+
 struct noisyFile *noisyOpen(const char * restrict path, int flag)
 {
 	struct noisyFile * const context = noisyMalloc(sizeof(*context));
 	if (context != NULL) {
-		context->fileno = open (path, flag);
+		context->fileno = open (path, flag, 0666);
 		if (context->fileno < 0) {
 			perror(path);
 			free(context);
@@ -62,6 +82,11 @@ struct noisyFile *noisyOpen(const char * restrict path, int flag)
 	return context;
 }
 
+struct noisyFile *noisyCreat(const char * restrict path)
+{
+	return noisyOpen(path, O_WRONLY | O_CREAT | O_TRUNC);
+}
+
 int noisyClose(struct noisyFile * restrict context)
 {
 	int result;
@@ -84,6 +109,49 @@ off_t noisyLseek(const struct noisyFile * restrict context,
 	return result;
 }
 
+int noisyFtruncate(const struct noisyFile * restrict context, off_t size)
+{
+	const int result = ftruncate(context->fileno, size);
+	if (result != 0)
+		perror(context->path);
+
+	return result;
+}
+
+off_t noisySeekData(const struct noisyFile * restrict context,
+		    off_t offset, off_t end, off_t * restrict hole)
+{
+#ifdef SEEK_HOLE
+	const off_t data = lseek(context->fileno, offset, SEEK_DATA);
+	if (data < 0) {
+		if (errno == ENXIO) {
+			*hole = end;
+			return end;
+		}
+
+		/* EINVAL if the file system doesn't know. */
+		if (errno != EINVAL) {
+			perror(context->path);
+			return -1;
+		}
+	} else {
+		*hole = lseek(context->fileno, data, SEEK_HOLE);
+		if (*hole < 0) {
+			perror(context->path);
+			return -1;
+		}
+
+		if (*hole > end)
+			*hole = end;
+
+		return data < end ? data : end;
+	}
+#endif
+
+	*hole = end;
+	return offset;
+}
+
 ssize_t noisyPread(const struct noisyFile * restrict context,
 		   void * restrict buffer, size_t size, off_t offset)
 {
@@ -128,3 +196,18 @@ ssize_t noisyWrite(const struct noisyFile * restrict context,
 
 	return result;
 }
+
+ssize_t noisyPwrite(const struct noisyFile * restrict context,
+		    const void * restrict buffer, size_t size, off_t offset)
+{
+	const ssize_t result = pwrite(context->fileno, buffer, size, offset);
+	if (result != (ssize_t)size) {
+		if (errno != 0)
+			perror(context->path);
+		else
+			fprintf(stderr, "%s: unknown error while writing\n",
+				context->path);
+	}
+
+	return result;
+}
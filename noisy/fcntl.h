@@ -27,17 +27,32 @@ struct noisyFile *noisyGetStdout(void);
 
 int noisyIsatty(const struct noisyFile * restrict context);
 
+/* Returns whether seeking over bytes leaves zeros there, i.e. it is a
+   regular file opened without O_APPEND and positioned at its end. */
+int noisyIsHoleSafe(const struct noisyFile * restrict context);
+
 struct noisyFile *noisyOpen(const char * restrict path, int flag);
 
+struct noisyFile *noisyCreat(const char * restrict path);
+
 int noisyClose(struct noisyFile * restrict context);
 
 off_t noisyLseek(const struct noisyFile * restrict context,
 		 off_t offset, int whence);
+int noisyFtruncate(const struct noisyFile * restrict context, off_t size);
+
+/* Returns the offset of the first data at or after offset, and sets *hole
+   to the end of the data. Without SEEK_DATA, everything is data. */
+off_t noisySeekData(const struct noisyFile * restrict context,
+		    off_t offset, off_t end, off_t * restrict hole);
+
 ssize_t noisyPread(const struct noisyFile * restrict context,
 		   void * restrict buffer, size_t size, off_t offset);
 ssize_t noisyRead(const struct noisyFile * restrict context,
 		  void * restrict buffer, size_t size);
 ssize_t noisyWrite(const struct noisyFile * restrict context,
 		   const void * restrict buffer, size_t size);
+ssize_t noisyPwrite(const struct noisyFile * restrict context,
+		    const void * restrict buffer, size_t size, off_t offset);
 
 #endif
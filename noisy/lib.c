@@ -28,3 +28,21 @@ void *noisyMalloc(size_t size)
 
 	return p;
 }
+
+void *noisyCalloc(size_t size)
+{
+	void * const p = calloc(1, size);
+	if (p == NULL)
+		perror(NULL);
+
+	return p;
+}
+
+void *noisyRealloc(void *p, size_t size)
+{
+	void * const q = realloc(p, size);
+	if (q == NULL)
+		perror(NULL);
+
+	return q;
+}
@@ -21,5 +21,9 @@
 #include <stddef.h>
 
 void *noisyMalloc(size_t size);
+void *noisyCalloc(size_t size);
+
+/* Leaves p allocated on failure. */
+void *noisyRealloc(void *p, size_t size);
 
 #endif
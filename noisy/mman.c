@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include "file.h"
+#include "mman.h"
+
+void *noisyMmap(const struct noisyFile * restrict context, size_t size)
+{
+	void * const buffer = mmap(NULL, size, PROT_READ | PROT_WRITE,
+				   MAP_PRIVATE, context->fileno, 0);
+	if (buffer == MAP_FAILED) {
+		perror(context->path);
+		return NULL;
+	}
+
+	return buffer;
+}
+
+int noisyMunmap(void *buffer, size_t size)
+{
+	const int result = munmap(buffer, size);
+	if (result != 0)
+		perror(NULL);
+
+	return result;
+}
@@ -0,0 +1,490 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "fcntl.h"
+#include "file.h"
+#include "lib.h"
+#include "uring.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define NOISY_URING
+#endif
+#endif
+
+#ifdef NOISY_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+/* Linux transfers at most 0x7FFFF000 bytes per read or write. */
+#define RING_CHUNK 0x40000000
+
+struct ringOp {
+	struct noisyRingGroup *group;
+	const struct noisyFile *file;
+	size_t size;
+	unsigned int next;
+};
+#endif
+
+struct noisyRing {
+	int fd;
+	bool broken;
+#ifdef NOISY_URING
+	unsigned int *sqHead;
+	unsigned int *sqTail;
+	unsigned int sqMask;
+	unsigned int *sqArray;
+	unsigned int *cqHead;
+	unsigned int *cqTail;
+	unsigned int cqMask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void *sqRing;
+	void *cqRing;
+	size_t sqRingSize;
+	size_t cqRingSize;
+	size_t sqesSize;
+	unsigned int sqEntries;
+	unsigned int queued;
+	struct ringOp *ops;
+	unsigned int freeOp;
+	struct iovec *registered;
+	unsigned int nRegistered;
+#endif
+};
+
+/* Synchronous path, used when io_uring is unavailable. A failed linked
+   operation cancels the rest of its chain like io_uring does. */
+static int syncOp(struct noisyRing * restrict ring,
+		  struct noisyRingGroup * restrict group,
+		  const struct noisyFile * restrict file,
+		  void * restrict buffer, size_t size, off_t offset,
+		  bool write, bool link)
+{
+	if (ring->broken) {
+		ring->broken = link;
+		group->result = -1;
+		return 0;
+	}
+
+	const ssize_t result = write ?
+		noisyPwrite(file, buffer, size, offset) :
+		noisyPread(file, buffer, size, offset);
+	if (result != (ssize_t)size) {
+		ring->broken = link;
+		group->result = -1;
+	}
+
+	return 0;
+}
+
+#ifdef NOISY_URING
+static int ringEnter(struct noisyRing *ring, unsigned int minComplete)
+{
+	const unsigned int flags = minComplete > 0 ? IORING_ENTER_GETEVENTS : 0;
+	long result;
+
+	do {
+		result = syscall(__NR_io_uring_enter, ring->fd, ring->queued,
+				 minComplete, flags, NULL, 0);
+	} while (result < 0 && errno == EINTR);
+
+	if (result < 0) {
+		perror("io_uring_enter");
+		return -1;
+	}
+
+	ring->queued -= result;
+	return 0;
+}
+
+static void ringReap(struct noisyRing *ring)
+{
+	unsigned int head = *ring->cqHead;
+	const unsigned int tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+
+	while (head != tail) {
+		const struct io_uring_cqe * const cqe
+			= ring->cqes + (head & ring->cqMask);
+		struct ringOp * const op = ring->ops + cqe->user_data;
+
+		if (cqe->res < 0) {
+			/* The failure which broke the chain is already reported. */
+			if (cqe->res != -ECANCELED) {
+				errno = -cqe->res;
+				perror(op->file->path);
+			}
+
+			op->group->result = -1;
+		} else if ((size_t)cqe->res != op->size) {
+			fprintf(stderr, "%s: short transfer (%d of %zu bytes)\n",
+				op->file->path, cqe->res, op->size);
+			op->group->result = -1;
+		}
+
+		op->group->pending--;
+		op->next = ring->freeOp;
+		ring->freeOp = op - ring->ops;
+		head++;
+	}
+
+	__atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+}
+
+static struct io_uring_sqe *ringGet(struct noisyRing *ring,
+				    unsigned int *opNdx)
+{
+	for (;;) {
+		const unsigned int head
+			= __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE);
+		const unsigned int tail = *ring->sqTail;
+
+		if (tail - head < ring->sqEntries
+		    && ring->freeOp != ring->sqEntries * 2) {
+			*opNdx = ring->freeOp;
+			ring->freeOp = ring->ops[*opNdx].next;
+			return ring->sqes + (tail & ring->sqMask);
+		}
+
+		/* Full. Submit what is queued and make room. */
+		if (ringEnter(ring, 1) != 0)
+			return NULL;
+
+		ringReap(ring);
+	}
+}
+
+static int ringQueue(struct noisyRing * restrict ring,
+		  struct noisyRingGroup * restrict group,
+		  const struct noisyFile * restrict file,
+		  void * restrict buffer, size_t size, off_t offset,
+		  bool write, bool link)
+{
+	while (size > 0) {
+		const size_t chunk = size > RING_CHUNK ? RING_CHUNK : size;
+		unsigned int opNdx;
+
+		struct io_uring_sqe * const sqe = ringGet(ring, &opNdx);
+		if (sqe == NULL)
+			return -1;
+
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+
+		for (unsigned int ndx = 0; ndx < ring->nRegistered; ndx++) {
+			const char * const base = ring->registered[ndx].iov_base;
+			if ((char *)buffer >= base
+			    && (char *)buffer + chunk
+			       <= base + ring->registered[ndx].iov_len) {
+				sqe->opcode = write ?
+					IORING_OP_WRITE_FIXED :
+					IORING_OP_READ_FIXED;
+				sqe->buf_index = ndx;
+				break;
+			}
+		}
+
+		sqe->fd = file->fileno;
+		sqe->off = offset;
+		sqe->addr = (unsigned long)buffer;
+		sqe->len = chunk;
+		sqe->user_data = opNdx;
+		if (link || chunk < size)
+			sqe->flags = IOSQE_IO_LINK;
+
+		ring->ops[opNdx].group = group;
+		ring->ops[opNdx].file = file;
+		ring->ops[opNdx].size = chunk;
+		group->pending++;
+
+		const unsigned int tail = *ring->sqTail;
+		ring->sqArray[tail & ring->sqMask] = sqe - ring->sqes;
+		__atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+		ring->queued++;
+
+		buffer = (char *)buffer + chunk;
+		offset += chunk;
+		size -= chunk;
+	}
+
+	return 0;
+}
+
+/* Linux 5.1 to 5.5 set up rings but fail IORING_OP_READ and IORING_OP_WRITE
+   with EINVAL. They don't know IORING_REGISTER_PROBE either. */
+static bool ringProbe(const struct noisyRing *ring)
+{
+	static const unsigned char wanted[] = {
+		IORING_OP_READ, IORING_OP_WRITE,
+		IORING_OP_READ_FIXED, IORING_OP_WRITE_FIXED
+	};
+	const unsigned int nOps = 256;
+	bool result = false;
+
+	struct io_uring_probe * const probe = noisyMalloc(
+		sizeof(*probe) + nOps * sizeof(*probe->ops));
+	if (probe == NULL)
+		return false;
+
+	memset(probe, 0, sizeof(*probe) + nOps * sizeof(*probe->ops));
+	if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PROBE,
+		    probe, nOps) != 0)
+		goto failProbe;
+
+	for (unsigned int ndx = 0; ndx < sizeof(wanted); ndx++)
+		if (wanted[ndx] >= probe->ops_len
+		    || (probe->ops[wanted[ndx]].flags
+			& IO_URING_OP_SUPPORTED) == 0)
+			goto failProbe;
+
+	result = true;
+
+failProbe:
+	free(probe);
+	return result;
+}
+
+static int ringSetup(struct noisyRing *ring, unsigned int entries)
+{
+	struct io_uring_params params;
+
+	memset(&params, 0, sizeof(params));
+	ring->fd = syscall(__NR_io_uring_setup, entries, &params);
+	if (ring->fd < 0)
+		goto failSetup;
+
+	if (!ringProbe(ring))
+		goto failSqRing;
+
+	ring->sqRingSize = params.sq_off.array
+			   + params.sq_entries * sizeof(unsigned int);
+	ring->cqRingSize = params.cq_off.cqes
+			   + params.cq_entries * sizeof(struct io_uring_cqe);
+	ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+	if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0
+	    && ring->cqRingSize > ring->sqRingSize)
+		ring->sqRingSize = ring->cqRingSize;
+
+	ring->sqRing = mmap(NULL, ring->sqRingSize, PROT_READ | PROT_WRITE,
+			    MAP_SHARED | MAP_POPULATE, ring->fd,
+			    IORING_OFF_SQ_RING);
+	if (ring->sqRing == MAP_FAILED)
+		goto failSqRing;
+
+	if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+		ring->cqRing = ring->sqRing;
+	} else {
+		ring->cqRing = mmap(NULL, ring->cqRingSize,
+				    PROT_READ | PROT_WRITE,
+				    MAP_SHARED | MAP_POPULATE, ring->fd,
+				    IORING_OFF_CQ_RING);
+		if (ring->cqRing == MAP_FAILED)
+			goto failCqRing;
+	}
+
+	ring->sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, ring->fd,
+			  IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED)
+		goto failSqes;
+
+	/* Every queued operation has a completion slot to go to. */
+	ring->ops = noisyMalloc(params.sq_entries * 2 * sizeof(*ring->ops));
+	if (ring->ops == NULL)
+		goto failOps;
+
+	for (unsigned int ndx = 0; ndx < params.sq_entries * 2; ndx++)
+		ring->ops[ndx].next = ndx + 1;
+
+	char * const sq = ring->sqRing;
+	char * const cq = ring->cqRing;
+
+	ring->sqHead = (void *)(sq + params.sq_off.head);
+	ring->sqTail = (void *)(sq + params.sq_off.tail);
+	ring->sqMask = *(unsigned int *)(sq + params.sq_off.ring_mask);
+	ring->sqArray = (void *)(sq + params.sq_off.array);
+	ring->cqHead = (void *)(cq + params.cq_off.head);
+	ring->cqTail = (void *)(cq + params.cq_off.tail);
+	ring->cqMask = *(unsigned int *)(cq + params.cq_off.ring_mask);
+	ring->cqes = (void *)(cq + params.cq_off.cqes);
+	ring->sqEntries = params.sq_entries;
+	ring->queued = 0;
+	ring->freeOp = 0;
+	ring->registered = NULL;
+	ring->nRegistered = 0;
+
+	return 0;
+
+failOps:
+	munmap(ring->sqes, ring->sqesSize);
+failSqes:
+	if (ring->cqRing != ring->sqRing)
+		munmap(ring->cqRing, ring->cqRingSize);
+failCqRing:
+	munmap(ring->sqRing, ring->sqRingSize);
+failSqRing:
+	close(ring->fd);
+	ring->fd = -1;
+failSetup:
+	return -1;
+}
+#endif
+
+struct noisyRing *noisyRingOpen(unsigned int entries)
+{
+	struct noisyRing * const ring = noisyMalloc(sizeof(*ring));
+	if (ring == NULL)
+		return NULL;
+
+	ring->fd = -1;
+	ring->broken = false;
+
+#ifdef NOISY_URING
+	/* ENOSYS, EPERM from seccomp and the like; just go synchronous. */
+	ringSetup(ring, entries);
+#else
+	(void)entries;
+#endif
+
+	return ring;
+}
+
+int noisyRingRegister(struct noisyRing * restrict ring,
+		      void * const * restrict buffers,
+		      const size_t * restrict sizes, unsigned int n)
+{
+#ifdef NOISY_URING
+	if (ring->fd < 0)
+		return -1;
+
+	struct iovec * const iov = noisyMalloc(n * sizeof(*iov));
+	if (iov == NULL)
+		return -1;
+
+	for (unsigned int ndx = 0; ndx < n; ndx++) {
+		iov[ndx].iov_base = buffers[ndx];
+		iov[ndx].iov_len = sizes[ndx];
+	}
+
+	if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS,
+		    iov, n) != 0) {
+		fprintf(stderr, "warning: io_uring_register: %s; buffers are used unregistered\n",
+			strerror(errno));
+		free(iov);
+		return -1;
+	}
+
+	ring->registered = iov;
+	ring->nRegistered = n;
+	return 0;
+#else
+	(void)ring;
+	(void)buffers;
+	(void)sizes;
+	(void)n;
+	return -1;
+#endif
+}
+
+int noisyRingPread(struct noisyRing * restrict ring,
+		   struct noisyRingGroup * restrict group,
+		   const struct noisyFile * restrict file,
+		   void * restrict buffer, size_t size, off_t offset,
+		   bool link)
+{
+#ifdef NOISY_URING
+	if (ring->fd >= 0)
+		return ringQueue(ring, group, file, buffer, size, offset,
+				 false, link);
+#endif
+
+	return syncOp(ring, group, file, buffer, size, offset, false, link);
+}
+
+int noisyRingPwrite(struct noisyRing * restrict ring,
+		    struct noisyRingGroup * restrict group,
+		    const struct noisyFile * restrict file,
+		    const void * restrict buffer, size_t size, off_t offset,
+		    bool link)
+{
+#ifdef NOISY_URING
+	if (ring->fd >= 0)
+		return ringQueue(ring, group, file, (void *)buffer, size,
+				 offset, true, link);
+#endif
+
+	return syncOp(ring, group, file, (void *)buffer, size, offset,
+		      true, link);
+}
+
+int noisyRingSubmit(struct noisyRing *ring)
+{
+#ifdef NOISY_URING
+	if (ring->fd >= 0 && ring->queued > 0)
+		return ringEnter(ring, 0);
+#else
+	(void)ring;
+#endif
+
+	return 0;
+}
+
+int noisyRingWait(struct noisyRing * restrict ring,
+		  struct noisyRingGroup * restrict group)
+{
+#ifdef NOISY_URING
+	while (group->pending > 0) {
+		if (ringEnter(ring, 1) != 0)
+			return -1;
+
+		ringReap(ring);
+	}
+#else
+	(void)ring;
+#endif
+
+	return group->result;
+}
+
+void noisyRingClose(struct noisyRing *ring)
+{
+#ifdef NOISY_URING
+	if (ring->fd >= 0) {
+		free(ring->registered);
+		free(ring->ops);
+		munmap(ring->sqes, ring->sqesSize);
+		if (ring->cqRing != ring->sqRing)
+			munmap(ring->cqRing, ring->cqRingSize);
+		munmap(ring->sqRing, ring->sqRingSize);
+		close(ring->fd);
+	}
+#endif
+
+	free(ring);
+}
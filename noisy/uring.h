@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NOISY_URING_H
+#define NOISY_URING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include "fcntl.h"
+
+struct noisyRing;
+
+/* Operations queued with the same group are waited for together. result is
+   set to -1 if any of them failed. */
+struct noisyRingGroup {
+	unsigned int pending;
+	int result;
+};
+
+/* Falls back to synchronous pread/pwrite if io_uring is unavailable, so it
+   returns NULL only if memory allocation fails. */
+struct noisyRing *noisyRingOpen(unsigned int entries);
+
+/* Buffers registered here are accessed with fixed-buffer operations.
+   Failure is not fatal; the buffers are used unregistered then. */
+int noisyRingRegister(struct noisyRing * restrict ring,
+		      void * const * restrict buffers,
+		      const size_t * restrict sizes, unsigned int n);
+
+/* If link is true, the next operation queued starts only after this one
+   completed successfully. */
+int noisyRingPread(struct noisyRing * restrict ring,
+		   struct noisyRingGroup * restrict group,
+		   const struct noisyFile * restrict file,
+		   void * restrict buffer, size_t size, off_t offset,
+		   bool link);
+
+int noisyRingPwrite(struct noisyRing * restrict ring,
+		    struct noisyRingGroup * restrict group,
+		    const struct noisyFile * restrict file,
+		    const void * restrict buffer, size_t size, off_t offset,
+		    bool link);
+
+int noisyRingSubmit(struct noisyRing *ring);
+
+int noisyRingWait(struct noisyRing * restrict ring,
+		  struct noisyRingGroup * restrict group);
+
+void noisyRingClose(struct noisyRing *ring);
+
+#endif
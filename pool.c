@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "pool.h"
+
+struct poolQueue {
+	pthread_mutex_t lock;
+	size_t next;
+	size_t n;
+	size_t chunk;
+	void (*run)(void *context, size_t ndx);
+	void *context;
+};
+
+size_t poolWorkers(void)
+{
+	const long online = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return online <= 1 ? 1 :
+		(size_t)online > POOL_THREADS_MAX ?
+			POOL_THREADS_MAX : (size_t)online;
+}
+
+void poolSpawn(void *(*work)(void *), void *contexts, size_t stride,
+	       size_t n)
+{
+	pthread_t threads[POOL_THREADS_MAX];
+	size_t nThreads = 0;
+
+	while (nThreads + 1 < n) {
+		const int error = pthread_create(
+			threads + nThreads, NULL, work,
+			(char *)contexts + (nThreads + 1) * stride);
+		if (error != 0) {
+			errno = error;
+			perror("pthread_create");
+			break;
+		}
+
+		nThreads++;
+	}
+
+	work(contexts);
+
+	for (size_t ndx = nThreads + 1; ndx < n; ndx++)
+		work((char *)contexts + ndx * stride);
+
+	for (size_t ndx = 0; ndx < nThreads; ndx++)
+		pthread_join(threads[ndx], NULL);
+}
+
+static void *runQueue(void *p)
+{
+	struct poolQueue * const queue = p;
+
+	while (true) {
+		pthread_mutex_lock(&queue->lock);
+		const size_t first = queue->next;
+		if (first < queue->n)
+			queue->next = queue->n - first > queue->chunk ?
+				first + queue->chunk : queue->n;
+		const size_t last = queue->next;
+		pthread_mutex_unlock(&queue->lock);
+
+		if (first >= queue->n)
+			break;
+
+		for (size_t ndx = first; ndx < last; ndx++)
+			queue->run(queue->context, ndx);
+	}
+
+	return NULL;
+}
+
+void poolRun(size_t n, size_t chunk, void (*run)(void *context, size_t ndx),
+	     void *context)
+{
+	struct poolQueue queue = {
+		PTHREAD_MUTEX_INITIALIZER, 0, n, chunk, run, context
+	};
+	const size_t chunks = (n + chunk - 1) / chunk;
+	const size_t workers = poolWorkers();
+
+	poolSpawn(runQueue, &queue, 0,
+		  chunks <= 1 ? 1 : chunks < workers ? chunks : workers);
+}
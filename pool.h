@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+/* The most workers started, the calling thread included. */
+#define POOL_THREADS_MAX 64
+
+/* Returns the number of processors online, from 1 up to POOL_THREADS_MAX. */
+size_t poolWorkers(void);
+
+/* Runs work on each of n contexts, stride bytes apart, or on the same one if
+   stride is 0. The calling thread takes the first, and the ones whose thread
+   failed to start after it. n is from 1 up to POOL_THREADS_MAX. */
+void poolSpawn(void *(*work)(void *), void *contexts, size_t stride,
+	       size_t n);
+
+/* Calls run for each index below n on all processors, taking chunk indices
+   at once. */
+void poolRun(size_t n, size_t chunk, void (*run)(void *context, size_t ndx),
+	     void *context);
+
+#endif
@@ -33,12 +33,22 @@ void *readWhole(const char * restrict path, size_t * restrict size)
 	if (localSize < 0)
 		goto failSeek;
 
-	void * const buffer = noisyMalloc(localSize);
+	/* Holes are left as they are in the zero-filled buffer. */
+	char * const buffer = noisyCalloc(localSize);
 	if (buffer == NULL)
 		goto failMalloc;
 
-	if (noisyPread(file, buffer, localSize, 0) != localSize)
-		goto failRead;
+	off_t hole;
+	for (off_t data = noisySeekData(file, 0, localSize, &hole);
+	     data < localSize;
+	     data = noisySeekData(file, hole, localSize, &hole)) {
+		if (data < 0)
+			goto failRead;
+
+		if (noisyPread(file, buffer + data, hole - data, data)
+		    != hole - data)
+			goto failRead;
+	}
 
 	noisyClose(file);
 
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include "noisy/fcntl.h"
+#include "sparse.h"
+
+#define LANES 8
+
+/* Written so that compilers vectorize the loop; there is no early exit
+   within a block. */
+static bool isZero(const unsigned char * restrict buffer)
+{
+	uint64_t acc[LANES] = { 0 };
+
+	for (size_t ndx = 0; ndx < SPARSE_BLOCK / sizeof(acc); ndx++) {
+		uint64_t words[LANES];
+
+		memcpy(words, buffer + ndx * sizeof(words), sizeof(words));
+		for (int lane = 0; lane < LANES; lane++)
+			acc[lane] |= words[lane];
+	}
+
+	for (int lane = 1; lane < LANES; lane++)
+		acc[0] |= acc[lane];
+
+	return acc[0] == 0;
+}
+
+size_t sparseRun(const void * restrict buffer, size_t size, off_t offset,
+		 bool * restrict zero)
+{
+	const unsigned char * const top = buffer;
+	const size_t misalignment = offset % SPARSE_BLOCK;
+
+	/* A partial block is data. */
+	if (misalignment > 0) {
+		const size_t head = SPARSE_BLOCK - misalignment;
+
+		*zero = false;
+		return head < size ? head : size;
+	}
+
+	/* The block holding the last byte is never a hole. */
+	const size_t limit = size > 0 ? (size - 1) / SPARSE_BLOCK : 0;
+	size_t blocks = 0;
+
+	if (limit > 0 && isZero(top)) {
+		do
+			blocks++;
+		while (blocks < limit && isZero(top + blocks * SPARSE_BLOCK));
+
+		*zero = true;
+		return blocks * SPARSE_BLOCK;
+	}
+
+	do
+		blocks++;
+	while (blocks < limit && !isZero(top + blocks * SPARSE_BLOCK));
+
+	*zero = false;
+	return blocks < limit ? blocks * SPARSE_BLOCK : size;
+}
+
+ssize_t sparseWrite(const struct noisyFile * restrict file,
+		    const void * restrict buffer, size_t size, off_t offset,
+		    bool holeSafe, size_t * restrict holes)
+{
+	const char * const top = buffer;
+	size_t done = 0;
+
+	if (!holeSafe)
+		return noisyWrite(file, buffer, size);
+
+	while (done < size) {
+		bool zero;
+		const size_t run = sparseRun(top + done, size - done,
+					     offset + done, &zero);
+
+		if (zero) {
+			if (noisyLseek(file, run, SEEK_CUR) < 0)
+				return -1;
+
+			*holes += run;
+		} else if (noisyWrite(file, top + done, run) != (ssize_t)run) {
+			return -1;
+		}
+
+		done += run;
+	}
+
+	return size;
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2016  173210 <root.3.173210@live.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include "noisy/fcntl.h"
+
+/* Holes are made in units of this, aligned to the file offset. */
+#define SPARSE_BLOCK 4096
+
+/* Returns the size of the run at the top of buffer, which is placed at
+   offset of the file. The run is either data or whole zero blocks, and *zero
+   tells which. The block holding the last byte is always data so that the
+   file gets its size without truncation. */
+size_t sparseRun(const void * restrict buffer, size_t size, off_t offset,
+		 bool * restrict zero);
+
+/* Writes buffer to the current position, seeking over zero blocks if
+   holeSafe. Adds the number of bytes skipped to *holes. */
+ssize_t sparseWrite(const struct noisyFile * restrict file,
+		    const void * restrict buffer, size_t size, off_t offset,
+		    bool holeSafe, size_t * restrict holes);
+
+#endif